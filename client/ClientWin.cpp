@@ -16,6 +16,7 @@
 #include "Error.h"
 #include "Log.h"
 #include "Profiler.h"
+#include "FrameTrace.h"
 #include "GLFrame.h"
 
 using namespace vglutil;
@@ -28,7 +29,7 @@ extern Display *maindpy;
 
 ClientWin::ClientWin(int dpynum_, Window window_, int drawMethod_,
 	bool stereo_) : drawMethod(drawMethod_), reqDrawMethod(drawMethod_),
-	fb(NULL), cfindex(0), deadYet(false), thread(NULL), stereo(stereo_)
+	fb(NULL), sfb(NULL), cfindex(0), deadYet(false), thread(NULL), stereo(stereo_)
 {
 	if(dpynum_ < 0 || dpynum_ > 65535 || !window_)
 		throw(Error("ClientWin::ClientWin()", "Invalid argument"));
@@ -53,6 +54,7 @@ ClientWin::~ClientWin(void)
 	q.release();
 	if(thread) thread->stop();
 	delete fb;  fb = NULL;
+	delete sfb;  sfb = NULL;
 	#ifdef USEXV
 	for(int i = 0; i < NFRAMES; i++)
 	{
@@ -198,6 +200,26 @@ void ClientWin::drawFrame(Frame *f)
 }
 
 
+// Scale up the contents of the X11 frame buffer by 2x and draw them
+
+void ClientWin::drawScaled(void)
+{
+	if(!sfb)
+	{
+		char dpystr[80];
+		sprintf(dpystr, ":%d.0", dpynum);
+		NEWCHECK(sfb = new FBXFrame(dpystr, window));
+	}
+	rrframeheader h = fb->hdr;
+	h.framew = h.width = fb->hdr.framew * 2;
+	h.frameh = h.height = fb->hdr.frameh * 2;
+	h.x = h.y = 0;
+	sfb->init(h);
+	sfb->upsample(*fb);
+	sfb->redraw();
+}
+
+
 void ClientWin::run(void)
 {
 	Profiler pt("Total     "), pb("Blit      "), pd("Decompress");
@@ -217,6 +239,7 @@ void ClientWin::run(void)
 			{
 				if(f->hdr.flags != RR_EOF)
 				{
+					FrameTraceSpan traceSpan("Blit", f->traceID);
 					pb.startFrame();
 					((XVFrame *)f)->redraw();
 					pb.endFrame(f->hdr.width * f->hdr.height, 0, 1);
@@ -230,10 +253,13 @@ void ClientWin::run(void)
 			{
 				if(f->hdr.flags == RR_EOF)
 				{
+					FrameTraceSpan traceSpan("Blit", f->traceID);
 					pb.startFrame();
+					int scale = (f->flags & FRAME_HALFSIZE) ? 2 : 1;
 					if(fb->isGL) ((GLFrame *)fb)->init(f->hdr, stereo);
 					else ((FBXFrame *)fb)->init(f->hdr);
-					if(fb->isGL) ((GLFrame *)fb)->redraw();
+					if(fb->isGL) ((GLFrame *)fb)->redraw(scale);
+					else if(scale > 1) drawScaled();
 					else ((FBXFrame *)fb)->redraw();
 					pb.endFrame(fb->hdr.framew * fb->hdr.frameh, 0, 1);
 					pt.endFrame(fb->hdr.framew * fb->hdr.frameh, bytes, 1);
@@ -242,8 +268,18 @@ void ClientWin::run(void)
 				}
 				else
 				{
+					FrameTraceSpan traceSpan("Decompress", f->traceID);
 					pd.startFrame();
-					if(fb->isGL) *((GLFrame *)fb) = *((CompressedFrame *)f);
+					if(f->hdr.compress == RRCOMP_CACHEPUT
+						|| f->hdr.compress == RRCOMP_CACHEGET)
+					{
+						if(fb->isGL) ((GLFrame *)fb)->init(f->hdr, stereo);
+						else ((FBXFrame *)fb)->init(f->hdr);
+						if(f->hdr.compress == RRCOMP_CACHEPUT)
+							tileStore.put(*fb, *((CompressedFrame *)f));
+						else tileStore.get(*fb, *((CompressedFrame *)f));
+					}
+					else if(fb->isGL) *((GLFrame *)fb) = *((CompressedFrame *)f);
 					else *((FBXFrame *)fb) = *((CompressedFrame *)f);
 					pd.endFrame(f->hdr.width * f->hdr.height, 0,
 						(double)(f->hdr.width * f->hdr.height) /
@@ -16,6 +16,7 @@
 #define __CLIENTWIN_H__
 
 #include "Frame.h"
+#include "TileCache.h"
 #include "Thread.h"
 #include "GenericQ.h"
 
@@ -40,10 +41,14 @@ namespace vglclient
 
 			void initGL(void);
 			void initX11(void);
+			void drawScaled(void);
 
 			int drawMethod, reqDrawMethod;
 			static const int NFRAMES = 2;
 			vglcommon::Frame *fb;
+			// Used to scale up half-size frames when drawing with X11
+			vglcommon::FBXFrame *sfb;
+			vglcommon::TileStore tileStore;
 			vglcommon::CompressedFrame cframes[NFRAMES];  int cfindex;
 			#ifdef USEXV
 			vglcommon::XVFrame *xvframes[NFRAMES];
@@ -30,7 +30,7 @@ static int tjpf[PIXELFORMATS] =
 
 
 GLFrame::GLFrame(char *dpystring, Window win_) : Frame(), dpy(NULL), win(win_),
-	ctx(0), tjhnd(NULL), newdpy(false)
+	ctx(0), tjhnd(NULL), sliceDecoder(NULL), newdpy(false)
 {
 	if(!dpystring || !win)
 		throw(Error("GLFrame::GLFrame", "Invalid argument"));
@@ -43,7 +43,7 @@ GLFrame::GLFrame(char *dpystring, Window win_) : Frame(), dpy(NULL), win(win_),
 
 
 GLFrame::GLFrame(Display *dpy_, Window win_) : Frame(), dpy(NULL), win(win_),
-	ctx(0), tjhnd(NULL), newdpy(false)
+	ctx(0), tjhnd(NULL), sliceDecoder(NULL), newdpy(false)
 {
 	if(!dpy_ || !win_) throw(Error("GLFrame::GLFrame", "Invalid argument"));
 
@@ -106,18 +106,50 @@ GLFrame::~GLFrame(void)
 	{
 		tjDestroy(tjhnd);  tjhnd = NULL;
 	}
+	delete sliceDecoder;  sliceDecoder = NULL;
 	delete [] rbits;  rbits = NULL;
 }
 
 
 void GLFrame::init(rrframeheader &h, bool stereo_)
 {
-	int format = PF_RGB;
-	if(LittleEndian() && h.compress != RRCOMP_RGB) format = PF_BGR;
+	// Only JPEG and RGB tiles determine the frame's pixel format.  The other
+	// tile types can be decoded into any pixel format, and the VGL Transport
+	// may mix them with JPEG or RGB tiles in the same frame (see
+	// VGL_ADAPTIVE), so they use the existing pixel format.
+	int format = LittleEndian() ? PF_BGR : PF_RGB;
+	if(h.compress == RRCOMP_RGB) format = PF_RGB;
+	else if(h.compress != RRCOMP_JPEG && bits) format = pf->id;
+
+	// Frame::init() retains the contents of the frame if its dimensions are
+	// unchanged, and the server does not resend tiles that have not changed,
+	// so convert the existing pixels if the pixel format changes.
+	if(bits && format != pf->id && h.framew == hdr.framew
+		&& h.frameh == hdr.frameh)
+	{
+		PF *newpf = pf_get(format);
+		convertBits(bits, newpf);
+		if(stereo_ && rbits) convertBits(rbits, newpf);
+	}
 	Frame::init(h, format, FRAME_BOTTOMUP, stereo_);
 }
 
 
+// Convert a frame buffer in place from the frame's current pixel format to a
+// pixel format of the same size
+
+void GLFrame::convertBits(unsigned char *buf, PF *newpf)
+{
+	if(newpf->size != pf->size) return;
+	for(int i = 0; i < hdr.framew * hdr.frameh; i++, buf += pf->size)
+	{
+		int r, g, b;
+		pf->getRGB(buf, &r, &g, &b);
+		newpf->setRGB(buf, r, g, b);
+	}
+}
+
+
 GLFrame &GLFrame::operator= (CompressedFrame &cf)
 {
 	int tjflags = TJ_BOTTOMUP;
@@ -125,6 +157,16 @@ GLFrame &GLFrame::operator= (CompressedFrame &cf)
 	if(!cf.bits || cf.hdr.size < 1) THROW("JPEG not initialized");
 	init(cf.hdr, cf.stereo);
 	if(!bits) THROW("Frame not initialized");
+	if(cf.hdr.compress == RRCOMP_COPYRECT)
+	{
+		copyRect(cf);
+		return *this;
+	}
+	if(cf.hdr.compress == RRCOMP_SOLID)
+	{
+		fill(cf);
+		return *this;
+	}
 	int width = min(cf.hdr.width, hdr.framew - cf.hdr.x);
 	int height = min(cf.hdr.height, hdr.frameh - cf.hdr.y);
 	if(width > 0 && height > 0 && cf.hdr.width <= width
@@ -136,6 +178,19 @@ GLFrame &GLFrame::operator= (CompressedFrame &cf)
 			if(stereo && cf.rbits && rbits)
 				decompressRGB(cf, width, height, true);
 		}
+		else if(cf.hdr.compress == RRCOMP_LOSSLESS
+			|| cf.hdr.compress == RRCOMP_DELTA)
+		{
+			decompressLossless(cf, width, height, false);
+			if(stereo && cf.rbits && rbits)
+				decompressLossless(cf, width, height, true);
+		}
+		else if(cf.hdr.compress == RRCOMP_JPEGSLICES)
+		{
+			if(!sliceDecoder)
+				NEWCHECK(sliceDecoder = new SliceDecoder(min(NumProcs(), MAXPROCS)));
+			sliceDecoder->decode(*this, cf);
+		}
 		else
 		{
 			if(!tjhnd)
@@ -159,14 +214,14 @@ GLFrame &GLFrame::operator= (CompressedFrame &cf)
 }
 
 
-void GLFrame::redraw(void)
+void GLFrame::redraw(int scale)
 {
-	drawTile(0, 0, hdr.framew, hdr.frameh);
+	drawTile(0, 0, hdr.framew, hdr.frameh, scale);
 	sync();
 }
 
 
-void GLFrame::drawTile(int x, int y, int width, int height)
+void GLFrame::drawTile(int x, int y, int width, int height, int scale)
 {
 	if(x < 0 || width < 1 || (x + width) > hdr.framew || y < 0 || height < 1
 		|| (y + height) > hdr.frameh)
@@ -184,7 +239,8 @@ void GLFrame::drawTile(int x, int y, int width, int height)
 	int oldbuf = -1;
 	glGetIntegerv(GL_DRAW_BUFFER, &oldbuf);
 	if(stereo) glDrawBuffer(GL_BACK_LEFT);
-	glViewport(0, 0, hdr.framew, hdr.frameh);
+	glViewport(0, 0, hdr.framew * scale, hdr.frameh * scale);
+	glPixelZoom((GLfloat)scale, (GLfloat)scale);
 	glRasterPos2f(((float)x / (float)hdr.framew) * 2.0f - 1.0f,
 		((float)y / (float)hdr.frameh) * 2.0f - 1.0f);
 	glDrawPixels(width, height, glFormat, GL_UNSIGNED_BYTE,
@@ -198,6 +254,7 @@ void GLFrame::drawTile(int x, int y, int width, int height)
 			&rbits[pitch * y + x * pf->size]);
 		glDrawBuffer(oldbuf);
 	}
+	glPixelZoom(1.0f, 1.0f);
 
 	if(glError()) THROW("Could not draw pixels");
 }
@@ -31,18 +31,21 @@ namespace vglcommon
 			~GLFrame(void);
 			void init(rrframeheader &h, bool stereo);
 			GLFrame &operator= (CompressedFrame &cf);
-			void redraw(void);
-			void drawTile(int x, int y, int width, int height);
+			// If scale is 2, then the frame is drawn at twice its size.
+			void redraw(int scale = 1);
+			void drawTile(int x, int y, int width, int height, int scale = 1);
 			void sync(void);
 
 		private:
 
 			void init(void);
+			void convertBits(unsigned char *buf, PF *newpf);
 			int glError(void);
 
 			Display *dpy;  Window win;
 			GLXContext ctx;
 			tjhandle tjhnd;
+			SliceDecoder *sliceDecoder;
 			bool newdpy;
 	};
 }
@@ -14,6 +14,7 @@
 
 #include "VGLTransReceiver.h"
 #include "vglutil.h"
+#include "FrameTrace.h"
 
 using namespace vglutil;
 using namespace vglcommon;
@@ -179,6 +180,21 @@ void VGLTransReceiver::Listener::run(void)
 			recv((char *)&v, sizeof_rrversion);
 			if(strncmp(v.id, "VGL", 3) || v.major < 1)
 				THROW("Error reading server version");
+			if(v.major > 2 || (v.major == 2 && v.minor >= 2))
+			{
+				// Tell the server how much memory (in kilobytes) each window's tile
+				// cache may use.
+				unsigned int kb = RR_DEFAULTTILECACHE * 1024;  char *env = NULL;
+				if((env = getenv("VGLCLIENT_TILECACHE")) != NULL && strlen(env) > 0)
+				{
+					int mb = atoi(env);
+					if(mb >= 0 && mb <= 4096) kb = mb * 1024;
+				}
+				unsigned char buf[4] = { (unsigned char)(kb & 0xFF),
+					(unsigned char)((kb >> 8) & 0xFF), (unsigned char)((kb >> 16) & 0xFF),
+					(unsigned char)(kb >> 24) };
+				send((char *)buf, 4);
+			}
 		}
 
 		char *env = NULL;
@@ -189,6 +205,8 @@ void VGLTransReceiver::Listener::run(void)
 
 		while(1)
 		{
+			unsigned int traceID = frametrace.newFrameID();
+
 			do
 			{
 				if(v.major == 1 && v.minor == 0)
@@ -206,6 +224,19 @@ void VGLTransReceiver::Listener::run(void)
 					recv((char *)&h, sizeof_rrframeheader);
 					ENDIANIZE(h);
 				}
+				if(h.compress == RRCOMP_FRAMEID && h.flags != RR_EOF)
+				{
+					// The server's ID for this frame replaces ours.
+					unsigned char data[4];
+					if(h.size != 4) THROW("Invalid frame ID");
+					recv((char *)data, 4);
+					traceID = data[0] | (data[1] << 8) | (data[2] << 16)
+						| ((unsigned int)data[3] << 24);
+					f = NULL;
+					continue;
+				}
+				bool halfSize = (h.flags == (RR_EOF | RR_HALFSIZE));
+				if(halfSize) h.flags = RR_EOF;
 				bool stereo = (h.flags == RR_LEFT || h.flags == RR_RIGHT);
 				unsigned short dpynum =
 					(v.major < 2 || (v.major == 2 && v.minor < 1)) ?
@@ -230,8 +261,15 @@ void VGLTransReceiver::Listener::run(void)
 				else
 				#endif
 				((CompressedFrame *)f)->init(h, h.flags);
+				if(halfSize) f->flags |= FRAME_HALFSIZE;
+				else f->flags &= ~FRAME_HALFSIZE;
+				f->traceID = traceID;
 				if(h.flags != RR_EOF)
+				{
+					double traceStart = frametrace.time();
 					recv((char *)(h.flags == RR_RIGHT ? f->rbits : f->bits), h.size);
+					frametrace.record("Receive", traceID, traceStart);
+				}
 
 				if(!stereo || h.flags != RR_LEFT)
 				{
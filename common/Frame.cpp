@@ -39,7 +39,8 @@ static int tjpf[PIXELFORMATS] =
 // Uncompressed frame
 
 Frame::Frame(bool primary_) : bits(NULL), rbits(NULL), pitch(0), flags(0),
-	pf(pf_get(-1)), isGL(false), isXV(false), stereo(false), primary(primary_)
+	pf(pf_get(-1)), isGL(false), isXV(false), stereo(false), traceID(0),
+	traceTime(0.0), pointerX(-1), pointerY(-1), primary(primary_)
 {
 	memset(&hdr, 0, sizeof(rrframeheader));
 	ready.wait();
@@ -192,6 +193,386 @@ bool Frame::tileEquals(Frame *last, int x, int y, int width, int height)
 }
 
 
+// Returns the number of pixels in the given tile that differ from the same
+// pixels in last, or -1 if last is not compatible with this frame (in which
+// case the tile must be sent in its entirety.)  Counting stops once the number
+// of changed pixels exceeds limit.
+
+int Frame::tileChanges(Frame *last, int x, int y, int width, int height,
+	int limit)
+{
+	bool bu = (flags & FRAME_BOTTOMUP);
+	int changes = 0;
+
+	if(x < 0 || y < 0 || width < 1 || height < 1 || (x + width) > hdr.width
+		|| (y + height) > hdr.height)
+		throw Error("Frame::tileChanges", "Argument out of range");
+
+	if(!isCompatible(last)) return -1;
+
+	for(int eye = 0; eye < (stereo && rbits ? 2 : 1); eye++)
+	{
+		unsigned char *newBits = eye ? rbits : bits,
+			*oldBits = eye ? last->rbits : last->bits;
+		int offset = pitch * (bu ? hdr.height - y - height : y) + pf->size * x;
+		newBits += offset;  oldBits += offset;
+		for(int i = 0; i < height; i++, newBits += pitch, oldBits += pitch)
+		{
+			if(!memcmp(newBits, oldBits, pf->size * width)) continue;
+			for(int j = 0; j < width * pf->size; j += pf->size)
+			{
+				if(memcmp(&newBits[j], &oldBits[j], pf->size)) changes++;
+			}
+			if(changes > limit) return changes;
+		}
+	}
+	return changes;
+}
+
+
+// Returns true if this frame and last have the same dimensions, layout, and
+// compression settings, and thus the pixels of one can be compared with (or
+// used to reconstruct) the pixels of the other
+
+bool Frame::isCompatible(Frame *last)
+{
+	return last && hdr.width == last->hdr.width
+		&& hdr.height == last->hdr.height && hdr.framew == last->hdr.framew
+		&& hdr.frameh == last->hdr.frameh && pf->id == last->pf->id
+		&& pitch == last->pitch && flags == last->flags
+		&& hdr.qual == last->hdr.qual && hdr.subsamp == last->hdr.subsamp
+		&& hdr.winid == last->hdr.winid && hdr.dpynum == last->hdr.dpynum
+		&& bits && last->bits && (!stereo || !rbits || last->rbits);
+}
+
+
+// Returns the approximate percentage of the pixels in this frame that differ
+// from the same pixels in last, or 100 if last is not compatible with this
+// frame.  Only every 8th pixel in every 8th row is compared, which is enough
+// to distinguish continuous motion from small, localized changes.
+
+int Frame::percentChanged(Frame *last)
+{
+	int ps = pf->size, samples = 0, changes = 0;
+
+	if(!isCompatible(last)) return 100;
+
+	for(int i = 0; i < hdr.frameh; i += 8)
+	{
+		unsigned char *newRow = &bits[pitch * i],
+			*oldRow = &last->bits[last->pitch * i];
+		for(int j = 0; j < hdr.framew * ps; j += 8 * ps, samples++)
+		{
+			if(memcmp(&newRow[j], &oldRow[j], ps)) changes++;
+		}
+	}
+	return samples ? changes * 100 / samples : 0;
+}
+
+
+// Returns a hash of the frame's dimensions, pixel format, and every 8th row of
+// pixels.  Frames with different fingerprints are different, but frames with
+// the same fingerprint must be compared (see tileEquals()) in order to
+// determine whether they are identical.  Each 8-byte word is mixed into one of
+// four independent hashes with a bijective step, so a change to any one word
+// in the sampled rows always changes the fingerprint.
+
+#define FP_PRIME  0x100000001b3ULL
+
+unsigned long long Frame::fingerprint(void)
+{
+	unsigned long long h[4] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL,
+		0xcbf29ce484222325ULL ^ FP_PRIME, 0x84222325cbf29ce4ULL ^ FP_PRIME }, k[4];
+	int rowSize = hdr.framew * pf->size;
+
+	for(int eye = 0; eye < (stereo && rbits ? 2 : 1); eye++)
+	{
+		for(int i = 0; i < hdr.frameh; i += 8)
+		{
+			unsigned char *row = &(eye ? rbits : bits)[pitch * i];
+			int j;
+			for(j = 0; j <= rowSize - 32; j += 32)
+			{
+				memcpy(k, &row[j], 32);
+				h[0] = (h[0] ^ k[0]) * FP_PRIME;  h[1] = (h[1] ^ k[1]) * FP_PRIME;
+				h[2] = (h[2] ^ k[2]) * FP_PRIME;  h[3] = (h[3] ^ k[3]) * FP_PRIME;
+			}
+			for(; j < rowSize; j += 8)
+			{
+				k[0] = 0;  memcpy(k, &row[j], min(rowSize - j, 8));
+				h[0] = (h[0] ^ k[0]) * FP_PRIME;
+			}
+		}
+	}
+	h[0] = (h[0] ^ (hdr.framew | ((unsigned long long)hdr.frameh << 16)
+		| ((unsigned long long)pf->id << 32))) * FP_PRIME;
+	for(int i = 1; i < 4; i++) h[0] = (h[0] ^ h[i]) * FP_PRIME;
+	return h[0];
+}
+
+
+// Set this frame to a copy of src that has been reduced to half the width and
+// height (rounded up) using a 2x2 box filter.  The rows are filtered in memory
+// order, so this frame has the same row order and pixel format as src.
+
+void Frame::downsample(Frame &src)
+{
+	if(!src.bits || src.pf->bpc != 8 || src.stereo)
+		throw(Error("Frame::downsample", "Invalid argument"));
+
+	rrframeheader h = src.hdr;
+	h.framew = h.width = (src.hdr.framew + 1) / 2;
+	h.frameh = h.height = (src.hdr.frameh + 1) / 2;
+	h.x = h.y = 0;  h.size = 0;
+	init(h, src.pf->id, src.flags);
+	pointerX = src.pointerX >= 0 ? src.pointerX / 2 : -1;
+	pointerY = src.pointerY >= 0 ? src.pointerY / 2 : -1;
+
+	int ps = pf->size, srcW = src.hdr.framew;
+
+	for(int i = 0; i < hdr.frameh; i++)
+	{
+		unsigned char *r0 = &src.bits[src.pitch * 2 * i],
+			*r1 = 2 * i + 1 < src.hdr.frameh ? r0 + src.pitch : r0,
+			*dst = &bits[pitch * i];
+		int j = 0;
+
+		if(ps == 4)
+		{
+			// Average all four components of each pair of pixels at once, using
+			// 16-bit lanes within 64-bit words
+			for(; j < srcW / 2; j++, r0 += 8, r1 += 8, dst += 4)
+			{
+				unsigned long long a, b, lo, hi;
+				memcpy(&a, r0, 8);  memcpy(&b, r1, 8);
+				lo = (a & 0x00FF00FF00FF00FFULL) + (b & 0x00FF00FF00FF00FFULL);
+				hi = ((a >> 8) & 0x00FF00FF00FF00FFULL)
+					+ ((b >> 8) & 0x00FF00FF00FF00FFULL);
+				unsigned int l, h, p;
+				l = (unsigned int)lo + (unsigned int)(lo >> 32) + 0x00020002;
+				h = (unsigned int)hi + (unsigned int)(hi >> 32) + 0x00020002;
+				p = ((l >> 2) & 0x00FF00FF) | (((h >> 2) & 0x00FF00FF) << 8);
+				memcpy(dst, &p, 4);
+			}
+		}
+		else
+		{
+			for(; j < srcW / 2; j++, r0 += 2 * ps, r1 += 2 * ps, dst += ps)
+			{
+				for(int k = 0; k < ps; k++)
+					dst[k] = (r0[k] + r0[k + ps] + r1[k] + r1[k + ps] + 2) >> 2;
+			}
+		}
+		// The last column of an odd-width frame
+		if(j < hdr.framew)
+		{
+			for(int k = 0; k < ps; k++) dst[k] = (r0[k] + r1[k] + 1) >> 1;
+		}
+	}
+}
+
+
+// Scale src up by 2x (by replicating its pixels) into this frame, which must
+// already be initialized and must have the same pixel format as src.  Pixels
+// that fall outside of this frame are discarded.
+
+void Frame::upsample(Frame &src)
+{
+	if(!bits || !src.bits || src.pf->id != pf->id)
+		throw(Error("Frame::upsample", "Invalid argument"));
+
+	bool bu = (flags & FRAME_BOTTOMUP), srcbu = (src.flags & FRAME_BOTTOMUP);
+	int ps = pf->size, w = min(hdr.framew, src.hdr.framew * 2),
+		h = min(hdr.frameh, src.hdr.frameh * 2);
+	unsigned char *lastDst = NULL;
+
+	for(int i = 0; i < h; i++)
+	{
+		unsigned char *dst = &bits[pitch * (bu ? hdr.frameh - i - 1 : i)];
+		if(i & 1)
+		{
+			memcpy(dst, lastDst, w * ps);  continue;
+		}
+		unsigned char *srcPixel =
+			&src.bits[src.pitch * (srcbu ? src.hdr.frameh - i / 2 - 1 : i / 2)];
+		int j = 0;
+
+		if(ps == 4)
+		{
+			for(; j < w / 2; j++, srcPixel += 4, dst += 8)
+			{
+				memcpy(dst, srcPixel, 4);  memcpy(&dst[4], srcPixel, 4);
+			}
+			j *= 2;
+		}
+		for(; j < w; j++, dst += ps)
+		{
+			memcpy(dst, srcPixel, ps);
+			if(j & 1) srcPixel += ps;
+		}
+		lastDst = &bits[pitch * (bu ? hdr.frameh - i - 1 : i)];
+	}
+}
+
+
+// Copy a region of this frame to another location in the same frame.  The
+// coordinates are relative to the top of the frame, regardless of the row
+// order.
+
+void Frame::copyRect(int srcX, int srcY, int dstX, int dstY, int width,
+	int height)
+{
+	bool bu = (flags & FRAME_BOTTOMUP);
+
+	if(!bits) THROW("Frame not initialized");
+	if(srcX < 0 || srcY < 0 || dstX < 0 || dstY < 0 || width < 1 || height < 1
+		|| srcX + width > hdr.framew || srcY + height > hdr.frameh
+		|| dstX + width > hdr.framew || dstY + height > hdr.frameh)
+		throw Error("Frame::copyRect", "Argument out of range");
+
+	int srcRow = bu ? hdr.frameh - srcY - height : srcY;
+	int dstRow = bu ? hdr.frameh - dstY - height : dstY;
+	int rowSize = width * pf->size;
+
+	for(int buffer = 0; buffer < (stereo && rbits ? 2 : 1); buffer++)
+	{
+		unsigned char *buf = buffer ? rbits : bits;
+		unsigned char *src = &buf[pitch * srcRow + srcX * pf->size];
+		unsigned char *dst = &buf[pitch * dstRow + dstX * pf->size];
+
+		// If the regions overlap, then copy the rows in the order that prevents
+		// a source row from being overwritten before it is copied.
+		if(dstRow > srcRow)
+		{
+			for(int i = height - 1; i >= 0; i--)
+				memmove(&dst[pitch * i], &src[pitch * i], rowSize);
+		}
+		else
+		{
+			for(int i = 0; i < height; i++)
+				memmove(&dst[pitch * i], &src[pitch * i], rowSize);
+		}
+	}
+}
+
+
+void Frame::copyRect(CompressedFrame &f)
+{
+	if(!f.bits || f.hdr.size < 4) THROW("Frame not initialized");
+	copyRect(f.bits[0] | (f.bits[1] << 8), f.bits[2] | (f.bits[3] << 8),
+		f.hdr.x, f.hdr.y, f.hdr.width, f.hdr.height);
+}
+
+
+// Fill the region of an RRCOMP_SOLID tile with the tile's color
+
+void Frame::fill(CompressedFrame &f)
+{
+	bool bu = (flags & FRAME_BOTTOMUP);
+
+	if(!bits || !f.bits || f.hdr.size < 3) THROW("Frame not initialized");
+	if(f.hdr.width < 1 || f.hdr.height < 1
+		|| f.hdr.x + f.hdr.width > hdr.framew
+		|| f.hdr.y + f.hdr.height > hdr.frameh)
+		throw Error("Frame::fill", "Argument out of range");
+
+	int startLine = bu ? hdr.frameh - f.hdr.y - f.hdr.height : f.hdr.y;
+	unsigned char *dst = &bits[pitch * startLine + f.hdr.x * pf->size];
+
+	// Convert the color once, and then replicate it.
+	pf_get(PF_RGB)->convert(f.bits, 1, 3, 1, dst, pitch, pf);
+	for(int j = 1; j < f.hdr.width; j++)
+		memcpy(&dst[pf->size * j], dst, pf->size);
+	for(int i = 1; i < f.hdr.height; i++)
+		memcpy(&dst[pitch * i], dst, pf->size * f.hdr.width);
+}
+
+
+// Classify the contents of this frame (normally a tile), so that the VGL
+// Transport can choose an encoding for it.  The distinct colors are counted
+// until there are too many of them to encode losslessly, and then the
+// proportion of sharp horizontal edges is estimated from every fourth row.
+
+#define CLASSIFY_MAXCOLORS  64
+#define CLASSIFY_EDGE  128  // Sum of the component differences across an edge
+#define CLASSIFY_SHARP  32  // Tiles with > 1/32 sharp edges are TILE_SHARP
+
+int Frame::classify(void)
+{
+	unsigned int colors[CLASSIFY_MAXCOLORS * 2];
+	bool used[CLASSIFY_MAXCOLORS * 2];
+	int nColors = 0, ps = pf->size;
+	bool many = false;
+
+	if(!bits) THROW("Frame not initialized");
+	if(pf->bpc != 8) return TILE_SMOOTH;
+	memset(used, 0, sizeof(used));
+
+	for(int i = 0; i < hdr.height && !many; i++)
+	{
+		unsigned char *p = &bits[pitch * i];
+		unsigned int prev = 0;
+		for(int j = 0; j < hdr.width; j++, p += ps)
+		{
+			unsigned int c = p[pf->rindex] | (p[pf->gindex] << 8)
+				| (p[pf->bindex] << 16);
+			if(j > 0 && c == prev) continue;
+			prev = c;
+			int h = (c * 2654435761U) >> 25;
+			while(used[h] && colors[h] != c)
+				h = (h + 1) % (CLASSIFY_MAXCOLORS * 2);
+			if(used[h]) continue;
+			if(nColors >= CLASSIFY_MAXCOLORS) { many = true;  break; }
+			used[h] = true;  colors[h] = c;  nColors++;
+		}
+	}
+	if(!many) return nColors <= 1 ? TILE_SOLID : TILE_FEWCOLORS;
+
+	long edges = 0, pairs = 0;
+	for(int i = 0; i < hdr.height; i += 4)
+	{
+		unsigned char *p = &bits[pitch * i + ps];
+		for(int j = 1; j < hdr.width; j++, p += ps)
+		{
+			unsigned char *q = p - ps;
+			if(abs(p[pf->rindex] - q[pf->rindex])
+				+ abs(p[pf->gindex] - q[pf->gindex])
+				+ abs(p[pf->bindex] - q[pf->bindex]) > CLASSIFY_EDGE)
+				edges++;
+		}
+		pairs += hdr.width - 1;
+	}
+	return edges * CLASSIFY_SHARP > pairs ? TILE_SHARP : TILE_SMOOTH;
+}
+
+
+// Choose the encoding for this frame (normally a tile) based on its contents
+// (see VGL_ADAPTIVE.)  Single-color tiles are sent as solid tiles, and tiles
+// with few colors, such as text and UI elements, are encoded losslessly.  When
+// using JPEG, tiles with many sharp edges are compressed with a quality of at
+// least 95 and without chrominance subsampling.
+
+void Frame::selectEncoding(void)
+{
+	switch(classify())
+	{
+		case TILE_SOLID:
+			hdr.compress = RRCOMP_SOLID;
+			break;
+		case TILE_FEWCOLORS:
+			hdr.compress = RRCOMP_LOSSLESS;
+			break;
+		case TILE_SHARP:
+			if(hdr.compress == RRCOMP_JPEG)
+			{
+				hdr.qual = max(hdr.qual, 95);
+				if(hdr.subsamp > 1) hdr.subsamp = 1;
+			}
+			break;
+	}
+}
+
+
 void Frame::makeAnaglyph(Frame &r, Frame &g, Frame &b)
 {
 	int i, j;
@@ -301,6 +682,315 @@ void Frame::decompressRGB(Frame &f, int width, int height, bool rightEye)
 }
 
 
+// Lossless codec.  Each tile is coded as a sequence of rows (top to bottom),
+// and each row is coded as a sequence of the following operations, none of
+// which crosses a row boundary:
+//
+// 00nnnnnn           = Repeat the previous pixel n times
+// 01nnnnnn           = Copy n pixels from the row above
+// 10iiiiii           = Pixel i in the table of recently used pixels
+// 110ggggg rrrrbbbb  = Pixel that differs from the previous pixel by
+//                      (dr, dg, db) = (r + g - 8, g - 16, b + g - 8)
+// 1110nnnn           = n + 1 literal RGB pixels (3 * (n + 1) bytes follow)
+// 1111nnnn           = Skip n pixels (delta tiles only)
+//
+// Run lengths of 1-62 are stored as n - 1.  n = 62 indicates that the run
+// length minus 63 is stored in the next byte, and n = 63 indicates that the
+// run length minus 319 is stored in the next two bytes (little endian.)  The
+// previous pixel is initially black, and the table of recently used pixels is
+// initially all black.  The table entry for a pixel is updated whenever that
+// pixel is the last (or only) pixel produced by an operation.  Runs of
+// identical pixels and copies from the row above make this very effective for
+// synthetic imagery (CAD, medical, and GUI content), and the codec uses only
+// byte operations, so it is fast on any CPU.
+//
+// A delta tile (RRCOMP_DELTA) contains only the pixels that have changed since
+// the previous frame.  The other pixels are skipped, leaving the pixels that
+// the client already has.  Skip lengths of 1-14 are stored as n - 1, n = 14
+// indicates that the length minus 15 is stored in the next byte, and n = 15
+// indicates that the length minus 271 is stored in the next two bytes.
+// Skipped pixels do not affect the previous pixel or the table of recently
+// used pixels, and delta tiles never copy from the row above, since the
+// client's copy of a skipped pixel may not exactly match the server's (if the
+// previous frame was JPEG-compressed, for instance.)  This makes a delta tile
+// very compact when only a small part of the tile has changed (a cursor or a
+// text label, for instance.)
+
+#define LL_RUN  0x00
+#define LL_UP  0x40
+#define LL_INDEX  0x80
+#define LL_DIFF  0xC0
+#define LL_LITERAL  0xE0
+#define LL_SKIP  0xF0
+#define LL_MAXLITERAL  16
+
+#define LL_HASH(r, g, b)  ((r * 3 + g * 5 + b * 7) & 63)
+#define LL_PIXEL(r, g, b)  ((unsigned int)r | ((unsigned int)g << 8) \
+	| ((unsigned int)b << 16))
+#define LL_GET(p)  LL_PIXEL((p)[0], (p)[1], (p)[2])
+
+// Worst-case size of a lossless-coded tile
+#define LL_BUFSIZE(w, h)  ((unsigned long)(h) * ((w) * 3 + ((w) + 15) / 16))
+
+typedef struct
+{
+	unsigned int prev;
+	unsigned int table[64];
+} LLState;
+
+
+// mask = the bits of the operation that hold the run length (63 for runs and
+// copies, 15 for skips)
+
+static unsigned char *llPutRun(unsigned char *dst, int op, int n,
+	int mask = 63)
+{
+	if(n < mask) *dst++ = op | (n - 1);
+	else if(n < mask + 256)
+	{
+		*dst++ = op | (mask - 1);  *dst++ = n - mask;
+	}
+	else
+	{
+		n -= mask + 256;
+		*dst++ = op | mask;  *dst++ = n & 0xFF;  *dst++ = n >> 8;
+	}
+	return dst;
+}
+
+
+static unsigned char *llGetRun(unsigned char *src, unsigned char *end,
+	int op, int &n, int mask = 63)
+{
+	n = op & mask;
+	if(n == mask - 1)
+	{
+		if(src >= end) THROW("Lossless decoder: Unexpected end of data");
+		n = mask + *src++;
+	}
+	else if(n == mask)
+	{
+		if(src + 1 >= end) THROW("Lossless decoder: Unexpected end of data");
+		n = mask + 256 + (src[0] | (src[1] << 8));  src += 2;
+	}
+	else n++;
+	return src;
+}
+
+
+// If last is non-NULL, then it is the same row in the previous frame, and
+// pixels that haven't changed are skipped.
+
+static unsigned char *llEncodeRow(unsigned char *row, unsigned char *above,
+	unsigned char *last, int width, unsigned char *dst, LLState &state)
+{
+	unsigned char *literal = NULL;  int x = 0;
+
+	while(x < width)
+	{
+		unsigned char *pixel = &row[x * 3];
+		unsigned int p = LL_GET(pixel);
+		int run = 0, up = 0, skip = 0;
+
+		if(last)
+		{
+			while(x + skip < width
+				&& !memcmp(&row[(x + skip) * 3], &last[(x + skip) * 3], 3))
+				skip++;
+			if(skip > 0)
+			{
+				literal = NULL;
+				dst = llPutRun(dst, LL_SKIP, skip, 15);
+				x += skip;
+				continue;
+			}
+		}
+
+		while(x + run < width && LL_GET(&row[(x + run) * 3]) == state.prev)
+			run++;
+		if(above)
+		{
+			while(x + up < width
+				&& !memcmp(&row[(x + up) * 3], &above[(x + up) * 3], 3))
+				up++;
+		}
+		if(run > 0 || up > 0)
+		{
+			literal = NULL;
+			if(run >= up) dst = llPutRun(dst, LL_RUN, run);
+			else
+			{
+				dst = llPutRun(dst, LL_UP, up);
+				run = up;
+				unsigned char *last = &row[(x + up - 1) * 3];
+				state.prev = LL_GET(last);
+			}
+			x += run;
+			state.table[LL_HASH((state.prev & 0xFF), ((state.prev >> 8) & 0xFF),
+				(state.prev >> 16))] = state.prev;
+			continue;
+		}
+
+		int hash = LL_HASH(pixel[0], pixel[1], pixel[2]);
+		int dr = (int)pixel[0] - (int)(state.prev & 0xFF);
+		int dg = (int)pixel[1] - (int)((state.prev >> 8) & 0xFF);
+		int db = (int)pixel[2] - (int)(state.prev >> 16);
+		if(state.table[hash] == p)
+		{
+			literal = NULL;
+			*dst++ = LL_INDEX | hash;
+		}
+		else if(dg >= -16 && dg <= 15 && dr - dg >= -8 && dr - dg <= 7
+			&& db - dg >= -8 && db - dg <= 7)
+		{
+			literal = NULL;
+			*dst++ = LL_DIFF | (dg + 16);
+			*dst++ = ((dr - dg + 8) << 4) | (db - dg + 8);
+		}
+		else
+		{
+			if(!literal || (*literal & 0x0F) == LL_MAXLITERAL - 1)
+			{
+				literal = dst;  *dst++ = LL_LITERAL;
+			}
+			else (*literal)++;
+			*dst++ = pixel[0];  *dst++ = pixel[1];  *dst++ = pixel[2];
+		}
+		state.table[hash] = state.prev = p;
+		x++;
+	}
+	return dst;
+}
+
+
+// If delta is true, then row must contain the client's copy of the row in the
+// previous frame, and skipped pixels retain their values.
+
+static unsigned char *llDecodeRow(unsigned char *src, unsigned char *end,
+	unsigned char *row, unsigned char *above, int width, LLState &state,
+	bool delta)
+{
+	int x = 0;
+
+	while(x < width)
+	{
+		if(src >= end) THROW("Lossless decoder: Unexpected end of data");
+		int op = *src++;
+
+		if(op < LL_INDEX)
+		{
+			int n;
+			src = llGetRun(src, end, op, n);
+			if(x + n > width) THROW("Lossless decoder: Corrupt data");
+			if(op >= LL_UP)
+			{
+				if(!above) THROW("Lossless decoder: Corrupt data");
+				memcpy(&row[x * 3], &above[x * 3], n * 3);
+				x += n;
+				state.prev = LL_GET(&row[(x - 1) * 3]);
+			}
+			else
+			{
+				unsigned char r = state.prev & 0xFF, g = (state.prev >> 8) & 0xFF,
+					b = state.prev >> 16;
+				for(unsigned char *pixel = &row[x * 3]; n > 0; n--, x++, pixel += 3)
+				{
+					pixel[0] = r;  pixel[1] = g;  pixel[2] = b;
+				}
+			}
+		}
+		else if(op < LL_DIFF)
+		{
+			unsigned int p = state.table[op & 63];
+			unsigned char *pixel = &row[x * 3];
+			pixel[0] = p & 0xFF;  pixel[1] = (p >> 8) & 0xFF;  pixel[2] = p >> 16;
+			state.prev = p;  x++;
+			continue;
+		}
+		else if(op < LL_LITERAL)
+		{
+			if(src >= end) THROW("Lossless decoder: Unexpected end of data");
+			int dg = (op & 31) - 16;
+			int dr = (*src >> 4) - 8 + dg, db = (*src & 15) - 8 + dg;
+			src++;
+			unsigned char *pixel = &row[x * 3];
+			pixel[0] = (unsigned char)((state.prev & 0xFF) + dr);
+			pixel[1] = (unsigned char)(((state.prev >> 8) & 0xFF) + dg);
+			pixel[2] = (unsigned char)((state.prev >> 16) + db);
+			state.prev = LL_GET(pixel);  x++;
+		}
+		else if(op < 0xF0)
+		{
+			int n = (op & 15) + 1;
+			if(x + n > width) THROW("Lossless decoder: Corrupt data");
+			if(src + n * 3 > end)
+				THROW("Lossless decoder: Unexpected end of data");
+			memcpy(&row[x * 3], src, n * 3);
+			for(int i = 0; i < n - 1; i++, src += 3)
+				state.table[LL_HASH(src[0], src[1], src[2])] = LL_GET(src);
+			state.prev = LL_GET(src);
+			src += 3;  x += n;
+		}
+		else
+		{
+			int n;
+			if(!delta) THROW("Lossless decoder: Corrupt data");
+			src = llGetRun(src, end, op, n, 15);
+			if(x + n > width) THROW("Lossless decoder: Corrupt data");
+			x += n;
+			continue;
+		}
+		state.table[LL_HASH((state.prev & 0xFF), ((state.prev >> 8) & 0xFF),
+			(state.prev >> 16))] = state.prev;
+	}
+	return src;
+}
+
+
+void Frame::decompressLossless(CompressedFrame &f, int width, int height,
+	bool rightEye)
+{
+	if(!f.bits || f.hdr.size < 1 || !bits || !hdr.size)
+		THROW("Frame not initialized");
+	if(pf->bpc < 8)
+		throw(Error("Lossless decoder",
+			"Destination frame has the wrong pixel format"));
+
+	bool dstbu = (flags & FRAME_BOTTOMUP);
+	int startLine = dstbu ? max(0, hdr.frameh - f.hdr.y - height) : f.hdr.y;
+	unsigned char *src = rightEye ? f.rbits : f.bits;
+	unsigned char *end = &src[rightEye ? f.rhdr.size : f.hdr.size];
+	unsigned char *dst = rightEye ? rbits : bits;
+	int rowSize = f.hdr.width * 3;
+	unsigned char *rows = NULL;
+	bool delta = ((rightEye ? f.rhdr : f.hdr).compress == RRCOMP_DELTA);
+	LLState state;
+
+	if((rows = (unsigned char *)malloc(rowSize * 2)) == NULL)
+		throw(Error("Lossless decoder", "Memory allocation error"));
+	memset(&state, 0, sizeof(LLState));
+	try
+	{
+		for(int i = 0; i < height; i++)
+		{
+			unsigned char *row = &rows[rowSize * (i & 1)],
+				*above = i > 0 && !delta ? &rows[rowSize * ((i - 1) & 1)] : NULL;
+			int line = dstbu ? startLine + height - 1 - i : startLine + i;
+			unsigned char *dstLine = &dst[pitch * line + f.hdr.x * pf->size];
+			if(delta)
+				pf->convert(dstLine, width, pitch, 1, row, rowSize, pf_get(PF_RGB));
+			src = llDecodeRow(src, end, row, above, f.hdr.width, state, delta);
+			pf_get(PF_RGB)->convert(row, width, rowSize, 1, dstLine, pitch, pf);
+		}
+	}
+	catch(...)
+	{
+		free(rows);  throw;
+	}
+	free(rows);
+}
+
+
 #define DRAWLOGO() \
 	switch(pf->size) \
 	{ \
@@ -343,66 +1033,528 @@ void Frame::decompressRGB(Frame &f, int width, int height, bool rightEye)
 	}
 
 
-void Frame::addLogo(void)
+void Frame::addLogo(void)
+{
+	unsigned char *rowptr, *logoptr = vgllogo, *logoptr2;
+
+	if(!bits || hdr.width < 1 || hdr.height < 1) return;
+
+	int height = min(VGLLOGO_HEIGHT, hdr.height - 1);
+	int width = min(VGLLOGO_WIDTH, hdr.width - 1);
+	int stride = flags & FRAME_BOTTOMUP ? -pitch : pitch;
+	if(height < 1 || width < 1) return;
+	if(flags & FRAME_BOTTOMUP)
+		rowptr = &bits[pitch * height + (hdr.width - width - 1) * pf->size];
+	else
+		rowptr = &bits[pitch * (hdr.height - height - 1) +
+			(hdr.width - width - 1) * pf->size];
+	DRAWLOGO()
+
+	if(!rbits) return;
+	logoptr = vgllogo;
+	if(flags & FRAME_BOTTOMUP)
+		rowptr = &rbits[pitch * height + (hdr.width - width - 1) * pf->size];
+	else
+		rowptr = &rbits[pitch * (hdr.height - height - 1) +
+			(hdr.width - width - 1) * pf->size];
+	logoptr = vgllogo;
+	DRAWLOGO()
+}
+
+
+void Frame::dumpHeader(rrframeheader &h)
+{
+	vglout.print("hdr.size    = %lu\n", h.size);
+	vglout.print("hdr.winid   = 0x%.8x\n", h.winid);
+	vglout.print("hdr.dpynum  = %d\n", h.dpynum);
+	vglout.print("hdr.compress= %d\n", h.compress);
+	vglout.print("hdr.framew  = %d\n", h.framew);
+	vglout.print("hdr.frameh  = %d\n", h.frameh);
+	vglout.print("hdr.width   = %d\n", h.width);
+	vglout.print("hdr.height  = %d\n", h.height);
+	vglout.print("hdr.x       = %d\n", h.x);
+	vglout.print("hdr.y       = %d\n", h.y);
+	vglout.print("hdr.qual    = %d\n", h.qual);
+	vglout.print("hdr.subsamp = %d\n", h.subsamp);
+	vglout.print("hdr.flags   = %d\n", h.flags);
+}
+
+
+void Frame::checkHeader(rrframeheader &h)
+{
+	if(h.flags != RR_EOF && (h.framew < 1 || h.frameh < 1 || h.width < 1
+		|| h.height < 1 || h.x + h.width > h.framew || h.y + h.height > h.frameh))
+	{
+		throw(Error("Frame::checkHeader", "Invalid header"));
+	}
+}
+
+
+// Scroll detection
+
+// Minimum height (or width) and area of a band of rows (or columns) that is
+// sent as a copy
+#define SCROLL_MINSIZE  16
+#define SCROLL_MINAREA  (64 * 64)
+// Rows (or columns) that occur more than this many times in the previous
+// frame (blank rows, for instance) don't vote on the offset.
+#define SCROLL_MAXMATCHES  2
+// Any band of SCROLL_MINSIZE rows contains at least two rows whose index is a
+// multiple of SCROLL_STRIDE, so only those rows of the new frame need to be
+// checked in order to rule out vertical scrolling.  Columns are hashed using
+// only the rows whose index is a multiple of SCROLL_STRIDE.
+#define SCROLL_STRIDE  (SCROLL_MINSIZE / 2)
+
+#define HASH_BASIS  0xCBF29CE484222325ULL
+#define HASH_PRIME  0x100000001B3ULL
+
+
+ScrollDetector::ScrollDetector(void) : x0(0), y0(0), x1(0), y1(0), maxN(0),
+	hashes(NULL), lastHashes(NULL), sorted(NULL), votes(NULL), equal(NULL)
+{
+}
+
+
+ScrollDetector::~ScrollDetector(void)
+{
+	free(hashes);  free(lastHashes);  free(sorted);  free(votes);  free(equal);
+}
+
+
+void ScrollDetector::alloc(int n)
+{
+	if(n <= maxN) return;
+	free(hashes);  free(lastHashes);  free(sorted);  free(votes);  free(equal);
+	maxN = 0;
+	if((hashes = (unsigned long long *)malloc(sizeof(unsigned long long) * n))
+			== NULL
+		|| (lastHashes =
+			(unsigned long long *)malloc(sizeof(unsigned long long) * n)) == NULL
+		|| (sorted = (HashEntry *)malloc(sizeof(HashEntry) * n)) == NULL
+		|| (votes = (int *)malloc(sizeof(int) * (2 * n + 1))) == NULL
+		|| (equal = (unsigned char *)malloc(n)) == NULL)
+		THROW("Memory allocation error");
+	maxN = n;
+}
+
+
+// Find the bounding box of the pixels that differ between f and last
+
+bool ScrollDetector::findBounds(Frame &f, Frame &last)
+{
+	int ps = f.pf->size, rowSize = f.hdr.width * ps;
+
+	y0 = -1;  x0 = f.hdr.width;  x1 = 0;
+	for(int r = 0; r < f.hdr.height; r++)
+	{
+		unsigned char *row = &f.bits[f.pitch * r],
+			*lastRow = &last.bits[last.pitch * r];
+		int x;
+
+		if(!memcmp(row, lastRow, rowSize)) continue;
+		if(y0 < 0) y0 = r;
+		y1 = r + 1;
+		for(x = 0; x < x0 && !memcmp(&row[x * ps], &lastRow[x * ps], ps); x++) {}
+		x0 = x;
+		for(x = f.hdr.width - 1; x >= x1 && !memcmp(&row[x * ps], &lastRow[x * ps],
+			ps); x--) {}
+		if(x + 1 > x1) x1 = x + 1;
+	}
+	return y0 >= 0;
+}
+
+
+// Hash every stride-th row of the changed region
+
+void ScrollDetector::hashRows(Frame &f, unsigned long long *h, int stride)
+{
+	int size = (x1 - x0) * f.pf->size;
+
+	for(int r = y0; r < y1; r += stride)
+	{
+		unsigned char *buf = &f.bits[f.pitch * r + x0 * f.pf->size];
+		unsigned long long hash[4] = {
+			HASH_BASIS, HASH_BASIS, HASH_BASIS, HASH_BASIS
+		}, word[4];
+		int i;
+
+		// Four independent hashes are computed, so that the multiplications
+		// can overlap.
+		for(i = 0; i + 32 <= size; i += 32)
+		{
+			memcpy(word, &buf[i], 32);
+			hash[0] = (hash[0] ^ word[0]) * HASH_PRIME;
+			hash[1] = (hash[1] ^ word[1]) * HASH_PRIME;
+			hash[2] = (hash[2] ^ word[2]) * HASH_PRIME;
+			hash[3] = (hash[3] ^ word[3]) * HASH_PRIME;
+		}
+		for(; i < size; i++) hash[0] = (hash[0] ^ buf[i]) * HASH_PRIME;
+		h[r - y0] = (((hash[0] * HASH_PRIME) ^ hash[1]) * HASH_PRIME ^ hash[2]) *
+			HASH_PRIME ^ hash[3];
+	}
+}
+
+
+// Hash the columns of the changed region, using only every stride-th row
+
+void ScrollDetector::hashColumns(Frame &f, unsigned long long *h, int stride)
+{
+	int ps = f.pf->size;
+
+	for(int x = x0; x < x1; x++) h[x - x0] = HASH_BASIS;
+	for(int r = y0; r < y1; r += stride)
+	{
+		unsigned char *buf = &f.bits[f.pitch * r + x0 * ps];
+		if(ps == 4)
+		{
+			for(int x = x0; x < x1; x++, buf += 4)
+			{
+				unsigned int pixel;
+				memcpy(&pixel, buf, 4);
+				h[x - x0] = (h[x - x0] ^ pixel) * HASH_PRIME;
+			}
+		}
+		else
+		{
+			for(int x = x0; x < x1; x++, buf += ps)
+			{
+				unsigned int pixel = 0;
+				memcpy(&pixel, buf, ps);
+				h[x - x0] = (h[x - x0] ^ pixel) * HASH_PRIME;
+			}
+		}
+	}
+}
+
+
+int ScrollDetector::compareHashes(const void *arg1, const void *arg2)
+{
+	const HashEntry *e1 = (const HashEntry *)arg1, *e2 = (const HashEntry *)arg2;
+	return e1->hash < e2->hash ? -1 : (e1->hash > e2->hash ? 1 : 0);
+}
+
+
+// Sort the hashes of the previous frame, so that the rows (or columns) of the
+// previous frame that match a given row (or column) of the new frame can be
+// found with a binary search
+
+void ScrollDetector::sortHashes(int n)
+{
+	for(int i = 0; i < n; i++)
+	{
+		sorted[i].hash = lastHashes[i];  sorted[i].index = i;
+	}
+	qsort(sorted, n, sizeof(HashEntry), compareHashes);
+}
+
+
+// Returns the number of rows (or columns) of the previous frame whose hash is
+// equal to hash, and sets first to the index of the first one in sorted[]
+
+int ScrollDetector::findHash(unsigned long long hash, int n, int &first)
+{
+	int lo = 0, hi = n, count;
+
+	while(lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if(sorted[mid].hash < hash) lo = mid + 1;
+		else hi = mid;
+	}
+	for(count = 0; lo + count < n && sorted[lo + count].hash == hash; count++) {}
+	first = lo;
+	return count;
+}
+
+
+// Returns true if any of the rows (or columns) i of the new frame, where i is
+// a multiple of stride, matches a different row (or column) of the previous
+// frame
+
+bool ScrollDetector::anyMoved(int n, int stride)
+{
+	for(int i = 0; i < n; i += stride)
+	{
+		int first, count = findHash(hashes[i], n, first);
+		for(int j = first; j < first + count; j++)
+			if(sorted[j].index != i) return true;
+	}
+	return false;
+}
+
+
+// Each row (or column) i of the new frame that matches a row (or column) j of
+// the previous frame votes for an offset of i - j.  Returns the offset with the
+// most votes, or 0 if no offset received enough votes.  sortHashes() must be
+// called first.
+
+int ScrollDetector::vote(int n)
+{
+	int best = 0;
+
+	memset(votes, 0, sizeof(int) * (2 * n + 1));
+
+	for(int i = 0; i < n; i++)
+	{
+		int first, count = findHash(hashes[i], n, first);
+		if(count > SCROLL_MAXMATCHES) continue;
+		for(int j = first; j < first + count; j++)
+		{
+			int d = i - sorted[j].index;
+			if(d != 0) votes[d + n]++;
+		}
+	}
+	for(int d = -n + 1; d < n; d++)
+		if(votes[d + n] > votes[best + n]) best = d;
+	return votes[best + n] >= SCROLL_MINSIZE ? best : 0;
+}
+
+
+// Find the longest run of nonzero entries in equal[0] through equal[n - 1]
+
+static int longestRun(unsigned char *equal, int n, int &start)
+{
+	int best = 0;
+
+	for(int i = 0; i < n; )
+	{
+		if(!equal[i]) { i++;  continue; }
+		int j = i;
+		while(j < n && equal[j]) j++;
+		if(j - i > best) { best = j - i;  start = i; }
+		i = j;
+	}
+	return best;
+}
+
+
+bool ScrollDetector::detect(Frame &f, Frame &last, int &srcX, int &srcY,
+	int &dstX, int &dstY, int &width, int &height)
+{
+	bool bu = (f.flags & FRAME_BOTTOMUP);
+	int ps = f.pf->size, start = 0, run, d;
+
+	if(!f.isCompatible(&last) || ps > 4 || !findBounds(f, last)) return false;
+	int w = x1 - x0, h = y1 - y0;
+	if(w < SCROLL_MINSIZE || h < SCROLL_MINSIZE || w * h < SCROLL_MINAREA)
+		return false;
+	alloc(max(w, h));
+
+	// Vertical scrolling.  Content that changes everywhere (such as a rotating
+	// 3D model) is ruled out by hashing only every SCROLL_STRIDE-th row of the
+	// new frame.
+	hashRows(last, lastHashes, 1);  hashRows(f, hashes, SCROLL_STRIDE);
+	sortHashes(h);
+	if(anyMoved(h, SCROLL_STRIDE))
+	{
+		hashRows(f, hashes, 1);
+		d = vote(h);
+	}
+	else d = 0;
+	if(d != 0)
+	{
+		for(int i = 0; i < h; i++)
+			equal[i] = i - d >= 0 && i - d < h
+				&& !memcmp(&f.bits[f.pitch * (y0 + i) + x0 * ps],
+					&last.bits[last.pitch * (y0 + i - d) + x0 * ps], w * ps);
+		run = longestRun(equal, h, start);
+		if(run >= SCROLL_MINSIZE && run * w >= SCROLL_MINAREA)
+		{
+			int dstRow = y0 + start, srcRow = dstRow - d;
+			srcX = dstX = x0;  width = w;  height = run;
+			dstY = bu ? f.hdr.height - dstRow - run : dstRow;
+			srcY = bu ? f.hdr.height - srcRow - run : srcRow;
+			return true;
+		}
+	}
+
+	// Horizontal scrolling.  The columns are hashed using a subset of the rows,
+	// so the candidate offset is verified using all of the rows.
+	hashColumns(f, hashes, SCROLL_STRIDE);
+	hashColumns(last, lastHashes, SCROLL_STRIDE);
+	sortHashes(w);
+	if((d = vote(w)) != 0)
+	{
+		int lo = max(d, 0), hi = min(w, w + d);
+		for(int i = 0; i < w; i++) equal[i] = i >= lo && i < hi;
+		for(int r = y0; r < y1; r++)
+		{
+			unsigned char *row = &f.bits[f.pitch * r + x0 * ps],
+				*lastRow = &last.bits[last.pitch * r + x0 * ps];
+			// Compare blocks of SCROLL_MINSIZE pixels, and compare the pixels
+			// individually only if the block differs.
+			for(int i = lo; i < hi; i += SCROLL_MINSIZE)
+			{
+				int n = min(SCROLL_MINSIZE, hi - i);
+				if(!memcmp(&row[i * ps], &lastRow[(i - d) * ps], n * ps)) continue;
+				for(int j = i; j < i + n; j++)
+					if(equal[j] && memcmp(&row[j * ps], &lastRow[(j - d) * ps], ps))
+						equal[j] = 0;
+			}
+		}
+		run = longestRun(equal, w, start);
+		if(run >= SCROLL_MINSIZE && run * h >= SCROLL_MINAREA)
+		{
+			dstX = x0 + start;  srcX = dstX - d;  width = run;  height = h;
+			dstY = srcY = bu ? f.hdr.height - y1 : y0;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Multi-threaded YUV encoder
+
+YUVEncoder::YUVEncoder(int nThreads_) : nThreads(nThreads_), frame(NULL)
 {
-	unsigned char *rowptr, *logoptr = vgllogo, *logoptr2;
+	int i;
+
+	if(nThreads < 1) nThreads = 1;
+	if(nThreads > MAXPROCS) nThreads = MAXPROCS;
+	for(i = 0; i < MAXPROCS; i++) { workers[i] = NULL;  threads[i] = NULL; }
+	for(i = 0; i < 3; i++) { planes[i] = NULL;  strides[i] = 0; }
+	for(i = 0; i < nThreads; i++)
+		NEWCHECK(workers[i] = new Worker(i, this));
+	for(i = 1; i < nThreads; i++)
+	{
+		NEWCHECK(threads[i] = new Thread(workers[i]));
+		threads[i]->start();
+	}
+}
 
-	if(!bits || hdr.width < 1 || hdr.height < 1) return;
 
-	int height = min(VGLLOGO_HEIGHT, hdr.height - 1);
-	int width = min(VGLLOGO_WIDTH, hdr.width - 1);
-	int stride = flags & FRAME_BOTTOMUP ? -pitch : pitch;
-	if(height < 1 || width < 1) return;
-	if(flags & FRAME_BOTTOMUP)
-		rowptr = &bits[pitch * height + (hdr.width - width - 1) * pf->size];
-	else
-		rowptr = &bits[pitch * (hdr.height - height - 1) +
-			(hdr.width - width - 1) * pf->size];
-	DRAWLOGO()
+YUVEncoder::~YUVEncoder(void)
+{
+	int i;
 
-	if(!rbits) return;
-	logoptr = vgllogo;
-	if(flags & FRAME_BOTTOMUP)
-		rowptr = &rbits[pitch * height + (hdr.width - width - 1) * pf->size];
-	else
-		rowptr = &rbits[pitch * (hdr.height - height - 1) +
-			(hdr.width - width - 1) * pf->size];
-	logoptr = vgllogo;
-	DRAWLOGO()
+	for(i = 0; i < nThreads; i++) workers[i]->shutdown();
+	for(i = 1; i < nThreads; i++)
+	{
+		threads[i]->stop();  delete threads[i];  threads[i] = NULL;
+	}
+	for(i = 0; i < nThreads; i++) { delete workers[i];  workers[i] = NULL; }
 }
 
 
-void Frame::dumpHeader(rrframeheader &h)
+void YUVEncoder::encode(Frame &f, unsigned char *planes_[3], int strides_[3])
 {
-	vglout.print("hdr.size    = %lu\n", h.size);
-	vglout.print("hdr.winid   = 0x%.8x\n", h.winid);
-	vglout.print("hdr.dpynum  = %d\n", h.dpynum);
-	vglout.print("hdr.compress= %d\n", h.compress);
-	vglout.print("hdr.framew  = %d\n", h.framew);
-	vglout.print("hdr.frameh  = %d\n", h.frameh);
-	vglout.print("hdr.width   = %d\n", h.width);
-	vglout.print("hdr.height  = %d\n", h.height);
-	vglout.print("hdr.x       = %d\n", h.x);
-	vglout.print("hdr.y       = %d\n", h.y);
-	vglout.print("hdr.qual    = %d\n", h.qual);
-	vglout.print("hdr.subsamp = %d\n", h.subsamp);
-	vglout.print("hdr.flags   = %d\n", h.flags);
+	int i;
+
+	if(!f.bits || !planes_ || !strides_)
+		throw(Error("YUV encoder", "Invalid argument"));
+	if(f.pf->bpc != 8)
+		throw(Error("YUV encoder", "YUV encoding requires 8 bits per component"));
+
+	frame = &f;
+	for(i = 0; i < 3; i++) { planes[i] = planes_[i];  strides[i] = strides_[i]; }
+
+	for(i = 1; i < nThreads; i++) threads[i]->checkError();
+	for(i = 1; i < nThreads; i++) workers[i]->go();
+	try
+	{
+		workers[0]->encodeBand();
+	}
+	catch(...)
+	{
+		for(i = 1; i < nThreads; i++) workers[i]->stop();
+		throw;
+	}
+	for(i = 1; i < nThreads; i++)
+	{
+		workers[i]->stop();  threads[i]->checkError();
+	}
 }
 
 
-void Frame::checkHeader(rrframeheader &h)
+YUVEncoder::Worker::Worker(int myRank_, YUVEncoder *parent_) :
+	myRank(myRank_), parent(parent_), tjhnd(NULL), buf(NULL), bufSize(0),
+	deadYet(false)
 {
-	if(h.flags != RR_EOF && (h.framew < 1 || h.frameh < 1 || h.width < 1
-		|| h.height < 1 || h.x + h.width > h.framew || h.y + h.height > h.frameh))
+	ready.wait();  complete.wait();
+	if(!(tjhnd = tjInitCompress()))
+		throw(Error("YUV encoder", tjGetErrorStr()));
+}
+
+
+YUVEncoder::Worker::~Worker(void)
+{
+	if(tjhnd) tjDestroy(tjhnd);
+	free(buf);
+}
+
+
+void YUVEncoder::Worker::run(void)
+{
+	while(!deadYet)
 	{
-		throw(Error("Frame::checkHeader", "Invalid header"));
+		try
+		{
+			ready.wait();  if(deadYet) break;
+			encodeBand();
+			complete.signal();
+		}
+		catch(...)
+		{
+			complete.signal();  throw;
+		}
+	}
+}
+
+
+void YUVEncoder::Worker::encodeBand(void)
+{
+	Frame &f = *parent->frame;
+	int nBands = parent->nThreads, tjflags = 0, i, p;
+	// Bands must contain an even number of rows in order to avoid sharing a row
+	// of chroma samples with the next band.
+	int bandHeight = ((f.hdr.height + nBands - 1) / nBands + 1) & (~1);
+	int y = bandHeight * myRank, width = f.hdr.width;
+	int height = min(bandHeight, f.hdr.height - y);
+
+	if(height <= 0) return;
+
+	// TurboJPEG encodes the band into a contiguous buffer with 4-byte-aligned
+	// rows.  The planes in that buffer are then copied into the corresponding
+	// rows of the destination planes.
+	int cw = (width + 1) / 2, ch = (height + 1) / 2;
+	int ypitch = TJPAD(width), cpitch = TJPAD(cw);
+	unsigned long size = tjBufSizeYUV(width, height, TJ_420);
+
+	if(size > bufSize)
+	{
+		free(buf);  bufSize = 0;
+		if(!(buf = (unsigned char *)malloc(size)))
+			throw(Error("YUV encoder", "Memory allocation error"));
+		bufSize = size;
+	}
+
+	unsigned char *srcBuf = &f.bits[f.pitch * y];
+	if(f.flags & FRAME_BOTTOMUP)
+	{
+		tjflags |= TJ_BOTTOMUP;
+		srcBuf = &f.bits[f.pitch * (f.hdr.height - y - height)];
+	}
+	TRY_TJ(tjEncodeYUV2(tjhnd, srcBuf, width, f.pitch, height,
+		tjpf[f.pf->id], buf, TJ_420, tjflags));
+
+	unsigned char *src = buf, *dst = &parent->planes[0][parent->strides[0] * y];
+	for(i = 0; i < height; i++, src += ypitch, dst += parent->strides[0])
+		memcpy(dst, src, width);
+	src = &buf[ypitch * ch * 2];
+	for(p = 1; p < 3; p++)
+	{
+		dst = &parent->planes[p][parent->strides[p] * (y / 2)];
+		for(i = 0; i < ch; i++, src += cpitch, dst += parent->strides[p])
+			memcpy(dst, src, cw);
 	}
 }
 
 
 // Compressed frame
 
-CompressedFrame::CompressedFrame(void) : Frame(), tjhnd(NULL)
+CompressedFrame::CompressedFrame(void) : Frame(), tjhnd(NULL), bitsSize(0),
+	rbitsSize(0)
 {
 	if(!(tjhnd = tjInitCompress())) THROW(tjGetErrorStr());
 	pf = pf_get(PF_RGB);
@@ -426,13 +1578,15 @@ CompressedFrame &CompressedFrame::operator= (Frame &f)
 		case RRCOMP_RGB:  compressRGB(f);  break;
 		case RRCOMP_JPEG:  compressJPEG(f);  break;
 		case RRCOMP_YUV:  compressYUV(f);  break;
+		case RRCOMP_LOSSLESS:  compressLossless(f);  break;
+		case RRCOMP_SOLID:  compressSolid(f);  break;
 		default:  THROW("Invalid compression type");
 	}
 	return *this;
 }
 
 
-void CompressedFrame::compressYUV(Frame &f)
+void CompressedFrame::compressYUV(Frame &f, YUVEncoder *encoder)
 {
 	int tjflags = 0;
 
@@ -441,9 +1595,25 @@ void CompressedFrame::compressYUV(Frame &f)
 		throw(Error("YUV encoder", "YUV encoding requires 8 bits per component"));
 
 	init(f.hdr, 0);
-	if(f.flags & FRAME_BOTTOMUP) tjflags |= TJ_BOTTOMUP;
-	TRY_TJ(tjEncodeYUV2(tjhnd, f.bits, f.hdr.width, f.pitch, f.hdr.height,
-		tjpf[f.pf->id], bits, TJSUBSAMP(f.hdr.subsamp), tjflags));
+	if(encoder)
+	{
+		// Same plane layout as tjEncodeYUV2()
+		int ypitch = TJPAD(f.hdr.width), cpitch = TJPAD((f.hdr.width + 1) / 2);
+		int ch = (f.hdr.height + 1) / 2;
+		unsigned char *planes[3] =
+		{
+			bits, &bits[ypitch * ch * 2], &bits[ypitch * ch * 2 + cpitch * ch]
+		};
+		int strides[3] = { ypitch, cpitch, cpitch };
+
+		encoder->encode(f, planes, strides);
+	}
+	else
+	{
+		if(f.flags & FRAME_BOTTOMUP) tjflags |= TJ_BOTTOMUP;
+		TRY_TJ(tjEncodeYUV2(tjhnd, f.bits, f.hdr.width, f.pitch, f.hdr.height,
+			tjpf[f.pf->id], bits, TJSUBSAMP(f.hdr.subsamp), tjflags));
+	}
 	hdr.size = (unsigned int)tjBufSizeYUV(f.hdr.width, f.hdr.height,
 		TJSUBSAMP(f.hdr.subsamp));
 }
@@ -478,6 +1648,49 @@ void CompressedFrame::compressJPEG(Frame &f)
 }
 
 
+// See the description of RRCOMP_JPEGSLICES in rr.h.  The slice boundaries are
+// aligned to the largest JPEG MCU height, so each slice compresses almost as
+// efficiently as the same rows of the whole tile.
+
+void CompressedFrame::compressJPEGSlices(Frame &f, int nSlices)
+{
+	int tjflags = 0;
+
+	if(f.hdr.qual > 100 || f.hdr.subsamp > 16 || !IS_POW2(f.hdr.subsamp)
+		|| nSlices < 1 || nSlices > RR_MAXSLICES)
+		throw(Error("JPEG compressor", "Invalid argument"));
+	if(f.pf->bpc != 8)
+		throw(Error("JPEG compressor",
+			"JPEG compression requires 8 bits per component"));
+	if(f.stereo) throw(Error("JPEG compressor", "Stereo is not supported"));
+
+	rrframeheader h = f.hdr;
+	h.compress = RRCOMP_JPEGSLICES;
+	init(h, 0);
+	if(f.flags & FRAME_BOTTOMUP) tjflags |= TJ_BOTTOMUP;
+
+	int sliceHeight = ((f.hdr.height + nSlices - 1) / nSlices + 15) & (~15);
+	nSlices = (f.hdr.height + sliceHeight - 1) / sliceHeight;
+	unsigned char *dst = &bits[1 + 6 * nSlices];
+	bits[0] = nSlices;
+	for(int i = 0; i < nSlices; i++)
+	{
+		int y = sliceHeight * i, height = min(sliceHeight, f.hdr.height - y);
+		unsigned char *srcBuf = &f.bits[f.pitch * y], *entry = &bits[1 + 6 * i];
+		if(f.flags & FRAME_BOTTOMUP)
+			srcBuf = &f.bits[f.pitch * (f.hdr.height - y - height)];
+		unsigned long size;
+		TRY_TJ(tjCompress2(tjhnd, srcBuf, f.hdr.width, f.pitch, height,
+			tjpf[f.pf->id], &dst, &size, TJSUBSAMP(f.hdr.subsamp), f.hdr.qual,
+			tjflags | TJFLAG_NOREALLOC));
+		entry[0] = height & 0xFF;  entry[1] = (height >> 8) & 0xFF;
+		for(int b = 0; b < 4; b++) entry[2 + b] = (size >> (8 * b)) & 0xFF;
+		dst += size;
+	}
+	hdr.size = (unsigned int)(dst - bits);
+}
+
+
 void CompressedFrame::compressRGB(Frame &f)
 {
 	unsigned char *srcptr;
@@ -509,6 +1722,93 @@ void CompressedFrame::compressRGB(Frame &f)
 }
 
 
+// The caller is responsible for ensuring that all of the pixels in the frame
+// are the same color (see Frame::classify().)
+
+void CompressedFrame::compressSolid(Frame &f)
+{
+	if(f.pf->bpc != 8)
+		throw(Error("Solid encoder",
+			"Solid encoding requires 8 bits per component"));
+	if(f.stereo) throw(Error("Solid encoder", "Stereo is not supported"));
+
+	init(f.hdr, 0);
+	f.pf->convert(f.bits, 1, f.pitch, 1, bits, 3, pf_get(PF_RGB));
+	hdr.size = 3;
+}
+
+
+void CompressedFrame::compressLossless(Frame &f)
+{
+	if(f.pf->bpc != 8)
+		throw(Error("Lossless encoder",
+			"Lossless encoding requires 8 bits per component"));
+
+	init(f.hdr, f.stereo ? RR_LEFT : 0);
+	hdr.size = encodeLossless(f, f.bits, NULL, bits);
+	if(f.stereo && f.rbits)
+	{
+		init(f.hdr, RR_RIGHT);
+		if(rbits) rhdr.size = encodeLossless(f, f.rbits, NULL, rbits);
+	}
+}
+
+
+// Encode only the pixels in f that differ from the same pixels in last, which
+// must be the same tile in the previous frame (see the description of delta
+// tiles above.)
+
+void CompressedFrame::compressDelta(Frame &f, Frame &last)
+{
+	if(f.pf->bpc != 8)
+		throw(Error("Lossless encoder",
+			"Lossless encoding requires 8 bits per component"));
+	if(last.hdr.width != f.hdr.width || last.hdr.height != f.hdr.height
+		|| last.pf->id != f.pf->id || last.pitch != f.pitch
+		|| last.flags != f.flags || !last.bits)
+		throw(Error("Lossless encoder", "Previous tile does not match"));
+
+	init(f.hdr, f.stereo ? RR_LEFT : 0);
+	hdr.compress = RRCOMP_DELTA;
+	hdr.size = encodeLossless(f, f.bits, last.bits, bits);
+	if(f.stereo && f.rbits)
+	{
+		init(f.hdr, RR_RIGHT);
+		rhdr.compress = last.rbits ? RRCOMP_DELTA : RRCOMP_LOSSLESS;
+		if(rbits) rhdr.size = encodeLossless(f, f.rbits, last.rbits, rbits);
+	}
+}
+
+
+unsigned int CompressedFrame::encodeLossless(Frame &f, unsigned char *srcBuf,
+	unsigned char *lastBuf, unsigned char *dstBuf)
+{
+	bool bu = (f.flags & FRAME_BOTTOMUP);
+	int rowSize = f.hdr.width * 3;
+	unsigned char *rows = NULL, *dst = dstBuf, *last = NULL;
+	LLState state;
+
+	if((rows = (unsigned char *)malloc(rowSize * 3)) == NULL)
+		throw(Error("Lossless encoder", "Memory allocation error"));
+	if(lastBuf) last = &rows[rowSize * 2];
+	memset(&state, 0, sizeof(LLState));
+	for(int i = 0; i < f.hdr.height; i++)
+	{
+		unsigned char *row = &rows[rowSize * (i & 1)],
+			*above = i > 0 && !lastBuf ? &rows[rowSize * ((i - 1) & 1)] : NULL;
+		int srcLine = bu ? f.hdr.height - 1 - i : i;
+		f.pf->convert(&srcBuf[f.pitch * srcLine], f.hdr.width, f.pitch, 1, row,
+			rowSize, pf_get(PF_RGB));
+		if(lastBuf)
+			f.pf->convert(&lastBuf[f.pitch * srcLine], f.hdr.width, f.pitch, 1,
+				last, rowSize, pf_get(PF_RGB));
+		dst = llEncodeRow(row, above, last, f.hdr.width, dst, state);
+	}
+	free(rows);
+	return (unsigned int)(dst - dstBuf);
+}
+
+
 void CompressedFrame::init(rrframeheader &h, int buffer)
 {
 	checkHeader(h);
@@ -516,42 +1816,194 @@ void CompressedFrame::init(rrframeheader &h, int buffer)
 	switch(buffer)
 	{
 		case RR_LEFT:
-			if(h.width != hdr.width || h.height != hdr.height || !bits)
+			if(h.width != hdr.width || h.height != hdr.height || !bits
+				|| bufSize(h) > bitsSize)
 			{
-				delete [] bits;
-				NEWCHECK(bits = new unsigned char[tjBufSize(h.width, h.height,
-					h.subsamp)]);
+				delete [] bits;  bitsSize = 0;
+				NEWCHECK(bits = new unsigned char[bufSize(h)]);
+				bitsSize = bufSize(h);
 			}
 			hdr = h;  hdr.flags = RR_LEFT;  stereo = true;
 			break;
 		case RR_RIGHT:
-			if(h.width != rhdr.width || h.height != rhdr.height || !rbits)
+			if(h.width != rhdr.width || h.height != rhdr.height || !rbits
+				|| bufSize(h) > rbitsSize)
 			{
-				delete [] rbits;
-				NEWCHECK(rbits = new unsigned char[tjBufSize(h.width, h.height,
-					h.subsamp)]);
+				delete [] rbits;  rbitsSize = 0;
+				NEWCHECK(rbits = new unsigned char[bufSize(h)]);
+				rbitsSize = bufSize(h);
 			}
 			rhdr = h;  rhdr.flags = RR_RIGHT;  stereo = true;
 			break;
 		default:
-			if(h.width != hdr.width || h.height != hdr.height || !bits)
+			if(h.width != hdr.width || h.height != hdr.height || !bits
+				|| bufSize(h) > bitsSize)
 			{
-				delete [] bits;
-				NEWCHECK(bits = new unsigned char[tjBufSize(h.width, h.height,
-					h.subsamp)]);
+				delete [] bits;  bitsSize = 0;
+				NEWCHECK(bits = new unsigned char[bufSize(h)]);
+				bitsSize = bufSize(h);
 			}
 			hdr = h;  hdr.flags = 0;  stereo = false;
 			break;
 	}
 	if(!stereo && rbits)
 	{
-		delete [] rbits;  rbits = NULL;
+		delete [] rbits;  rbits = NULL;  rbitsSize = 0;
 		memset(&rhdr, 0, sizeof(rrframeheader));
 	}
 	pitch = hdr.width * pf->size;
 }
 
 
+unsigned long CompressedFrame::bufSize(rrframeheader &h)
+{
+	// Each slice of an RRCOMP_JPEGSLICES tile has its own JPEG headers and is
+	// padded to a whole number of MCUs, and TurboJPEG requires the worst-case
+	// buffer size for each slice.
+	if(h.compress == RRCOMP_JPEGSLICES)
+		return tjBufSize(h.width, h.height + 16 * RR_MAXSLICES,
+			TJSUBSAMP(h.subsamp)) + 2048 * RR_MAXSLICES + 1 + 6 * RR_MAXSLICES;
+	return max(tjBufSize(h.width, h.height, h.subsamp),
+		LL_BUFSIZE(h.width, h.height));
+}
+
+
+// Multi-threaded JPEG slice decoder
+
+SliceDecoder::SliceDecoder(int nThreads_) : nThreads(nThreads_), frame(NULL),
+	cframe(NULL), nSlices(0)
+{
+	int i;
+
+	if(nThreads < 1) nThreads = 1;
+	if(nThreads > MAXPROCS) nThreads = MAXPROCS;
+	for(i = 0; i < MAXPROCS; i++) { workers[i] = NULL;  threads[i] = NULL; }
+	for(i = 0; i < nThreads; i++)
+		NEWCHECK(workers[i] = new Worker(i, this));
+	for(i = 1; i < nThreads; i++)
+	{
+		NEWCHECK(threads[i] = new Thread(workers[i]));
+		threads[i]->start();
+	}
+}
+
+
+SliceDecoder::~SliceDecoder(void)
+{
+	int i;
+
+	for(i = 0; i < nThreads; i++) workers[i]->shutdown();
+	for(i = 1; i < nThreads; i++)
+	{
+		threads[i]->stop();  delete threads[i];  threads[i] = NULL;
+	}
+	for(i = 0; i < nThreads; i++) { delete workers[i];  workers[i] = NULL; }
+}
+
+
+// The caller is responsible for ensuring that the tile fits within f.
+
+void SliceDecoder::decode(Frame &f, CompressedFrame &cf)
+{
+	int i, y = 0;
+	unsigned long offset;
+
+	if(!f.bits || !cf.bits) throw(Error("Slice decoder", "Invalid argument"));
+	if(f.pf->bpc != 8)
+		throw(Error("JPEG decompressor",
+			"JPEG decompression requires 8 bits per component"));
+
+	nSlices = cf.bits[0];
+	offset = 1 + 6 * nSlices;
+	if(nSlices < 1 || nSlices > RR_MAXSLICES || cf.hdr.size < offset)
+		throw(Error("Slice decoder", "Invalid slice header"));
+	for(i = 0; i < nSlices; i++)
+	{
+		unsigned char *entry = &cf.bits[1 + 6 * i];
+		sliceY[i] = y;
+		sliceHeight[i] = entry[0] | (entry[1] << 8);
+		sliceSize[i] = (unsigned long)entry[2] | ((unsigned long)entry[3] << 8)
+			| ((unsigned long)entry[4] << 16) | ((unsigned long)entry[5] << 24);
+		sliceBits[i] = &cf.bits[offset];
+		y += sliceHeight[i];
+		if(sliceHeight[i] < 1 || sliceSize[i] < 1 || y > cf.hdr.height
+			|| sliceSize[i] > cf.hdr.size - offset)
+			throw(Error("Slice decoder", "Invalid slice header"));
+		offset += sliceSize[i];
+	}
+	if(y != cf.hdr.height) throw(Error("Slice decoder", "Invalid slice header"));
+
+	frame = &f;  cframe = &cf;
+	int nActive = min(nThreads, nSlices);
+	for(i = 1; i < nActive; i++) threads[i]->checkError();
+	for(i = 1; i < nActive; i++) workers[i]->go();
+	try
+	{
+		workers[0]->decodeSlices();
+	}
+	catch(...)
+	{
+		for(i = 1; i < nActive; i++) workers[i]->stop();
+		throw;
+	}
+	for(i = 1; i < nActive; i++)
+	{
+		workers[i]->stop();  threads[i]->checkError();
+	}
+}
+
+
+SliceDecoder::Worker::Worker(int myRank_, SliceDecoder *parent_) :
+	myRank(myRank_), parent(parent_), tjhnd(NULL), deadYet(false)
+{
+	ready.wait();  complete.wait();
+	if(!(tjhnd = tjInitDecompress()))
+		throw(Error("Slice decoder", tjGetErrorStr()));
+}
+
+
+SliceDecoder::Worker::~Worker(void)
+{
+	if(tjhnd) tjDestroy(tjhnd);
+}
+
+
+void SliceDecoder::Worker::run(void)
+{
+	while(!deadYet)
+	{
+		try
+		{
+			ready.wait();  if(deadYet) break;
+			decodeSlices();
+			complete.signal();
+		}
+		catch(...)
+		{
+			complete.signal();  throw;
+		}
+	}
+}
+
+
+void SliceDecoder::Worker::decodeSlices(void)
+{
+	Frame &f = *parent->frame;
+	CompressedFrame &cf = *parent->cframe;
+	int nActive = min(parent->nThreads, parent->nSlices), tjflags = 0;
+
+	if(f.flags & FRAME_BOTTOMUP) tjflags |= TJ_BOTTOMUP;
+	for(int i = myRank; i < parent->nSlices; i += nActive)
+	{
+		int height = parent->sliceHeight[i], y = cf.hdr.y + parent->sliceY[i];
+		if(f.flags & FRAME_BOTTOMUP) y = f.hdr.frameh - y - height;
+		TRY_TJ(tjDecompress2(tjhnd, parent->sliceBits[i], parent->sliceSize[i],
+			&f.bits[f.pitch * y + cf.hdr.x * f.pf->size], cf.hdr.width, f.pitch,
+			height, tjpf[f.pf->id], tjflags));
+	}
+}
+
+
 // Frame created from shared graphics memory
 
 FBXFrame::FBXFrame(Display *dpy, Drawable draw, Visual *vis,
@@ -573,7 +2025,7 @@ FBXFrame::FBXFrame(char *dpystring, Window win) : Frame()
 
 void FBXFrame::init(char *dpystring, Drawable draw, Visual *vis)
 {
-	tjhnd = NULL;  reuseConn = false;
+	tjhnd = NULL;  sliceDecoder = NULL;  reuseConn = false;
 	memset(&fb, 0, sizeof(fbx_struct));
 
 	if(!dpystring || !draw) throw(Error("FBXFrame::init", "Invalid argument"));
@@ -586,7 +2038,7 @@ void FBXFrame::init(char *dpystring, Drawable draw, Visual *vis)
 
 void FBXFrame::init(Display *dpy, Drawable draw, Visual *vis)
 {
-	tjhnd = NULL;  reuseConn = true;
+	tjhnd = NULL;  sliceDecoder = NULL;  reuseConn = true;
 	memset(&fb, 0, sizeof(fbx_struct));
 
 	if(!dpy || !draw) throw(Error("FBXFrame::init", "Invalid argument"));
@@ -601,6 +2053,7 @@ FBXFrame::~FBXFrame(void)
 	if(fb.bits) fbx_term(&fb);
 	if(bits) bits = NULL;
 	if(tjhnd) tjDestroy(tjhnd);
+	delete sliceDecoder;
 	if(wh.dpy && !reuseConn) XCloseDisplay(wh.dpy);
 }
 
@@ -618,6 +2071,9 @@ void FBXFrame::init(rrframeheader &h)
 		XSync(wh.dpy, False);
 		TRY_FBX(fbx_init(&fb, wh, h.framew, h.frameh, usexshm));
 	}
+	// The caller is about to modify the buffer, so make sure that the X server
+	// has finished reading it.
+	TRY_FBX(fbx_wait(&fb));
 	hdr = h;
 	if(hdr.framew > fb.width) hdr.framew = fb.width;
 	if(hdr.frameh > fb.height) hdr.frameh = fb.height;
@@ -635,6 +2091,16 @@ FBXFrame &FBXFrame::operator= (CompressedFrame &cf)
 		THROW("JPEG not initialized");
 	init(cf.hdr);
 	if(!fb.xi) THROW("Frame not initialized");
+	if(cf.hdr.compress == RRCOMP_COPYRECT)
+	{
+		copyRect(cf);
+		return *this;
+	}
+	if(cf.hdr.compress == RRCOMP_SOLID)
+	{
+		fill(cf);
+		return *this;
+	}
 
 	int width = min(cf.hdr.width, fb.width - cf.hdr.x);
 	int height = min(cf.hdr.height, fb.height - cf.hdr.y);
@@ -642,6 +2108,15 @@ FBXFrame &FBXFrame::operator= (CompressedFrame &cf)
 		&& cf.hdr.height <= height)
 	{
 		if(cf.hdr.compress == RRCOMP_RGB) decompressRGB(cf, width, height, false);
+		else if(cf.hdr.compress == RRCOMP_LOSSLESS
+			|| cf.hdr.compress == RRCOMP_DELTA)
+			decompressLossless(cf, width, height, false);
+		else if(cf.hdr.compress == RRCOMP_JPEGSLICES)
+		{
+			if(!sliceDecoder)
+				NEWCHECK(sliceDecoder = new SliceDecoder(min(NumProcs(), MAXPROCS)));
+			sliceDecoder->decode(*this, cf);
+		}
 		else
 		{
 			if(pf->bpc != 8)
@@ -661,10 +2136,95 @@ FBXFrame &FBXFrame::operator= (CompressedFrame &cf)
 }
 
 
-void FBXFrame::redraw(void)
+// If sync is false and MIT-SHM is being used, then this returns as soon as the
+// drawing request has been sent to the X server.  The next call to init() will
+// wait for the X server to finish reading the buffer.
+//
+// If lastf is non-NULL, then it must be the frame that was most recently drawn
+// into the same window.  In that case, the frame is divided into tiles of
+// approximately tileSize x tileSize pixels (using the same algorithm as the VGL
+// Transport), and only the tiles that differ from lastf are drawn.  Returns the
+// number of tiles that were skipped because they had not changed.
+
+int FBXFrame::redraw(bool sync, Frame *lastf, int tileSize)
+{
+	if(flags & FRAME_BOTTOMUP)
+	{
+		TRY_FBX(fbx_flip(&fb, 0, 0, 0, 0));
+		flags &= ~FRAME_BOTTOMUP;
+	}
+
+	// Shared memory pixmaps can only be written asynchronously when they are
+	// drawn using the X Present extension.
+	bool async = fb.shm && (!fb.pm || fb.present);
+
+	if(!lastf || !async || (lastf->flags & FRAME_BOTTOMUP))
+	{
+		if(!sync && async)
+		{
+			TRY_FBX(fbx_awrite(&fb, 0, 0, 0, 0, fb.width, fb.height));
+			XFlush(wh.dpy);
+		}
+		else TRY_FBX(fbx_write(&fb, 0, 0, 0, 0, fb.width, fb.height));
+		return 0;
+	}
+
+	int tileSizeX = tileSize > 0 ? tileSize : hdr.width;
+	int tileSizeY = tileSize > 0 ? tileSize : hdr.height;
+	bool drawn = false;  int skipped = 0;
+
+	for(int i = 0; i < hdr.height; i += tileSizeY)
+	{
+		int height = tileSizeY, y = i;
+		// Horizontally adjacent changed tiles are drawn with a single request.
+		int dirtyX = -1, dirtyWidth = 0;
+
+		if(hdr.height - i < (3 * tileSizeY / 2))
+		{
+			height = hdr.height - i;  i += tileSizeY;
+		}
+		for(int j = 0; j < hdr.width; j += tileSizeX)
+		{
+			int width = tileSizeX, x = j;
+
+			if(hdr.width - j < (3 * tileSizeX / 2))
+			{
+				width = hdr.width - j;  j += tileSizeX;
+			}
+			if(tileEquals(lastf, x, y, width, height))
+			{
+				skipped++;
+				if(dirtyX >= 0)
+				{
+					TRY_FBX(fbx_awrite(&fb, dirtyX, y, dirtyX, y, dirtyWidth, height));
+					dirtyX = -1;  drawn = true;
+				}
+				continue;
+			}
+			if(dirtyX < 0) { dirtyX = x;  dirtyWidth = 0; }
+			dirtyWidth += width;
+		}
+		if(dirtyX >= 0)
+		{
+			TRY_FBX(fbx_awrite(&fb, dirtyX, y, dirtyX, y, dirtyWidth, height));
+			drawn = true;
+		}
+	}
+
+	if(drawn && sync) TRY_FBX(fbx_sync(&fb));
+	if(drawn && !sync) XFlush(wh.dpy);
+	return skipped;
+}
+
+
+// Wait until the X server has finished processing all asynchronous puts of
+// this frame.  Requests sent over different display connections are not
+// ordered with respect to each other, so this must be called before drawing
+// another frame into the same drawable using a different connection.
+
+void FBXFrame::wait(void)
 {
-	if(flags & FRAME_BOTTOMUP) TRY_FBX(fbx_flip(&fb, 0, 0, 0, 0));
-	TRY_FBX(fbx_write(&fb, 0, 0, 0, 0, fb.width, fb.height));
+	TRY_FBX(fbx_wait(&fb));
 }
 
 
@@ -672,12 +2232,13 @@ void FBXFrame::redraw(void)
 
 // Frame created using X Video
 
-XVFrame::XVFrame(Display *dpy_, Window win_) : Frame()
+XVFrame::XVFrame(Display *dpy_, Window win_, YUVEncoder *encoder_) : Frame()
 {
 	if(!dpy_ || !win_) throw(Error("XVFrame::XVFrame", "Invalid argument"));
 
 	XFlush(dpy_);
 	init(DisplayString(dpy_), win_);
+	encoder = encoder_;
 }
 
 
@@ -689,7 +2250,7 @@ XVFrame::XVFrame(char *dpystring, Window win_) : Frame()
 
 void XVFrame::init(char *dpystring, Window win_)
 {
-	tjhnd = NULL;  isXV = true;
+	tjhnd = NULL;  isXV = true;  encoder = NULL;
 	memset(&fb, 0, sizeof(fbxv_struct));
 
 	if(!dpystring || !win_) throw(Error("XVFrame::init", "Invalid argument"));
@@ -717,6 +2278,20 @@ XVFrame &XVFrame::operator= (Frame &f)
 
 	int tjflags = 0;
 	init(f.hdr);
+	if(encoder)
+	{
+		unsigned char *planes[3];  int strides[3];
+
+		if(f.hdr.width > fb.xvi->width || f.hdr.height > fb.xvi->height)
+			THROW("Image size mismatch in YUV encoder");
+		for(int i = 0; i < 3; i++)
+		{
+			planes[i] = &bits[fb.xvi->offsets[i]];
+			strides[i] = fb.xvi->pitches[i];
+		}
+		encoder->encode(f, planes, strides);
+		return *this;
+	}
 	if(f.flags & FRAME_BOTTOMUP) tjflags |= TJ_BOTTOMUP;
 	if(!tjhnd)
 	{
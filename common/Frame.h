@@ -19,6 +19,7 @@
 #include "fbx.h"
 #include "turbojpeg.h"
 #include "Mutex.h"
+#include "Thread.h"
 #ifdef USEXV
 #include "fbxv.h"
 #endif
@@ -27,12 +28,26 @@
 
 // Flags
 #define FRAME_BOTTOMUP  1  // Bottom-up bitmap (as opposed to top-down)
+// The frame was sent at half size and should be scaled up by 2x when it is
+// drawn (set by the VGL Transport receiver on End-of-Frame markers)
+#define FRAME_HALFSIZE  2
+
+// Tile content classes (see Frame::classify())
+enum
+{
+	TILE_SOLID,  // A single color
+	TILE_FEWCOLORS,  // Few enough colors to be encoded losslessly (text, UI)
+	TILE_SHARP,  // Many colors and many sharp edges (text on an image)
+	TILE_SMOOTH  // Many colors and few sharp edges (rendered or photographic)
+};
 
 
 // Uncompressed frame
 
 namespace vglcommon
 {
+	class CompressedFrame;
+
 	class Frame
 	{
 		public:
@@ -46,6 +61,19 @@ namespace vglcommon
 			void deInit(void);
 			Frame *getTile(int x, int y, int width, int height);
 			bool tileEquals(Frame *last, int x, int y, int width, int height);
+			int tileChanges(Frame *last, int x, int y, int width, int height,
+				int limit);
+			bool isCompatible(Frame *last);
+			int percentChanged(Frame *last);
+			unsigned long long fingerprint(void);
+			void downsample(Frame &src);
+			void upsample(Frame &src);
+			void copyRect(int srcX, int srcY, int dstX, int dstY, int width,
+				int height);
+			void copyRect(CompressedFrame &f);
+			void fill(CompressedFrame &f);
+			int classify(void);
+			void selectEncoding(void);
 			void makeAnaglyph(Frame &r, Frame &g, Frame &b);
 			void makePassive(Frame &stf, int mode);
 			void signalReady(void) { ready.signal(); }
@@ -54,6 +82,8 @@ namespace vglcommon
 			void waitUntilComplete(void) { complete.wait(); }
 			bool isComplete(void) { return !complete.isLocked(); }
 			void decompressRGB(Frame &f, int width, int height, bool rightEye);
+			void decompressLossless(CompressedFrame &f, int width, int height,
+				bool rightEye);
 			void addLogo(void);
 
 			rrframeheader hdr;
@@ -62,6 +92,13 @@ namespace vglcommon
 			int pitch, flags;
 			PF *pf;
 			bool isGL, isXV, stereo;
+			// ID used to correlate the frame trace events (see FrameTrace.h) for
+			// this frame, and the time at which the frame was last queued
+			unsigned int traceID;  double traceTime;
+			// Position of the mouse pointer within the frame (top-down), or -1 if
+			// the pointer isn't in the window.  This is used to prioritize tiles
+			// (see Tiler.h.)
+			int pointerX, pointerY;
 
 		protected:
 
@@ -76,6 +113,103 @@ namespace vglcommon
 }
 
 
+// Scroll detection.  Compares a frame with the previous frame from the same
+// window and determines whether a large part of the region that has changed
+// is a vertically or horizontally translated copy of part of the previous
+// frame, as happens when a list is scrolled or a 2D view is panned.  Rows (or
+// columns) of the changed region are hashed, the offset between matching rows
+// (or columns) in the two frames is determined by majority vote, and the
+// largest contiguous band that moved by that offset is found and verified.
+// Only the pixels in the changed region are hashed, so a scrolled list that is
+// surrounded by static content is detected.
+
+namespace vglcommon
+{
+	class ScrollDetector
+	{
+		public:
+
+			ScrollDetector(void);
+			~ScrollDetector(void);
+			// Returns true and sets the source and destination rectangles (in
+			// top-down coordinates) if f contains a translated copy of part of last
+			bool detect(Frame &f, Frame &last, int &srcX, int &srcY, int &dstX,
+				int &dstY, int &width, int &height);
+
+		private:
+
+			typedef struct
+			{
+				unsigned long long hash;
+				int index;
+			} HashEntry;
+
+			void alloc(int n);
+			bool findBounds(Frame &f, Frame &last);
+			void hashRows(Frame &f, unsigned long long *hashes, int stride);
+			void hashColumns(Frame &f, unsigned long long *hashes, int stride);
+			void sortHashes(int n);
+			int findHash(unsigned long long hash, int n, int &first);
+			bool anyMoved(int n, int stride);
+			int vote(int n);
+			static int compareHashes(const void *arg1, const void *arg2);
+
+			int x0, y0, x1, y1;  // Bounding box of the changed region (storage rows)
+			int maxN;
+			unsigned long long *hashes, *lastHashes;
+			HashEntry *sorted;
+			int *votes;
+			unsigned char *equal;
+	};
+}
+
+
+// Multi-threaded 4:2:0 YUV encoder.  The frame is divided into bands of rows,
+// each of which is encoded by a separate thread and copied into the
+// destination planes.  Band boundaries are aligned to chroma rows, so the
+// threads never write to the same rows of any plane.
+
+namespace vglcommon
+{
+	class YUVEncoder
+	{
+		public:
+
+			YUVEncoder(int nThreads);
+			~YUVEncoder(void);
+			void encode(Frame &f, unsigned char *planes[3], int strides[3]);
+
+		private:
+
+			class Worker : public vglutil::Runnable
+			{
+				public:
+
+					Worker(int myRank_, YUVEncoder *parent_);
+					virtual ~Worker(void);
+					void run(void);
+					void go(void) { ready.signal(); }
+					void stop(void) { complete.wait(); }
+					void shutdown(void) { deadYet = true;  ready.signal(); }
+					void encodeBand(void);
+
+				private:
+
+					int myRank;  YUVEncoder *parent;
+					tjhandle tjhnd;
+					unsigned char *buf;  unsigned long bufSize;
+					vglutil::Event ready, complete;  bool deadYet;
+			};
+
+			int nThreads;
+			Worker *workers[MAXPROCS];
+			vglutil::Thread *threads[MAXPROCS];
+			Frame *frame;
+			unsigned char *planes[3];  int strides[3];
+	};
+}
+
+
 // Compressed frame
 
 namespace vglcommon
@@ -87,21 +221,78 @@ namespace vglcommon
 			CompressedFrame(void);
 			~CompressedFrame(void);
 			CompressedFrame &operator= (Frame &f);
-			void compressYUV(Frame &f);
+			void compressYUV(Frame &f, YUVEncoder *encoder = NULL);
 			void compressJPEG(Frame &f);
+			void compressJPEGSlices(Frame &f, int nSlices);
 			void compressRGB(Frame &f);
+			void compressLossless(Frame &f);
+			void compressSolid(Frame &f);
+			void compressDelta(Frame &f, Frame &last);
 			void init(rrframeheader &h, int buffer);
 
 			rrframeheader rhdr;
 
 		private:
 
+			unsigned long bufSize(rrframeheader &h);
+			unsigned int encodeLossless(Frame &f, unsigned char *srcBuf,
+				unsigned char *lastBuf, unsigned char *dstBuf);
+
 			tjhandle tjhnd;
+			// Allocated sizes of bits and rbits
+			unsigned long bitsSize, rbitsSize;
 			friend class FBXFrame;
 	};
 }
 
 
+// Multi-threaded decoder for RRCOMP_JPEGSLICES tiles.  The slices of a tile
+// are independent JPEG images that occupy separate rows of the destination
+// frame, so each thread decompresses its share of the slices directly into the
+// frame.
+
+namespace vglcommon
+{
+	class SliceDecoder
+	{
+		public:
+
+			SliceDecoder(int nThreads);
+			~SliceDecoder(void);
+			void decode(Frame &f, CompressedFrame &cf);
+
+		private:
+
+			class Worker : public vglutil::Runnable
+			{
+				public:
+
+					Worker(int myRank_, SliceDecoder *parent_);
+					virtual ~Worker(void);
+					void run(void);
+					void go(void) { ready.signal(); }
+					void stop(void) { complete.wait(); }
+					void shutdown(void) { deadYet = true;  ready.signal(); }
+					void decodeSlices(void);
+
+				private:
+
+					int myRank;  SliceDecoder *parent;
+					tjhandle tjhnd;
+					vglutil::Event ready, complete;  bool deadYet;
+			};
+
+			int nThreads;
+			Worker *workers[MAXPROCS];
+			vglutil::Thread *threads[MAXPROCS];
+			Frame *frame;  CompressedFrame *cframe;
+			int nSlices, sliceY[RR_MAXSLICES], sliceHeight[RR_MAXSLICES];
+			unsigned char *sliceBits[RR_MAXSLICES];
+			unsigned long sliceSize[RR_MAXSLICES];
+	};
+}
+
+
 // Frame created from shared graphics memory
 
 namespace vglcommon
@@ -118,13 +309,15 @@ namespace vglcommon
 			~FBXFrame(void);
 			void init(rrframeheader &h);
 			FBXFrame &operator= (CompressedFrame &cf);
-			void redraw(void);
+			int redraw(bool sync = true, Frame *lastf = NULL, int tileSize = 0);
+			void wait(void);
 
 		private:
 
 			fbx_wh wh;
 			fbx_struct fb;
 			tjhandle tjhnd;
+			SliceDecoder *sliceDecoder;
 			bool reuseConn;
 	};
 }
@@ -140,7 +333,7 @@ namespace vglcommon
 	{
 		public:
 
-			XVFrame(Display *dpy, Window win);
+			XVFrame(Display *dpy, Window win, YUVEncoder *encoder = NULL);
 			XVFrame(char *dpystring, Window win);
 			void init(char *dpystring, Window win);
 			~XVFrame(void);
@@ -153,6 +346,7 @@ namespace vglcommon
 			fbxv_struct fb;
 			Display *dpy;  Window win;
 			tjhandle tjhnd;
+			YUVEncoder *encoder;
 	};
 }
 
@@ -0,0 +1,228 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "FrameTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#define getpid  _getpid
+#ifdef _MSC_VER
+#define strdup  _strdup
+#endif
+#else
+#include <unistd.h>
+#include <signal.h>
+#endif
+#include "Thread.h"
+#include "Log.h"
+
+using namespace vglutil;
+using namespace vglcommon;
+
+
+FrameTracer *FrameTracer::instance = NULL;
+CriticalSection FrameTracer::instanceMutex;
+
+// Atomic increment operations, which return the incremented value.  A mutex is
+// used only with compilers that provide neither GCC atomic builtins nor the
+// Win32 interlocked functions.
+
+#if !defined(__GNUC__) && !defined(_WIN32)
+static CriticalSection atomicMutex;
+#endif
+
+static unsigned long long atomicIncrement(volatile unsigned long long *value)
+{
+	#if defined(__GNUC__)
+	return __sync_add_and_fetch(value, 1ULL);
+	#elif defined(_WIN32)
+	return (unsigned long long)InterlockedIncrement64((volatile LONGLONG *)value);
+	#else
+	CriticalSection::SafeLock l(atomicMutex);
+	return ++(*value);
+	#endif
+}
+
+static unsigned int atomicIncrement(volatile unsigned int *value)
+{
+	#if defined(__GNUC__)
+	return __sync_add_and_fetch(value, 1U);
+	#elif defined(_WIN32)
+	return (unsigned int)InterlockedIncrement((volatile LONG *)value);
+	#else
+	CriticalSection::SafeLock l(atomicMutex);
+	return ++(*value);
+	#endif
+}
+
+static void memoryBarrier(void)
+{
+	#if defined(__GNUC__)
+	__sync_synchronize();
+	#elif defined(_WIN32)
+	MemoryBarrier();
+	#endif
+}
+
+
+#ifndef _WIN32
+static volatile sig_atomic_t dumpRequested = 0;
+
+static void handleSIGUSR2(int sig)
+{
+	dumpRequested = 1;
+}
+#endif
+
+
+FrameTracer *FrameTracer::getInstance(void)
+{
+	if(instance == NULL)
+	{
+		CriticalSection::SafeLock l(instanceMutex);
+		if(instance == NULL) instance = new FrameTracer;
+	}
+	return instance;
+}
+
+
+FrameTracer::FrameTracer(void) : enabled(false), fileName(NULL), events(NULL),
+	nEvents(0), lastFrameID(0)
+{
+	char *env = getenv("VGL_FRAMETRACE");
+
+	if(!env || strlen(env) < 1) return;
+	if((events = (Event *)calloc(MAXEVENTS, sizeof(Event))) == NULL
+		|| (fileName = strdup(env)) == NULL)
+	{
+		free(events);  events = NULL;
+		return;
+	}
+	enabled = true;
+	atexit(dumpAtExit);
+
+	#ifndef _WIN32
+	// Don't override a handler that the application installed.
+	struct sigaction sa;
+	if(sigaction(SIGUSR2, NULL, &sa) == 0 && sa.sa_handler == SIG_DFL)
+	{
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = handleSIGUSR2;
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = SA_RESTART;
+		sigaction(SIGUSR2, &sa, NULL);
+	}
+	#endif
+}
+
+
+void FrameTracer::dumpAtExit(void)
+{
+	if(instance) instance->dump();
+}
+
+
+unsigned int FrameTracer::newFrameID(void)
+{
+	if(!enabled) return 0;
+	return atomicIncrement(&lastFrameID);
+}
+
+
+double FrameTracer::record(const char *stage, unsigned int frameID,
+	double start, double end)
+{
+	if(!enabled) return end;
+	if(end == 0.0) end = timer.time();
+	if(start == 0.0) start = end;
+
+	// The sequence number is written last, so dump() can detect a slot that is
+	// being overwritten.
+	unsigned long long seq = atomicIncrement(&nEvents);
+	Event &e = events[(seq - 1) % MAXEVENTS];
+	e.seq = 0;
+	memoryBarrier();
+	e.stage = stage;  e.frameID = frameID;
+	e.threadID = Thread::threadID();
+	e.start = start;  e.end = end;
+	memoryBarrier();
+	e.seq = seq;
+
+	#ifndef _WIN32
+	if(dumpRequested)
+	{
+		dumpRequested = 0;
+		dump();
+	}
+	#endif
+	return end;
+}
+
+
+void FrameTracer::dump(void)
+{
+	FILE *file = NULL;
+
+	if(!enabled) return;
+	CriticalSection::SafeLock l(dumpMutex);
+
+	// Processes that never drew anything (such as shell scripts that launch
+	// the 3D application) shouldn't clobber the trace.
+	unsigned long long last = nEvents;
+	if(last < 1) return;
+	if((file = fopen(fileName, "w")) == NULL)
+	{
+		vglout.println("[VGL] WARNING: Could not open frame trace file %s",
+			fileName);
+		return;
+	}
+
+	unsigned long long first = last > (unsigned long long)MAXEVENTS ?
+		last - MAXEVENTS : 0;
+	int pid = (int)getpid();  bool written = false;
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	for(unsigned long long i = first; i < last; i++)
+	{
+		// Skip events that are still being written or that have been overwritten
+		// by newer events since the dump started.
+		Event &slot = events[i % MAXEVENTS];
+		if(slot.seq != i + 1) continue;
+		memoryBarrier();
+		Event e = slot;
+		memoryBarrier();
+		if(slot.seq != i + 1) continue;
+		fprintf(file,
+			"%s{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%lu,\"args\":{\"frame\":%u}}",
+			written ? ",\n" : "", e.stage, e.start * 1000000.,
+			(e.end - e.start) * 1000000., pid, e.threadID, e.frameID);
+		written = true;
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(file);
+}
+
+
+FrameTraceSpan::FrameTraceSpan(const char *stage_, unsigned int frameID_) :
+	stage(stage_), frameID(frameID_)
+{
+	start = frametrace.time();
+}
+
+
+FrameTraceSpan::~FrameTraceSpan(void)
+{
+	frametrace.record(stage, frameID, start);
+}
@@ -0,0 +1,96 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __FRAMETRACE_H__
+#define __FRAMETRACE_H__
+
+#include "Mutex.h"
+#include "Timer.h"
+
+
+// Per-frame latency tracing.  If the VGL_FRAMETRACE environment variable is
+// set to a file name, then each stage of the image pipeline records the time
+// at which it started and finished processing each frame.  The most recent
+// events are kept in a ring buffer, which is written to the file in Chrome
+// trace event format when the process exits or (on Un*x) when it receives
+// SIGUSR2.  Each event claims a slot in the ring buffer by atomically
+// incrementing the event count, so recording an event never blocks.
+//
+// Frame IDs are unique within a process.  If the VirtualGL Faker is tracing
+// and the VirtualGL Client supports protocol v2.2, then the VGL Transport
+// sends each frame's ID to the client (see RRCOMP_FRAMEID in rr.h), so the
+// server's and the client's events for the same frame have the same ID.
+// Otherwise, the client assigns its own IDs.
+
+namespace vglcommon
+{
+	class FrameTracer
+	{
+		public:
+
+			static FrameTracer *getInstance(void);
+			bool isEnabled(void) { return enabled; }
+			unsigned int newFrameID(void);
+			// Returns 0.0 if tracing is disabled, so the timer isn't read needlessly
+			double time(void) { return enabled ? timer.time() : 0.0; }
+			// Records an event that started at the given time and ended now (or at
+			// the given end time), and returns the end time
+			double record(const char *stage, unsigned int frameID, double start,
+				double end = 0.0);
+			void dump(void);
+
+		private:
+
+			FrameTracer(void);
+			~FrameTracer(void) {}
+			static void dumpAtExit(void);
+
+			typedef struct
+			{
+				const char *stage;  unsigned int frameID;  unsigned long threadID;
+				double start, end;
+				// 1 + the index of the event that was last written into this slot
+				volatile unsigned long long seq;
+			} Event;
+
+			static const int MAXEVENTS = 65536;
+			static FrameTracer *instance;
+			static vglutil::CriticalSection instanceMutex;
+			vglutil::CriticalSection dumpMutex;
+			vglutil::Timer timer;
+			bool enabled;
+			char *fileName;
+			Event *events;
+			volatile unsigned long long nEvents;
+			volatile unsigned int lastFrameID;
+	};
+
+
+	// Records an event that spans the lifetime of the object
+
+	class FrameTraceSpan
+	{
+		public:
+
+			FrameTraceSpan(const char *stage_, unsigned int frameID_);
+			~FrameTraceSpan(void);
+
+		private:
+
+			const char *stage;  unsigned int frameID;  double start;
+	};
+}
+
+
+#define frametrace  (*(vglcommon::FrameTracer::getInstance()))
+
+#endif  // __FRAMETRACE_H__
@@ -15,19 +15,179 @@
 #include "Profiler.h"
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #ifdef _MSC_VER
 #define snprintf  _snprintf
 #define strdup  _strdup
 #endif
 #include "Timer.h"
 #include "Log.h"
+#include "Socket.h"
+#include "Thread.h"
+#include "GenericQ.h"
 
+using namespace vglutil;
 using namespace vglcommon;
 
 
+// Profiling output is shared by all profilers in the process.  The format is
+// selected by setting VGL_PROFILE to 1 (human-readable text), csv, or json
+// (one JSON object per line), and VGL_PROFILEOUT can optionally be set to the
+// name of a file or to tcp:{host}:{port} in order to redirect the output.
+
+enum { PROFILE_TEXT = 0, PROFILE_CSV, PROFILE_JSON };
+
+static CriticalSection outputMutex;
+static bool outputInit = false;
+static int outputFormat = PROFILE_TEXT;
+static FILE *outputFile = NULL;
+
+
+// Profiling output is sent over TCP by a separate thread, so a slow consumer
+// cannot stall the threads that are being profiled.  If the consumer falls
+// too far behind, then new lines are discarded.
+
+#define MAX_PENDING_LINES  256
+
+class OutputSender : public Runnable
+{
+	public:
+
+		OutputSender(Socket *socket_) : socket(socket_), thread(NULL)
+		{
+			NEWCHECK(thread = new Thread(this));
+			thread->start();
+		}
+
+		void send(const char *line)
+		{
+			char *copy;
+			if(q.items() >= MAX_PENDING_LINES || !(copy = strdup(line))) return;
+			q.add(copy);
+		}
+
+	private:
+
+		void run(void)
+		{
+			while(true)
+			{
+				void *line = NULL;
+				q.get(&line);
+				if(!line) return;
+				if(socket)
+				{
+					try
+					{
+						socket->send((char *)line, (int)strlen((char *)line));
+					}
+					catch(Error &e)
+					{
+						vglout.println(
+							"[VGL] WARNING: Could not send profiling output (%s)",
+							e.getMessage());
+						delete socket;  socket = NULL;
+					}
+				}
+				free(line);
+			}
+		}
+
+		Socket *socket;
+		Thread *thread;
+		GenericQ q;
+};
+
+static OutputSender *outputSender = NULL;
+
+
+static int getProfileFormat(void)
+{
+	char *env = getenv("VGL_PROFILE");
+
+	if(env && !strcmp(env, "csv")) return PROFILE_CSV;
+	if(env && !strcmp(env, "json")) return PROFILE_JSON;
+	return PROFILE_TEXT;
+}
+
+
+static void writeOutput(const char *line)
+{
+	if(outputSender) outputSender->send(line);
+	else if(outputFile)
+	{
+		fputs(line, outputFile);  fflush(outputFile);
+	}
+	else vglout.PRINT("%s", line);
+}
+
+
+static void initOutput(void)
+{
+	char *env = getenv("VGL_PROFILEOUT");
+
+	outputInit = true;
+	outputFormat = getProfileFormat();
+	if(env && !strncmp(env, "tcp:", 4))
+	{
+		char host[256], *ptr;
+		strncpy(host, &env[4], 255);  host[255] = 0;
+		if((ptr = strrchr(host, ':')) == NULL || atoi(&ptr[1]) <= 0
+			|| atoi(&ptr[1]) > 65535)
+			vglout.println("[VGL] WARNING: Invalid profiling output address %s",
+				env);
+		else
+		{
+			Socket *socket = NULL;
+			*ptr = 0;
+			try
+			{
+				socket = new Socket(false, false);
+				socket->connect(host, (unsigned short)atoi(&ptr[1]));
+				outputSender = new OutputSender(socket);
+			}
+			catch(Error &e)
+			{
+				vglout.println("[VGL] WARNING: Could not connect to %s (%s)", env,
+					e.getMessage());
+				if(!outputSender) delete socket;
+			}
+		}
+	}
+	else if(env && strlen(env) > 0)
+	{
+		if((outputFile = fopen(env, "w")) == NULL)
+			vglout.println("[VGL] WARNING: Could not open profiling output file %s",
+				env);
+	}
+	if(outputFormat == PROFILE_CSV)
+		writeOutput("time,name,mpixels_per_sec,fps,mbits_per_sec,ratio,samples,p50_ms,p95_ms,p99_ms,max_ms,spoiled,skipped\n");
+}
+
+
+static int bucket(double t)
+{
+	double usec = t * 1000000.;
+	int octave;
+
+	if(usec < 1.) return 0;
+	double m = frexp(usec, &octave);  // usec = m * 2^octave, 0.5 <= m < 1.0
+	int index = 1 + (octave - 1) * 8 + (int)((m * 2. - 1.) * 8.);
+	return index;
+}
+
+
+static double bucketValue(int index)
+{
+	if(index == 0) return 0.0000005;
+	return ldexp(1. + ((double)((index - 1) % 8) + 0.5) / 8.,
+		(index - 1) / 8) * 0.000001;
+}
+
+
 Profiler::Profiler(const char *name_, double interval_) : interval(interval_),
 	mbytes(0.0), mpixels(0.0), totalTime(0.0), start(0.0), frames(0),
-	lastFrame(0.0)
+	lastFrame(0.0), samples(0), spoiled(0), skipped(0), maxTime(0.0)
 {
 	profile = false;  char *ev = NULL;
 	setName(name_);  freestr = false;
@@ -35,6 +195,8 @@ Profiler::Profiler(const char *name_, double interval_) : interval(interval_),
 		profile = true;
 	if((ev = getenv("VGL_PROFILE")) != NULL && !strncmp(ev, "1", 1))
 		profile = true;
+	if(getProfileFormat() != PROFILE_TEXT) profile = true;
+	memset(hist, 0, sizeof(hist));
 }
 
 
@@ -72,34 +234,115 @@ void Profiler::endFrame(long pixels, long bytes, double incFrames)
 	double now = timer.time();
 	if(start != 0.0)
 	{
-		totalTime += now - start;
+		double t = now - start;
+		totalTime += t;
 		if(pixels) mpixels += (double)pixels / 1000000.;
 		if(bytes) mbytes += (double)bytes / 1000000.;
 		if(incFrames != 0.0) frames += incFrames;
+		int index = bucket(t);
+		if(index >= NBUCKETS) index = NBUCKETS - 1;
+		hist[index]++;  samples++;
+		if(t > maxTime) maxTime = t;
 	}
 	if(lastFrame == 0.0) lastFrame = now;
 	if(totalTime > interval || (now - lastFrame) > interval)
 	{
-		char temps[256];  size_t i = 0;
-		snprintf(&temps[i], 255 - i, "%s  ", name);  i = strlen(temps);
+		report(now);
+		totalTime = 0.;  mpixels = 0.;  frames = 0.;  mbytes = 0.;
+		memset(hist, 0, sizeof(hist));  samples = 0;  maxTime = 0.;
+		skipped = 0;
+		lastFrame = now;
+	}
+}
+
+
+void Profiler::incSpoiled(long n)
+{
+	if(!profile || n < 1) return;
+	CriticalSection::SafeLock l(spoiledMutex);
+	spoiled += n;
+}
+
+
+void Profiler::report(double now)
+{
+	char temps[1024];  size_t i = 0;
+	CriticalSection::SafeLock l(outputMutex);
+
+	if(!outputInit) initOutput();
+
+	double pct[3] = { 0., 0., 0. }, fractions[3] = { 0.50, 0.95, 0.99 };
+	long count = 0, spoiledFrames;
+	int b = 0;
+	for(int p = 0; p < 3 && samples > 0; p++)
+	{
+		long target = (long)ceil(fractions[p] * (double)samples);
+		while(b < NBUCKETS && count + (long)hist[b] < target) count += hist[b++];
+		// The max is exact, and the bucket value is not, so the former is a more
+		// accurate percentile when the latter exceeds it.
+		pct[p] = b < NBUCKETS ? bucketValue(b) : maxTime;
+		if(pct[p] > maxTime) pct[p] = maxTime;
+	}
+	{
+		CriticalSection::SafeLock l(spoiledMutex);
+		spoiledFrames = spoiled;  spoiled = 0;
+	}
+
+	if(outputFormat == PROFILE_TEXT)
+	{
+		snprintf(&temps[i], 1023 - i, "%s  ", name);  i = strlen(temps);
 		if(mpixels)
 		{
-			snprintf(&temps[i], 255 - i, "- %7.2f Mpixels/sec", mpixels / totalTime);
+			snprintf(&temps[i], 1023 - i, "- %7.2f Mpixels/sec",
+				mpixels / totalTime);
 			i = strlen(temps);
 		}
 		if(frames)
 		{
-			snprintf(&temps[i], 255 - i, "- %7.2f fps", frames / totalTime);
+			snprintf(&temps[i], 1023 - i, "- %7.2f fps", frames / totalTime);
 			i = strlen(temps);
 		}
 		if(mbytes)
 		{
-			snprintf(&temps[i], 255 - i, "- %7.2f Mbits/sec (%.1f:1)",
+			snprintf(&temps[i], 1023 - i, "- %7.2f Mbits/sec (%.1f:1)",
 				mbytes * 8.0 / totalTime, mpixels * 3. / mbytes);
 			i = strlen(temps);
 		}
-		vglout.PRINT("%s\n", temps);
-		totalTime = 0.;  mpixels = 0.;  frames = 0.;  mbytes = 0.;
-		lastFrame = now;
+		if(samples)
+		{
+			snprintf(&temps[i], 1023 - i,
+				"- p50/p95/p99/max %.2f/%.2f/%.2f/%.2f ms", pct[0] * 1000.,
+				pct[1] * 1000., pct[2] * 1000., maxTime * 1000.);
+			i = strlen(temps);
+		}
+		if(spoiledFrames)
+		{
+			snprintf(&temps[i], 1023 - i, "- %ld spoiled", spoiledFrames);
+			i = strlen(temps);
+		}
+		if(skipped)
+		{
+			snprintf(&temps[i], 1023 - i, "- %ld skipped", skipped);
+			i = strlen(temps);
+		}
+		snprintf(&temps[i], 1023 - i, "\n");
+		writeOutput(temps);
+		return;
 	}
+
+	// Strip the padding from the name
+	char trimmedName[256];
+	strncpy(trimmedName, name, 255);  trimmedName[255] = 0;
+	for(int j = (int)strlen(trimmedName) - 1; j >= 0 && trimmedName[j] == ' ';
+		j--)
+		trimmedName[j] = 0;
+
+	double t = totalTime > 0. ? totalTime : 1.;
+	snprintf(temps, 1023, outputFormat == PROFILE_CSV ?
+		"%.6f,%s,%.3f,%.3f,%.3f,%.3f,%ld,%.3f,%.3f,%.3f,%.3f,%ld,%ld\n" :
+		"{\"time\":%.6f,\"name\":\"%s\",\"mpixels_per_sec\":%.3f,\"fps\":%.3f,\"mbits_per_sec\":%.3f,\"ratio\":%.3f,\"samples\":%ld,\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,\"spoiled\":%ld,\"skipped\":%ld}\n",
+		now, trimmedName, mpixels / t, frames / t, mbytes * 8.0 / t,
+		mbytes > 0. ? mpixels * 3. / mbytes : 0., samples, pct[0] * 1000.,
+		pct[1] * 1000., pct[2] * 1000., maxTime * 1000., spoiledFrames, skipped);
+	writeOutput(temps);
 }
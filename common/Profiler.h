@@ -16,10 +16,17 @@
 #define __PROFILER_H__
 
 #include "Timer.h"
+#include "Mutex.h"
 
 
 namespace vglcommon
 {
+	// In addition to the average throughput, each profiler keeps a histogram of
+	// the time taken by each startFrame()/endFrame() interval, from which it
+	// reports the 50th, 95th, and 99th percentiles and the maximum.  The
+	// histogram is only modified by the thread that calls endFrame(), so no
+	// locking is necessary.
+
 	class Profiler
 	{
 		public:
@@ -30,15 +37,29 @@ namespace vglcommon
 			void setName(const char *name);
 			void startFrame(void);
 			void endFrame(long pixels, long bytes, double incFrames);
+			// Count frames that were discarded before they were transported.  This
+			// can be called from any thread.
+			void incSpoiled(long n = 1);
+			// Count tiles that were not transported because they had not changed
+			void incSkipped(long n = 1) { if(profile) skipped += n; }
 
 		private:
 
+			void report(double now);
+
+			// 8 buckets per octave, from 1 microsecond to 2^28 microseconds
+			static const int NBUCKETS = 1 + 28 * 8;
+
 			char *name;
 			double interval;
 			double mbytes, mpixels, totalTime, start, frames, lastFrame;
 			bool profile;
 			vglutil::Timer timer;
 			bool freestr;
+			unsigned int hist[NBUCKETS];
+			long samples, spoiled, skipped;
+			double maxTime;
+			vglutil::CriticalSection spoiledMutex;
 	};
 }
 
@@ -0,0 +1,332 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "TileCache.h"
+#include <stdlib.h>
+#include <string.h>
+#include "Error.h"
+#include "vglutil.h"
+
+using namespace vglutil;
+using namespace vglcommon;
+
+
+// The digest is a 128-bit MurmurHash3 of the tile's pixels, seeded with the
+// tile's dimensions, pixel format, and encoding parameters.  Two tiles with the
+// same digest therefore decode to the same pixels on the client.
+
+#define ROTL64(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+static const unsigned long long C1 = 0x87c37b91114253d5ULL,
+	C2 = 0x4cf5ad432745937fULL;
+
+static inline void mixBlock(unsigned long long &h1, unsigned long long &h2,
+	unsigned long long k1, unsigned long long k2)
+{
+	k1 *= C1;  k1 = ROTL64(k1, 31);  k1 *= C2;  h1 ^= k1;
+	h1 = ROTL64(h1, 27);  h1 += h2;  h1 = h1 * 5 + 0x52dce729;
+	k2 *= C2;  k2 = ROTL64(k2, 33);  k2 *= C1;  h2 ^= k2;
+	h2 = ROTL64(h2, 31);  h2 += h1;  h2 = h2 * 5 + 0x38495ab5;
+}
+
+static inline unsigned long long fmix64(unsigned long long k)
+{
+	k ^= k >> 33;  k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;  k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+
+TileCache::TileCache(void) : slots(NULL), nSlots(0), maxSlots(0), lruHead(-1),
+	lruTail(-1), freeHead(-1), freeTail(-1), budget(0), used(0), frame(1)
+{
+	for(int i = 0; i < NBUCKETS; i++) buckets[i] = -1;
+}
+
+
+TileCache::~TileCache(void)
+{
+	free(slots);
+}
+
+
+void TileCache::setBudget(size_t bytes)
+{
+	CriticalSection::SafeLock l(mutex);
+	budget = bytes;
+}
+
+
+void TileCache::newFrame(void)
+{
+	CriticalSection::SafeLock l(mutex);
+	frame++;
+}
+
+
+void TileCache::digest(Frame &tile, Digest &d)
+{
+	unsigned long long h1 = 0, h2 = 0, k[2];
+	int rowSize = tile.hdr.width * tile.pf->size, len = 0;
+
+	mixBlock(h1, h2, (unsigned long long)tile.hdr.width
+		| ((unsigned long long)tile.hdr.height << 16)
+		| ((unsigned long long)tile.pf->id << 32)
+		| ((unsigned long long)tile.flags << 40),
+		(unsigned long long)tile.hdr.compress | (tile.hdr.qual << 8)
+		| (tile.hdr.subsamp << 16));
+
+	for(int i = 0; i < tile.hdr.height; i++)
+	{
+		unsigned char *row = &tile.bits[tile.pitch * i];
+		int j;
+		for(j = 0; j <= rowSize - 16; j += 16)
+		{
+			memcpy(k, &row[j], 16);
+			mixBlock(h1, h2, k[0], k[1]);
+		}
+		if(j < rowSize)
+		{
+			k[0] = k[1] = 0;
+			memcpy(k, &row[j], rowSize - j);
+			mixBlock(h1, h2, k[0], k[1]);
+		}
+		len += rowSize;
+	}
+
+	h1 ^= len;  h2 ^= len;
+	h1 += h2;  h2 += h1;
+	h1 = fmix64(h1);  h2 = fmix64(h2);
+	h1 += h2;  h2 += h1;
+	d.h[0] = h1;  d.h[1] = h2;
+}
+
+
+int TileCache::find(Digest &d)
+{
+	for(int i = buckets[d.h[0] % NBUCKETS]; i >= 0; i = slots[i].chain)
+	{
+		if(slots[i].d.h[0] == d.h[0] && slots[i].d.h[1] == d.h[1])
+			return i;
+	}
+	return -1;
+}
+
+
+int TileCache::lookup(Digest &d)
+{
+	CriticalSection::SafeLock l(mutex);
+
+	int i = find(d);
+	// A tile stored during this frame may be stored by a different compression
+	// thread, in which case the client might not receive it until after this
+	// tile.
+	if(i < 0 || slots[i].stored == frame) return -1;
+
+	slots[i].lastUse = frame;
+	if(i != lruTail)
+	{
+		unlink(i);
+		slots[i].prev = lruTail;  slots[i].next = -1;
+		slots[lruTail].next = i;  lruTail = i;
+	}
+	return i;
+}
+
+
+int TileCache::insert(Digest &d, int size, unsigned int *released,
+	int &nReleased)
+{
+	CriticalSection::SafeLock l(mutex);
+
+	nReleased = 0;
+	if((size_t)size > budget || find(d) >= 0) return -1;
+
+	// Slots used during this frame can't be released, because the client may
+	// not have received the commands that use them yet.
+	size_t avail = budget - used;  int n = 0;
+	for(int i = lruHead; avail < (size_t)size; i = slots[i].next, n++)
+	{
+		if(i < 0 || slots[i].lastUse == frame || n >= TILECACHE_MAXRELEASE)
+			return -1;
+		avail += slots[i].size;
+	}
+	while(nReleased < n)
+	{
+		released[nReleased++] = lruHead;
+		release(lruHead);
+	}
+
+	// Likewise, a slot released during this frame can't be reused until the
+	// next frame.
+	int i;
+	if(freeHead >= 0 && slots[freeHead].lastUse != frame)
+	{
+		i = freeHead;
+		freeHead = slots[i].next;
+		if(freeHead < 0) freeTail = -1;
+	}
+	else
+	{
+		if(nSlots >= maxSlots)
+		{
+			int newMax = maxSlots ? maxSlots * 2 : 256;
+			Slot *newSlots = (Slot *)realloc(slots, sizeof(Slot) * newMax);
+			if(!newSlots) THROW("Memory allocation error");
+			slots = newSlots;  maxSlots = newMax;
+		}
+		i = nSlots++;
+	}
+
+	Slot &s = slots[i];
+	s.d = d;  s.size = size;  s.lastUse = s.stored = frame;
+	s.chain = buckets[d.h[0] % NBUCKETS];
+	buckets[d.h[0] % NBUCKETS] = i;
+	s.prev = lruTail;  s.next = -1;
+	if(lruTail >= 0) slots[lruTail].next = i;
+	else lruHead = i;
+	lruTail = i;
+	used += size;
+	return i;
+}
+
+
+// Remove a slot from the LRU list
+
+void TileCache::unlink(int i)
+{
+	if(slots[i].prev >= 0) slots[slots[i].prev].next = slots[i].next;
+	else lruHead = slots[i].next;
+	if(slots[i].next >= 0) slots[slots[i].next].prev = slots[i].prev;
+	else lruTail = slots[i].prev;
+}
+
+
+void TileCache::release(int i)
+{
+	Slot &s = slots[i];
+
+	unlink(i);
+	int *link = &buckets[s.d.h[0] % NBUCKETS];
+	while(*link != i) link = &slots[*link].chain;
+	*link = s.chain;
+
+	used -= s.size;
+	s.size = 0;  s.lastUse = frame;
+	s.next = -1;
+	if(freeTail >= 0) slots[freeTail].next = i;
+	else freeHead = i;
+	freeTail = i;
+}
+
+
+TileStore::TileStore(void) : slots(NULL), nSlots(0)
+{
+}
+
+
+TileStore::~TileStore(void)
+{
+	for(unsigned int i = 0; i < nSlots; i++) release(slots[i]);
+	free(slots);
+}
+
+
+TileStore::Slot &TileStore::getSlot(unsigned char *ptr, bool grow)
+{
+	unsigned int i = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | (ptr[3] << 24);
+
+	if(i >= nSlots)
+	{
+		// The server assigns slot numbers sequentially, so this limit is never
+		// reached unless the data is corrupt.
+		if(!grow || i >= (1 << 20)) THROW("Invalid tile cache slot");
+		unsigned int newN = max(i + 1, nSlots * 2);
+		Slot *newSlots = (Slot *)realloc(slots, sizeof(Slot) * newN);
+		if(!newSlots) THROW("Memory allocation error");
+		memset(&newSlots[nSlots], 0, sizeof(Slot) * (newN - nSlots));
+		slots = newSlots;  nSlots = newN;
+	}
+	return slots[i];
+}
+
+
+void TileStore::release(Slot &s)
+{
+	free(s.bits);
+	s.bits = NULL;  s.width = s.height = 0;  s.pf = NULL;
+}
+
+
+// The data of an RRCOMP_CACHEPUT tile is the slot in which to store the
+// tile's region of the frame buffer, followed by the slots to release.  The
+// slots are stored top down.
+
+void TileStore::put(Frame &fb, CompressedFrame &cf)
+{
+	rrframeheader &h = cf.hdr;
+
+	if(!fb.bits || !cf.bits || h.size < 4 || h.size % 4)
+		THROW("Invalid tile cache command");
+	if(h.x + h.width > fb.hdr.framew || h.y + h.height > fb.hdr.frameh)
+		throw Error("TileStore::put", "Argument out of range");
+
+	for(unsigned int i = 4; i < h.size; i += 4)
+		release(getSlot(&cf.bits[i], false));
+
+	Slot &s = getSlot(cf.bits, true);
+	int rowSize = h.width * fb.pf->size;
+	if(!s.bits || s.width * s.height * s.pf->size < h.height * rowSize)
+	{
+		release(s);
+		if((s.bits = (unsigned char *)malloc(h.height * rowSize)) == NULL)
+			THROW("Memory allocation error");
+	}
+	s.width = h.width;  s.height = h.height;  s.pf = fb.pf;
+
+	bool bu = (fb.flags & FRAME_BOTTOMUP);
+	for(int i = 0; i < h.height; i++)
+	{
+		int row = bu ? fb.hdr.frameh - h.y - i - 1 : h.y + i;
+		memcpy(&s.bits[rowSize * i], &fb.bits[fb.pitch * row + h.x * fb.pf->size],
+			rowSize);
+	}
+}
+
+
+// The data of an RRCOMP_CACHEGET tile is the slot whose contents should be
+// drawn into the tile's region of the frame buffer.
+
+void TileStore::get(Frame &fb, CompressedFrame &cf)
+{
+	rrframeheader &h = cf.hdr;
+
+	if(!fb.bits || !cf.bits || h.size != 4) THROW("Invalid tile cache command");
+	if(h.x + h.width > fb.hdr.framew || h.y + h.height > fb.hdr.frameh)
+		throw Error("TileStore::get", "Argument out of range");
+
+	Slot &s = getSlot(cf.bits, false);
+	if(!s.bits || s.width != h.width || s.height != h.height)
+		THROW("Invalid tile cache slot");
+
+	bool bu = (fb.flags & FRAME_BOTTOMUP);
+	int srcRowSize = h.width * s.pf->size;
+	for(int i = 0; i < h.height; i++)
+	{
+		int row = bu ? fb.hdr.frameh - h.y - i - 1 : h.y + i;
+		unsigned char *dst = &fb.bits[fb.pitch * row + h.x * fb.pf->size];
+		if(s.pf == fb.pf) memcpy(dst, &s.bits[srcRowSize * i], srcRowSize);
+		else s.pf->convert(&s.bits[srcRowSize * i], h.width, srcRowSize, 1, dst,
+			fb.pitch, fb.pf);
+	}
+}
@@ -0,0 +1,116 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __TILECACHE_H__
+#define __TILECACHE_H__
+
+#include "Frame.h"
+#include "Mutex.h"
+
+
+// Client-side tile caching.  The client keeps the decoded pixels of recently
+// sent tiles in numbered slots, and the server keeps a 128-bit digest of the
+// pixels in each slot.  When a tile whose digest matches one of the slots is
+// sent again (for instance, when the user switches back and forth between two
+// views), the server sends only the slot number.  The server decides which
+// slot each tile is stored in and which slots are released, so the client
+// never computes digests, and the two caches remain in sync as long as the
+// client processes the cache commands in the order in which they are sent.
+
+#define TILECACHE_MAXRELEASE  64  // Slots released by one RRCOMP_CACHEPUT
+
+namespace vglcommon
+{
+	// Server side: maps tile digests to the client's cache slots and evicts
+	// the least recently used tiles when the client's memory budget is
+	// exhausted.  The compression threads share one instance, so all methods
+	// are thread-safe.
+
+	class TileCache
+	{
+		public:
+
+			typedef struct
+			{
+				unsigned long long h[2];
+			} Digest;
+
+			TileCache(void);
+			~TileCache(void);
+			void setBudget(size_t bytes);
+			bool isEnabled(void) { return budget > 0; }
+			void newFrame(void);
+			static void digest(Frame &tile, Digest &d);
+			// Returns the slot containing the tile, or -1 if it isn't cached
+			int lookup(Digest &d);
+			// Returns the slot in which the client should store the tile, or -1 if
+			// the tile can't be cached, and sets released to the slots that the
+			// client should release first
+			int insert(Digest &d, int size, unsigned int *released, int &nReleased);
+
+		private:
+
+			static const int NBUCKETS = 4096;
+
+			typedef struct
+			{
+				Digest d;
+				int size;  // Bytes charged against the budget (0 = slot is free)
+				unsigned int lastUse;  // Frame in which the slot was last used
+				unsigned int stored;  // Frame in which the tile was stored
+				int prev, next;  // LRU list (or free list, if size == 0)
+				int chain;  // Next slot in the same hash bucket
+			} Slot;
+
+			int find(Digest &d);
+			void unlink(int slot);
+			void release(int slot);
+
+			vglutil::CriticalSection mutex;
+			Slot *slots;  int nSlots, maxSlots;
+			int buckets[NBUCKETS];
+			int lruHead, lruTail, freeHead, freeTail;
+			size_t budget, used;
+			unsigned int frame;
+	};
+
+
+	// Client side: stores the pixels of the tiles that the server has asked it
+	// to cache
+
+	class TileStore
+	{
+		public:
+
+			TileStore(void);
+			~TileStore(void);
+			// Handle an RRCOMP_CACHEPUT or RRCOMP_CACHEGET tile
+			void put(Frame &fb, CompressedFrame &cf);
+			void get(Frame &fb, CompressedFrame &cf);
+
+		private:
+
+			typedef struct
+			{
+				unsigned char *bits;
+				int width, height;
+				PF *pf;
+			} Slot;
+
+			Slot &getSlot(unsigned char *ptr, bool grow);
+			void release(Slot &s);
+
+			Slot *slots;  unsigned int nSlots;
+	};
+}
+
+#endif  // __TILECACHE_H__
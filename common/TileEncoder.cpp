@@ -0,0 +1,86 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "TileEncoder.h"
+#include "vglutil.h"
+
+using namespace vglutil;
+using namespace vglcommon;
+
+
+// JPEG tiles with at least SLICE_MINTILE pixels are divided into as many as
+// maxSlices slices, which the client can decompress in parallel.  Each slice
+// has at least SLICE_MINAREA pixels, so the overhead of the additional JPEG
+// headers is negligible.
+#define SLICE_MINTILE  (512 * 512)
+#define SLICE_MINAREA  (256 * 256)
+
+
+void TileEncoder::encode(Frame &f, Frame *last, Tiler::Tile &t,
+	CompressedFrame &cf, Result &result)
+{
+	int width = t.width, height = t.height;
+	Frame *tile = NULL, *lastTile = NULL;
+
+	result.getSlot = result.putSlot = -1;  result.nReleased = 0;
+
+	try
+	{
+		tile = f.getTile(t.x, t.y, width, height);
+		if(t.roi && f.hdr.compress == RRCOMP_JPEG && roiQual > tile->hdr.qual)
+			tile->hdr.qual = roiQual;
+
+		TileCache::Digest digest;
+		bool cacheOK = cache && cache->isEnabled() && !f.stereo;
+		if(cacheOK)
+		{
+			TileCache::digest(*tile, digest);
+			if((result.getSlot = cache->lookup(digest)) >= 0)
+			{
+				delete tile;
+				return;
+			}
+		}
+
+		if(delta && last)
+		{
+			// JPEG compresses an entire tile much better than RGB or lossless
+			// encoding does, so the break-even point is lower.
+			int limit = width * height / (f.hdr.compress == RRCOMP_JPEG ? 16 : 2);
+			int changes = f.tileChanges(last, t.x, t.y, width, height, limit);
+			if(changes >= 0 && changes <= limit)
+				lastTile = last->getTile(t.x, t.y, width, height);
+		}
+
+		if(lastTile) cf.compressDelta(*tile, *lastTile);
+		else
+		{
+			if(adaptive && !f.stereo && f.pf->bpc == 8) tile->selectEncoding();
+			int nSlices = min(maxSlices, width * height / SLICE_MINAREA);
+			if(tile->hdr.compress == RRCOMP_JPEG && !f.stereo
+				&& width * height >= SLICE_MINTILE && nSlices > 1)
+				cf.compressJPEGSlices(*tile, nSlices);
+			else cf = *tile;
+			// A delta tile is drawn on top of the previous frame, so the client's
+			// copy of it may not match the digest.
+			if(cacheOK)
+				result.putSlot = cache->insert(digest, width * height * 4,
+					result.released, result.nReleased);
+		}
+	}
+	catch(...)
+	{
+		delete tile;  delete lastTile;
+		throw;
+	}
+	delete tile;  delete lastTile;
+}
@@ -0,0 +1,77 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __TILEENCODER_H__
+#define __TILEENCODER_H__
+
+#include "Frame.h"
+#include "TileCache.h"
+#include "Tiler.h"
+
+
+// Chooses how each tile that the VGL Transport sends is encoded, and encodes
+// it.  vglsweep uses the same class, so it measures the same decisions that
+// the VGL Transport makes.  In order of preference:
+//
+// -- If the client's tile cache contains a tile with the same pixels, then
+//    the client is told to draw the cached tile (RRCOMP_CACHEGET.)
+// -- If only a few pixels in the tile have changed since the previous frame,
+//    then only those pixels are sent (RRCOMP_DELTA.)
+// -- Otherwise, the tile is encoded with the encoding chosen by
+//    Frame::selectEncoding() (if adaptive encoding is enabled) or with the
+//    frame's compression type, and large JPEG tiles are divided into slices
+//    (RRCOMP_JPEGSLICES.)  The client is then told to store the tile in its
+//    tile cache (RRCOMP_CACHEPUT), if there is room.
+
+namespace vglcommon
+{
+	class TileEncoder
+	{
+		public:
+
+			typedef struct
+			{
+				// If >= 0, then the client should draw the tile from this slot of its
+				// tile cache, and the compressed tile was not used.
+				int getSlot;
+				// If >= 0, then the client should store the tile in this slot of its
+				// tile cache, after releasing the slots in released[], once it has
+				// drawn the compressed tile.
+				int putSlot;
+				unsigned int released[TILECACHE_MAXRELEASE];  int nReleased;
+			} Result;
+
+			// delta = use delta tiles (requires interframe comparison), adaptive =
+			// use content-adaptive encoding, maxSlices = maximum number of slices
+			// per JPEG tile (1 = no slicing), roiQual = JPEG quality of the tiles
+			// near the mouse pointer (0 = same as the other tiles), cache = the
+			// client's tile cache (NULL = no tile caching)
+			TileEncoder(bool delta_, bool adaptive_, int maxSlices_, int roiQual_,
+				TileCache *cache_) : delta(delta_), adaptive(adaptive_),
+				maxSlices(maxSlices_), roiQual(roiQual_), cache(cache_)
+			{
+			}
+
+			// Encode tile t of f into cf.  last is the previous frame as it appears
+			// on the client (or NULL if there is none.)
+			void encode(Frame &f, Frame *last, Tiler::Tile &t, CompressedFrame &cf,
+				Result &result);
+
+		private:
+
+			bool delta, adaptive;
+			int maxSlices, roiQual;
+			TileCache *cache;
+	};
+}
+
+#endif  // __TILEENCODER_H__
@@ -0,0 +1,330 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "Tiler.h"
+#include <stdlib.h>
+#include "Error.h"
+#include "vglutil.h"
+
+using namespace vglutil;
+using namespace vglcommon;
+
+
+// Tile boundaries are aligned to the largest JPEG MCU size whenever possible,
+// and tiles are never split (for the purposes of balancing the load among the
+// threads) into tiles smaller than this.
+#define ALIGN  16
+
+// Tiles within this many pixels of the mouse pointer are sent first.
+#define ROI_RADIUS  128
+
+#define HISTORY_BLOCK  64
+
+
+Tiler::Tiler(void) : tiles(NULL), nTiles(0), maxTiles(0), nSkipped(0),
+	history(NULL), historyW(0), historyH(0)
+{
+}
+
+
+Tiler::~Tiler(void)
+{
+	free(tiles);
+	free(history);
+}
+
+
+// Returns the position (relative to the start of the tile) at which to split
+// a tile of the given width or height into two pieces, or 0 if either piece
+// would be smaller than minSize
+
+int Tiler::split(int size, int minSize)
+{
+	if(size < 2 * minSize) return 0;
+	int half = size / 2, aligned = (half + ALIGN / 2) & ~(ALIGN - 1);
+	if(aligned >= minSize && size - aligned >= minSize) half = aligned;
+	return half;
+}
+
+
+// Returns the position of the ith boundary when dividing size pixels into n
+// approximately equal tiles
+
+static int edge(int size, int i, int n, bool align)
+{
+	if(i >= n) return size;
+	int e = (int)((long long)size * i / n);
+	return align ? (e + ALIGN / 2) & ~(ALIGN - 1) : e;
+}
+
+
+void Tiler::divide(Frame &f, Frame *last, int tileSize, int minTileSize,
+	int nThreads)
+{
+	int w = f.hdr.width, h = f.hdr.height;
+
+	nTiles = nSkipped = 0;
+	if(nThreads < 1) nThreads = 1;
+
+	if(minTileSize <= 0)
+	{
+		int tileW = tileSize > 0 ? tileSize : w;
+		int tileH = tileSize > 0 ? tileSize : h;
+
+		for(int i = 0; i < h; i += tileH)
+		{
+			int height = tileH, y = i;
+
+			if(h - i < (3 * tileH / 2))
+			{
+				height = h - i;  i += tileH;
+			}
+			for(int j = 0; j < w; j += tileW)
+			{
+				int width = tileW, x = j;
+
+				if(w - j < (3 * tileW / 2))
+				{
+					width = w - j;  j += tileW;
+				}
+				if(f.tileEquals(last, x, y, width, height)) nSkipped++;
+				else add(x, y, width, height);
+			}
+		}
+		prioritize(f);
+		for(int i = 0; i < nTiles; i++) tiles[i].rank = i % nThreads;
+		return;
+	}
+
+	// Dividing the frame into equal-sized tiles avoids the oddly shaped tiles
+	// that fixed tiling produces at the right and bottom edges.
+	int nx = tileSize > 0 ? max((w + tileSize / 2) / tileSize, 1) : 1;
+	int ny = tileSize > 0 ? max((h + tileSize / 2) / tileSize, 1) : 1;
+	bool align = tileSize >= 64;
+
+	for(int i = 0; i < ny; i++)
+	{
+		int y0 = edge(h, i, ny, align), y1 = edge(h, i + 1, ny, align);
+
+		for(int j = 0; j < nx; j++)
+		{
+			int x0 = edge(w, j, nx, align), x1 = edge(w, j + 1, nx, align);
+
+			if(f.tileEquals(last, x0, y0, x1 - x0, y1 - y0)) nSkipped++;
+			else subdivide(f, last, x0, y0, x1 - x0, y1 - y0, minTileSize);
+		}
+	}
+	balance(f, last, nThreads);
+	assign(nThreads);
+	prioritize(f);
+	// Make sure that the most important tile is compressed by the first thread.
+	int first = nTiles > 0 ? tiles[0].rank : 0;
+	if(first != 0)
+	{
+		for(int i = 0; i < nTiles; i++)
+		{
+			if(tiles[i].rank == first) tiles[i].rank = 0;
+			else if(tiles[i].rank == 0) tiles[i].rank = first;
+		}
+	}
+}
+
+
+void Tiler::add(int x, int y, int width, int height)
+{
+	if(nTiles >= maxTiles)
+	{
+		int newMax = maxTiles ? maxTiles * 2 : 64;
+		Tile *newTiles = (Tile *)realloc(tiles, sizeof(Tile) * newMax);
+		if(!newTiles) THROW("Memory allocation error");
+		tiles = newTiles;  maxTiles = newMax;
+	}
+	Tile &t = tiles[nTiles++];
+	t.x = x;  t.y = y;  t.width = width;  t.height = height;  t.rank = 0;
+	t.priority = 0;  t.roi = false;
+}
+
+
+// Add a tile that has changed, or the changed quadrants of the tile if some of
+// its quadrants have not changed
+
+void Tiler::subdivide(Frame &f, Frame *last, int x, int y, int width,
+	int height, int minTileSize)
+{
+	int sx = split(width, minTileSize), sy = split(height, minTileSize);
+
+	if(!last || (!sx && !sy))
+	{
+		add(x, y, width, height);  return;
+	}
+
+	int xs[3] = { x, x + (sx ? sx : width), x + width };
+	int ys[3] = { y, y + (sy ? sy : height), y + height };
+	int nx = sx ? 2 : 1, ny = sy ? 2 : 1, nChanged = 0;
+	bool changed[4];
+
+	for(int i = 0; i < ny; i++)
+		for(int j = 0; j < nx; j++)
+		{
+			changed[i * 2 + j] = !f.tileEquals(last, xs[j], ys[i], xs[j + 1] - xs[j],
+				ys[i + 1] - ys[i]);
+			if(changed[i * 2 + j]) nChanged++;
+		}
+	if(nChanged == nx * ny)
+	{
+		add(x, y, width, height);  return;
+	}
+	for(int i = 0; i < ny; i++)
+		for(int j = 0; j < nx; j++)
+		{
+			if(changed[i * 2 + j])
+				subdivide(f, last, xs[j], ys[i], xs[j + 1] - xs[j], ys[i + 1] - ys[i],
+					minTileSize);
+			else nSkipped++;
+		}
+}
+
+
+// If there are fewer tiles than threads, then split the largest tiles in half
+// along their longer dimension.
+
+void Tiler::balance(Frame &f, Frame *last, int nThreads)
+{
+	while(nTiles > 0 && nTiles < nThreads)
+	{
+		int largest = -1;  long long maxArea = 0;
+		for(int i = 0; i < nTiles; i++)
+		{
+			Tile &t = tiles[i];
+			long long area = (long long)t.width * t.height;
+			if(split(max(t.width, t.height), ALIGN) && area > maxArea)
+			{
+				largest = i;  maxArea = area;
+			}
+		}
+		if(largest < 0) break;
+
+		Tile t1 = tiles[largest], t2 = t1;
+		if(t1.width >= t1.height)
+		{
+			t1.width = split(t1.width, ALIGN);
+			t2.x += t1.width;  t2.width -= t1.width;
+		}
+		else
+		{
+			t1.height = split(t1.height, ALIGN);
+			t2.y += t1.height;  t2.height -= t1.height;
+		}
+		tiles[largest] = tiles[--nTiles];
+		// One of the halves may not have changed.
+		if(f.tileEquals(last, t1.x, t1.y, t1.width, t1.height)) nSkipped++;
+		else add(t1.x, t1.y, t1.width, t1.height);
+		if(f.tileEquals(last, t2.x, t2.y, t2.width, t2.height)) nSkipped++;
+		else add(t2.x, t2.y, t2.width, t2.height);
+	}
+}
+
+
+int Tiler::compareArea(const void *arg1, const void *arg2)
+{
+	const Tile *t1 = (const Tile *)arg1, *t2 = (const Tile *)arg2;
+	long long a1 = (long long)t1->width * t1->height,
+		a2 = (long long)t2->width * t2->height;
+	return a1 > a2 ? -1 : (a1 < a2 ? 1 : 0);
+}
+
+
+int Tiler::comparePriority(const void *arg1, const void *arg2)
+{
+	const Tile *t1 = (const Tile *)arg1, *t2 = (const Tile *)arg2;
+	if(t1->priority != t2->priority)
+		return t1->priority < t2->priority ? -1 : 1;
+	if(t1->y != t2->y) return t1->y < t2->y ? -1 : 1;
+	return t1->x < t2->x ? -1 : (t1->x > t2->x ? 1 : 0);
+}
+
+
+// Assign each tile, largest first, to the thread that has been assigned the
+// fewest pixels so far.
+
+void Tiler::assign(int nThreads)
+{
+	long long *load;
+
+	if(nTiles < 1) return;
+	if((load = (long long *)calloc(nThreads, sizeof(long long))) == NULL)
+		THROW("Memory allocation error");
+	qsort(tiles, nTiles, sizeof(Tile), compareArea);
+	for(int i = 0; i < nTiles; i++)
+	{
+		int rank = 0;
+		for(int j = 1; j < nThreads; j++)
+			if(load[j] < load[rank]) rank = j;
+		tiles[i].rank = rank;
+		load[rank] += (long long)tiles[i].width * tiles[i].height;
+	}
+	free(load);
+}
+
+
+// Sort the tiles in the order in which they should be sent, then record which
+// blocks of the frame changed in this frame.
+
+void Tiler::prioritize(Frame &f)
+{
+	int w = f.hdr.width, h = f.hdr.height;
+	int hw = (w + HISTORY_BLOCK - 1) / HISTORY_BLOCK,
+		hh = (h + HISTORY_BLOCK - 1) / HISTORY_BLOCK;
+	int px = f.pointerX, py = f.pointerY;
+	bool pointer = (px >= 0 && py >= 0 && px < w && py < h);
+
+	if(hw != historyW || hh != historyH)
+	{
+		free(history);  historyW = historyH = 0;
+		if((history = (unsigned char *)calloc(hw * hh, 1)) == NULL)
+			THROW("Memory allocation error");
+		historyW = hw;  historyH = hh;
+	}
+
+	for(int i = 0; i < nTiles; i++)
+	{
+		Tile &t = tiles[i];
+		int dx = px < t.x ? t.x - px : max(px - (t.x + t.width - 1), 0);
+		int dy = py < t.y ? t.y - py : max(py - (t.y + t.height - 1), 0);
+		int dist = max(dx, dy), activity = 0;
+
+		t.roi = pointer && dist <= ROI_RADIUS;
+		for(int by = t.y / HISTORY_BLOCK;
+			by <= (t.y + t.height - 1) / HISTORY_BLOCK; by++)
+			for(int bx = t.x / HISTORY_BLOCK;
+				bx <= (t.x + t.width - 1) / HISTORY_BLOCK; bx++)
+			{
+				int n = 0;
+				for(unsigned char b = history[by * historyW + bx]; b; b >>= 1)
+					n += b & 1;
+				activity = max(activity, n);
+			}
+		t.priority = t.roi ? dist : ROI_RADIUS + 1 + (8 - activity);
+	}
+	qsort(tiles, nTiles, sizeof(Tile), comparePriority);
+
+	for(int i = 0; i < historyW * historyH; i++) history[i] <<= 1;
+	for(int i = 0; i < nTiles; i++)
+	{
+		Tile &t = tiles[i];
+		for(int by = t.y / HISTORY_BLOCK;
+			by <= (t.y + t.height - 1) / HISTORY_BLOCK; by++)
+			for(int bx = t.x / HISTORY_BLOCK;
+				bx <= (t.x + t.width - 1) / HISTORY_BLOCK; bx++)
+				history[by * historyW + bx] |= 1;
+	}
+}
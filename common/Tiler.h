@@ -0,0 +1,91 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __TILER_H__
+#define __TILER_H__
+
+#include "Frame.h"
+
+
+// Divides a frame into the tiles that need to be compressed and sent, and
+// assigns each tile to a compression thread.
+//
+// With fixed tiling, the frame is divided into tiles of the specified size
+// (the tiles at the right and bottom edges may be up to 1.5 times as large),
+// and the tiles that have changed are assigned to the threads in a round robin
+// fashion.
+//
+// With adaptive tiling (minTileSize > 0), the frame is divided into tiles of
+// approximately the specified size.  Each tile that has changed is divided into
+// quadrants, and if some of the quadrants have not changed, then only the
+// changed quadrants are sent (and are subdivided in the same manner, down to
+// minTileSize x minTileSize pixels.)  Thus, large tiles, which compress more
+// efficiently, are used where the frame has changed extensively, and small
+// tiles are used where the changes are localized.  If there are fewer tiles
+// than threads, then the largest tiles are split in half until each thread has
+// a tile, and the tiles are assigned to the threads so as to balance the number
+// of pixels that each thread compresses.
+//
+// In either case, the tiles are sorted in the order in which they should be
+// sent, so that the areas of the frame that the user is most likely to be
+// watching are updated first:  the tiles near the mouse pointer (nearest
+// first), then the tiles in the areas of the frame that have changed most
+// often in recent frames (such as a 3D viewport), then the remaining tiles in
+// raster order.  The first tile is always assigned to the first thread, which
+// sends its tiles as soon as they are compressed.
+
+namespace vglcommon
+{
+	class Tiler
+	{
+		public:
+
+			typedef struct
+			{
+				int x, y, width, height;  // Top-down coordinates
+				int rank;  // Compression thread
+				int priority;  // Tiles with lower values are sent first
+				bool roi;  // The tile is near the mouse pointer
+			} Tile;
+
+			Tiler(void);
+			~Tiler(void);
+			// Divide f into tiles, omitting the tiles that are unchanged in last (if
+			// last is non-NULL.)  A tile size of 0 uses the whole frame as the
+			// initial tile.
+			void divide(Frame &f, Frame *last, int tileSize, int minTileSize,
+				int nThreads);
+			int getCount(void) { return nTiles; }
+			// Number of unchanged tiles that were omitted
+			int getSkipped(void) { return nSkipped; }
+			Tile &operator[](int i) { return tiles[i]; }
+
+		private:
+
+			void add(int x, int y, int width, int height);
+			void subdivide(Frame &f, Frame *last, int x, int y, int width,
+				int height, int minTileSize);
+			void balance(Frame &f, Frame *last, int nThreads);
+			void assign(int nThreads);
+			void prioritize(Frame &f);
+			static int split(int size, int minSize);
+			static int compareArea(const void *arg1, const void *arg2);
+			static int comparePriority(const void *arg1, const void *arg2);
+
+			Tile *tiles;  int nTiles, maxTiles, nSkipped;
+			// For each 64x64-pixel block of the frame, a bit mask of the recent
+			// frames in which the block changed (bit 0 = most recent frame)
+			unsigned char *history;  int historyW, historyH;
+	};
+}
+
+#endif  // __TILER_H__
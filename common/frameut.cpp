@@ -581,6 +581,120 @@ void rgbBench(char *filename)
 }
 
 
+// Decode a frame whose tiles use different encodings into a GLFrame, then
+// re-encode single tiles with JPEG and RGB encoding (which change the
+// GLFrame's pixel format), and verify that the tiles that were not resent
+// retain their colors.  The first tile is a solid tile, as is common with
+// VGL_ADAPTIVE=1.
+
+#define MIXED_TILE  64
+
+static const int mixedTiles[][5] =
+{
+	// Frame, tile x, tile y, encoding, tolerance
+	{ 0, 0, 0, RRCOMP_SOLID, 0 },
+	{ 0, 1, 0, RRCOMP_LOSSLESS, 0 },
+	{ 0, 0, 1, RRCOMP_JPEG, 8 },
+	{ 0, 1, 1, RRCOMP_LOSSLESS, 0 },
+	{ 1, 1, 1, RRCOMP_RGB, 0 },
+	{ 2, 1, 0, RRCOMP_JPEG, 8 },
+	{ 3, 0, 1, RRCOMP_RGB, 0 }
+};
+
+bool checkMixed(Frame &src, Frame &dst, int tolerance[2][2])
+{
+	for(int j = 0; j < src.hdr.height; j++)
+	{
+		int _j = (dst.flags & FRAME_BOTTOMUP) ? src.hdr.height - j - 1 : j;
+		for(int i = 0; i < src.hdr.width; i++)
+		{
+			int r, g, b, dr, dg, db,
+				tol = tolerance[j / MIXED_TILE][i / MIXED_TILE];
+			src.pf->getRGB(&src.bits[src.pitch * j + i * src.pf->size], &r, &g,
+				&b);
+			dst.pf->getRGB(&dst.bits[dst.pitch * _j + i * dst.pf->size], &dr, &dg,
+				&db);
+			if(abs(r - dr) > tol || abs(g - dg) > tol || abs(b - db) > tol)
+				return false;
+		}
+	}
+	return true;
+}
+
+int mixedTest(Display *dpy)
+{
+	Window win;
+	Frame src;  CompressedFrame cf;
+	int failures = 0, tolerance[2][2] = { { 0, 0 }, { 0, 0 } };
+
+	ERRIFNOT(win = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0,
+		MIXED_TILE * 2, MIXED_TILE * 2, 0, WhitePixel(dpy, DefaultScreen(dpy)),
+		BlackPixel(dpy, DefaultScreen(dpy))));
+	ERRIFNOT(XMapRaised(dpy, win));
+
+	try
+	{
+		GLFrame dst(dpy, win);
+		rrframeheader hdr;
+		memset(&hdr, 0, sizeof(rrframeheader));
+		hdr.framew = hdr.width = MIXED_TILE * 2;
+		hdr.frameh = hdr.height = MIXED_TILE * 2;
+		hdr.qual = 100;  hdr.subsamp = 1;
+		src.init(hdr, PF_RGB, 0);
+
+		// The ranges of the red and blue components don't overlap, so swapping
+		// them is detected even in JPEG tiles.  The first tile is solid.
+		for(int j = 0; j < hdr.height; j++)
+		{
+			for(int i = 0; i < hdr.width; i++)
+			{
+				unsigned char *pixel = &src.bits[src.pitch * j + i * src.pf->size];
+				if(i < MIXED_TILE && j < MIXED_TILE)
+					src.pf->setRGB(pixel, 224, 128, 32);
+				else src.pf->setRGB(pixel, 192 + i % 64, i + j, j % 64);
+			}
+		}
+
+		int frame = 0;
+		for(unsigned int t = 0; t < sizeof(mixedTiles) / sizeof(mixedTiles[0]);
+			t++)
+		{
+			Frame *tile = src.getTile(mixedTiles[t][1] * MIXED_TILE,
+				mixedTiles[t][2] * MIXED_TILE, MIXED_TILE, MIXED_TILE);
+			tile->hdr.compress = mixedTiles[t][3];
+			try
+			{
+				cf = *tile;
+			}
+			catch(...)
+			{
+				delete tile;  throw;
+			}
+			delete tile;
+			dst = cf;
+			tolerance[mixedTiles[t][2]][mixedTiles[t][1]] = mixedTiles[t][4];
+
+			if(t + 1 == sizeof(mixedTiles) / sizeof(mixedTiles[0])
+				|| mixedTiles[t + 1][0] != frame)
+			{
+				dst.redraw();
+				fprintf(stderr, "Mixed tiles, frame %d (%s) - ", frame,
+					dst.pf->name);
+				if(checkMixed(src, dst, tolerance)) fprintf(stderr, "Passed.\n");
+				else { fprintf(stderr, "FAILED!\n");  failures++; }
+				frame++;
+			}
+		}
+	}
+	catch(...)
+	{
+		XDestroyWindow(dpy, win);  throw;
+	}
+	XDestroyWindow(dpy, win);
+	return failures;
+}
+
+
 void usage(char **argv)
 {
 	fprintf(stderr, "\nUSAGE: %s [options]\n\n", argv[0]);
@@ -593,7 +707,9 @@ void usage(char **argv)
 	fprintf(stderr, "-rgbbench <filename> = Benchmark the decoding of RGB-encoded frames.\n");
 	fprintf(stderr, "                       <filename> should be a BMP or PPM file.\n");
 	fprintf(stderr, "-v = Verbose output (may affect benchmark results)\n");
-	fprintf(stderr, "-check = Check correctness of pixel paths (implies -rgb)\n\n");
+	fprintf(stderr, "-check = Check correctness of pixel paths (implies -rgb)\n");
+	fprintf(stderr, "-mixed = Check the decoding of frames that mix tile encodings into\n");
+	fprintf(stderr, "         an OpenGL frame\n\n");
 	exit(1);
 }
 
@@ -604,7 +720,7 @@ int main(int argc, char **argv)
 	FrameTest *test[NUMWIN];
 	int i, j, w, h;
 	char *fileName = NULL;
-	bool verbose = false;
+	bool verbose = false, doMixed = false;
 
 	if(argc > 1) for(i = 1; i < argc; i++)
 	{
@@ -634,6 +750,7 @@ int main(int argc, char **argv)
 		}
 		else if(!stricmp(argv[i], "-v")) verbose = true;
 		else if(!stricmp(argv[i], "-check")) { check = true;  useRGB = true; }
+		else if(!stricmp(argv[i], "-mixed")) doMixed = true;
 		else usage(argv);
 	}
 
@@ -648,6 +765,13 @@ int main(int argc, char **argv)
 			exit(1);
 		}
 
+		if(doMixed)
+		{
+			int failures = mixedTest(dpy);
+			XCloseDisplay(dpy);
+			exit(failures ? 1 : 0);
+		}
+
 		for(int format = 0; format < PIXELFORMATS - 1; format++)
 		{
 			PF *pf = pf_get(format);
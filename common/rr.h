@@ -17,7 +17,7 @@
 #define __RR_H
 
 #define RR_MAJOR_VERSION  2
-#define RR_MINOR_VERSION  1
+#define RR_MINOR_VERSION  2
 
 /* Argh! */
 #if !defined(__SUNPRO_CC) && !defined(__SUNPRO_C)
@@ -88,7 +88,10 @@ enum
   RR_EOF = 1,  /* this tile is an End-of-Frame marker and contains no real
                   image data */
   RR_LEFT,     /* this tile goes to the left buffer of a stereo frame */
-  RR_RIGHT     /* this tile goes to the right buffer of a stereo frame */
+  RR_RIGHT,    /* this tile goes to the right buffer of a stereo frame */
+  RR_HALFSIZE = 0x80  /* (combined with RR_EOF) the frame is half the width
+                         and height of the window and should be scaled up by
+                         2x when it is drawn (requires protocol v2.2) */
 };
 
 /* Transport types */
@@ -99,34 +102,71 @@ enum rrtrans
 };
 
 /* Compression types */
-#define RR_COMPRESSOPT  5
+#define RR_COMPRESSOPT  6
 enum rrcomp
 {
-  RRCOMP_PROXY = 0, RRCOMP_JPEG, RRCOMP_RGB, RRCOMP_XV, RRCOMP_YUV
+  RRCOMP_PROXY = 0, RRCOMP_JPEG, RRCOMP_RGB, RRCOMP_XV, RRCOMP_YUV,
+  RRCOMP_LOSSLESS,
+  /* The following tile encodings are chosen by the server on a tile-by-tile
+     basis and cannot be selected as a compression type. */
+  RRCOMP_DELTA = 32,  /* Lossless encoding of only the pixels that have changed
+                         since the previous frame */
+  RRCOMP_COPYRECT,    /* Copy the pixels of another region of the previous
+                         frame into this tile's region.  The data is the X and
+                         Y offset of the source region (2 bytes each, little
+                         endian.) */
+  RRCOMP_CACHEPUT,    /* Store the pixels in this tile's region, which have
+                         already been drawn, in a slot of the client's tile
+                         cache.  The data is the slot number, followed by the
+                         numbers of any slots that should be released (4 bytes
+                         each, little endian.) */
+  RRCOMP_CACHEGET,    /* Draw the pixels in a slot of the client's tile cache
+                         into this tile's region.  The data is the slot number
+                         (4 bytes, little endian.) */
+  RRCOMP_SOLID,       /* Fill this tile's region with a single color.  The data
+                         is the color (3 bytes: red, green, blue.) */
+  RRCOMP_JPEGSLICES,  /* The tile is divided into horizontal slices, each of
+                         which is a separate JPEG image, so the slices can be
+                         decompressed in parallel.  The data is the number of
+                         slices (1 byte), followed by the height (2 bytes) and
+                         size (4 bytes) of each slice (little endian), followed
+                         by the slices in top-down order. */
+  RRCOMP_FRAMEID      /* Sent before the first tile of a frame when the
+                         VirtualGL Faker is tracing frame latency (see
+                         VGL_FRAMETRACE), so that the VirtualGL Client can
+                         use the same frame ID in its trace.  The data is the
+                         ID (4 bytes, little endian.) */
 };
 
+/* Maximum number of slices in an RRCOMP_JPEGSLICES tile */
+#define RR_MAXSLICES  16
+
+/* If both the client and the server support protocol v2.2, then the client
+   sends the size of its tile cache, in kilobytes (4 bytes, little endian),
+   after it receives the server's version. */
+
 /* Readback types */
 #define RR_READBACKOPT  3
 enum rrread { RRREAD_NONE = 0, RRREAD_SYNC, RRREAD_PBO };
 
 static const enum rrtrans _Trans[RR_COMPRESSOPT] =
 {
-  RRTRANS_X11, RRTRANS_VGL, RRTRANS_VGL, RRTRANS_XV, RRTRANS_VGL
+  RRTRANS_X11, RRTRANS_VGL, RRTRANS_VGL, RRTRANS_XV, RRTRANS_VGL, RRTRANS_VGL
 };
 
 static const int _Minsubsamp[RR_COMPRESSOPT] =
 {
-  -1, 0, -1, 4, 4
+  -1, 0, -1, 4, 4, -1
 };
 
 static const int _Defsubsamp[RR_COMPRESSOPT] =
 {
-  1, 1, 1, 4, 4
+  1, 1, 1, 4, 4, 1
 };
 
 static const int _Maxsubsamp[RR_COMPRESSOPT] =
 {
-  -1, 4, -1, 4, 4
+  -1, 4, -1, 4, 4, -1
 };
 
 /* Stereo options */
@@ -150,6 +190,8 @@ enum rrdrawable { RRDRAWABLE_PBUFFER = 0, RRDRAWABLE_PIXMAP };
 #define RR_DEFAULTSSLPORT  RR_DEFAULTPORT
 #endif
 #define RR_DEFAULTTILESIZE  256
+#define RR_DEFAULTMINTILESIZE  64
+#define RR_DEFAULTTILECACHE  64  /* Megabytes */
 
 /* Maximum threads that be can be used for parallel image compression */
 /* (the algorithms don't scale beyond 3) */
@@ -160,11 +202,13 @@ enum rrdrawable { RRDRAWABLE_PBUFFER = 0, RRDRAWABLE_PIXMAP };
 /* Faker configuration */
 typedef struct _FakerConfig
 {
+  char adaptive;
   char allowindirect;
   char autotest;
   char client[MAXSTR];
   int compress;
   char config[MAXSTR];
+  char dedup;
   char defaultfbconfig[MAXSTR];
   char dlsymloader;
   char drawable;
@@ -181,23 +225,29 @@ typedef struct _FakerConfig
   unsigned int guikey;
   char guikeyseq[MAXSTR];
   unsigned int guimod;
+  int interactive;
   char interframe;
   char localdpystring[MAXSTR];
   char log[MAXSTR];
   char logo;
+  int mintilesize;
   int np;
   int port;
   char probeglx;
   int qual;
   char readback;
   double refreshrate;
+  int roiqual;
   int samples;
+  char scroll;
+  int slices;
   char spoil;
   char spoillast;
   char ssl;
   int stereo;
   int subsamp;
   char sync;
+  int tilecache;
   int tilesize;
   char trace;
   int transpixel;
@@ -31,8 +31,13 @@ namespace vglutil
 			GenericQ(void);
 			~GenericQ(void);
 			void add(void *item);
-			void spoil(void *item, SpoilCallback spoilCallback);
+			// Returns the number of items that were spoiled
+			int spoil(void *item, SpoilCallback spoilCallback);
 			void get(void **item, bool nonBlocking = false);
+			// Same as get(), but waits no longer than the specified number of
+			// seconds for an item to be added to the queue.  *item is set to NULL
+			// if the wait timed out.
+			void timedGet(void **item, double timeout);
 			void release(void);
 			int items(void);
 
@@ -92,6 +92,9 @@ namespace vglutil
 			~Semaphore(void);
 			void wait(void);
 			bool tryWait();
+			// Returns false if the semaphore could not be decremented within the
+			// specified number of seconds
+			bool timedWait(double seconds);
 			void post(void);
 			long getValue(void);
 
@@ -155,6 +155,10 @@ namespace vglutil
 			void send(char *buf, int len);
 			void recv(char *buf, int len);
 			const char *remoteName(void);
+			// Number of send()/recv() (or SSL_write()/SSL_read()) calls made on this
+			// socket
+			unsigned long long getSendCalls(void) { return sendCalls; }
+			unsigned long long getRecvCalls(void) { return recvCalls; }
 
 		private:
 
@@ -185,6 +189,7 @@ namespace vglutil
 			SOCKET sd;
 			char remoteNameBuf[INET6_ADDRSTRLEN];
 			bool ipv6;
+			unsigned long long sendCalls, recvCalls;
 	};
 }
 
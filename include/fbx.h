@@ -67,12 +67,13 @@ typedef struct _fbx_struct
 	HDC hmdc;  HBITMAP hdib;
 	#else
 	#ifdef USESHM
-	XShmSegmentInfo shminfo;  int xattach;
+	XShmSegmentInfo shminfo;  int xattach, pending;
 	#endif
 	GC xgc;
 	XImage *xi;
 	Pixmap pm;
 	int pixmap;
+	int present, presentOpcode;  XID presentEID;
 	#endif
 } fbx_struct;
 
@@ -105,6 +106,11 @@ extern "C" {
   -- fbx_init() is idempotent.  If you call it multiple times, it will
      re-initialize the buffer only when it is necessary to do so (such as when
      the window size has changed.)
+  -- On Unix, if useShm is non-zero, the FBX_USEPRESENT environment variable
+     is set to 1, and the X server supports the X Present extension, then
+     fbx_init() will back the buffer with a MIT-SHM pixmap, and writes will be
+     performed using PresentPixmap().  If the X Present extension is not
+     available, then FBX falls back to using XShmPutImage().
   -- On Windows, fbx_init() will return a buffer configured with the same pixel
      format as the screen, unless the screen depth is < 24 bits, in which case
      it will always return a 32-bit BGRA buffer.
@@ -171,6 +177,16 @@ int fbx_write(fbx_struct *fb, int srcX, int srcY, int dstX, int dstY,
 
   Same as fbx_write, but asynchronous.  The write isn't guaranteed to complete
   until fbx_sync() is called.  On Windows, fbx_awrite is the same as fbx_write.
+
+  If MIT-SHM is being used, then the X server is asked to send a completion
+  event once it has finished reading from the shared memory segment, and
+  fbx_wait() can be used to wait for that event prior to modifying fb->bits
+  again.  This allows the caller to overlap the X server's consumption of the
+  buffer with other work without performing a full round trip for each write.
+
+  If the X Present extension is being used (see fbx_init()), then the write is
+  performed with PresentPixmap() from the shared memory pixmap, and fbx_wait()
+  waits for the corresponding PresentIdleNotify event instead.
 */
 #ifdef _WIN32
 #define fbx_awrite  fbx_write
@@ -209,6 +225,18 @@ int fbx_flip(fbx_struct *fb, int srcX, int srcY, int width, int height);
 int fbx_sync(fbx_struct *fb);
 
 
+/*
+  fbx_wait
+  (fbx_struct *fb)
+
+  Wait until the X server has finished reading from the shared memory segment
+  used by all previous asynchronous writes, so that fb->bits can safely be
+  modified.  This returns immediately if there are no outstanding writes or if
+  MIT-SHM is not being used.  On Windows, this does nothing.
+*/
+int fbx_wait(fbx_struct *fb);
+
+
 /*
   fbx_term
   (fbx_struct *fb)
@@ -0,0 +1,254 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "BinaryTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "faker.h"
+#include "threadlocal.h"
+
+using namespace vglutil;
+using namespace vglserver;
+
+
+namespace vglserver
+{
+	// Index + 1 of the calling thread's ring buffer (0 = not yet assigned)
+	VGL_THREAD_LOCAL(TraceThread, long, 0)
+}
+
+
+BinaryTracer *BinaryTracer::instance = NULL;
+CriticalSection BinaryTracer::instanceMutex;
+
+
+BinaryTracer *BinaryTracer::getInstance(void)
+{
+	if(instance == NULL)
+	{
+		CriticalSection::SafeLock l(instanceMutex);
+		if(instance == NULL) instance = new BinaryTracer;
+	}
+	return instance;
+}
+
+
+BinaryTracer::BinaryTracer(void) : enabled(false), map(NULL), mapSize(0),
+	header(NULL), names(NULL), threads(NULL), rings(NULL), startTime(0.0)
+{
+	char *env = getenv("VGL_TRACEFILE"), fileName[1024];
+	int fd = -1;
+
+	for(int i = 0; i < MAXDISPLAYS; i++)
+	{
+		displays[i] = NULL;  displayNames[i] = 0;
+	}
+	if(!env || strlen(env) < 1) return;
+
+	// Replace %p with the process ID, so that each process in a multi-process
+	// application can have its own trace file.
+	const char *p = strstr(env, "%p");
+	if(p)
+		snprintf(fileName, 1024, "%.*s%d%s", (int)(p - env), env, (int)getpid(),
+			p + 2);
+	else snprintf(fileName, 1024, "%s", env);
+
+	mapSize = sizeof(BinTraceHeader) + sizeof(BinTraceName) * BINTRACE_MAXNAMES
+		+ sizeof(BinTraceThread) * BINTRACE_MAXTHREADS
+		+ sizeof(BinTraceRecord) * BINTRACE_MAXTHREADS * BINTRACE_RINGSIZE;
+
+	// The file is sparse, so the ring buffers of threads that never make an
+	// interposed call don't occupy any disk space.
+	if((fd = ::open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1
+		|| ftruncate(fd, mapSize) == -1
+		|| (map = (unsigned char *)mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		vglout.println("[VGL] WARNING: Could not create trace file %s (%s)",
+			fileName, strerror(errno));
+		if(fd != -1) ::close(fd);
+		map = NULL;
+		return;
+	}
+	::close(fd);
+
+	header = (BinTraceHeader *)map;
+	names = (BinTraceName *)&header[1];
+	threads = (BinTraceThread *)&names[BINTRACE_MAXNAMES];
+	rings = (BinTraceRecord *)&threads[BINTRACE_MAXTHREADS];
+
+	memcpy(header->id, BINTRACE_ID, 8);
+	header->headerSize = sizeof(BinTraceHeader);
+	header->nameSize = sizeof(BinTraceName);
+	header->threadSize = sizeof(BinTraceThread);
+	header->recordSize = sizeof(BinTraceRecord);
+	header->maxNames = BINTRACE_MAXNAMES;
+	header->maxThreads = BINTRACE_MAXTHREADS;
+	header->ringSize = BINTRACE_RINGSIZE;
+	header->slots = BINTRACE_SLOTS;
+	header->pid = (int)getpid();
+	header->startTime = startTime = GetTime();
+	// Name ID 0 marks the argument slots that continue the previous argument.
+	header->nNames = 1;
+	enabled = true;
+}
+
+
+unsigned short BinaryTracer::registerName(const char *name, char type)
+{
+	if(!enabled) return 0;
+	CriticalSection::SafeLock l(mutex);
+
+	if(header->nNames >= BINTRACE_MAXNAMES) return 0;
+	BinTraceName &n = names[header->nNames];
+	n.type = type;
+	strncpy(n.name, name, sizeof(n.name) - 1);
+	n.name[sizeof(n.name) - 1] = 0;
+	return header->nNames++;
+}
+
+
+int BinaryTracer::newThread(void)
+{
+	CriticalSection::SafeLock l(mutex);
+
+	if(header->nThreads >= BINTRACE_MAXTHREADS)
+	{
+		static bool alreadyWarned = false;
+		if(!alreadyWarned)
+		{
+			vglout.println("[VGL] WARNING: Too many threads to trace.  Calls made by additional");
+			vglout.println("[VGL]    threads will not be recorded.");
+			alreadyWarned = true;
+		}
+		return -1;
+	}
+	int thread = header->nThreads++;
+	threads[thread].threadID = (unsigned long long)pthread_self();
+	setTraceThread(thread + 1);
+	return thread;
+}
+
+
+void BinaryTracer::open(BinTraceCall &call, unsigned short funcID, long level)
+{
+	call.thread = -1;  call.nSlots = 0;  call.nIn = 0;  call.start = 0.0;
+	call.funcID = funcID;
+	call.level = level > 255 ? 255 : (unsigned char)level;
+	if(!enabled) return;
+
+	long thread = getTraceThread() - 1;
+	if(thread < 0) thread = newThread();
+	call.thread = thread;
+	if(thread >= 0) call.seq = threads[thread].nCalls++;
+}
+
+
+void BinaryTracer::close(BinTraceCall &call, double duration)
+{
+	if(!enabled || call.thread < 0) return;
+
+	BinTraceThread &t = threads[call.thread];
+	BinTraceRecord *ring = &rings[call.thread * BINTRACE_RINGSIZE];
+	int slot = 0;
+
+	do
+	{
+		BinTraceRecord &r = ring[t.nRecords % BINTRACE_RINGSIZE];
+		int n = min(call.nSlots - slot, BINTRACE_SLOTS);
+
+		r.start = call.start - startTime;  r.duration = duration;
+		r.seq = call.seq;  r.funcID = call.funcID;
+		r.type = slot == 0 ? BINTRACE_CALL : BINTRACE_MORE;
+		r.nSlots = n;  r.nIn = call.nIn;  r.level = call.level;
+		memcpy(r.names, &call.names[slot], sizeof(unsigned short) * n);
+		memcpy(r.values, &call.values[slot], sizeof(unsigned long long) * n);
+		slot += n;
+		t.nRecords++;
+	} while(slot < call.nSlots);
+}
+
+
+void BinaryTracer::addDisplay(BinTraceCall &call, unsigned short name,
+	Display *dpy)
+{
+	unsigned short dpyName = 0;
+
+	if(dpy)
+	{
+		int i;
+		for(i = 0; i < MAXDISPLAYS && displays[i]; i++)
+			if(displays[i] == dpy) break;
+		if(i < MAXDISPLAYS && displays[i] == dpy) dpyName = displayNames[i];
+		else
+		{
+			dpyName = registerName(DisplayString(dpy), BINTRACE_DPYNAME);
+			CriticalSection::SafeLock l(mutex);
+			for(i = 0; i < MAXDISPLAYS; i++)
+			{
+				if(!displays[i])
+				{
+					displayNames[i] = dpyName;  displays[i] = dpy;
+					break;
+				}
+			}
+		}
+	}
+	add(call, name, (unsigned long long)(unsigned long)dpy);
+	add(call, 0, dpyName);
+}
+
+
+void BinaryTracer::addString(BinTraceCall &call, unsigned short name,
+	const char *str)
+{
+	unsigned long long value[2] = { 0, 0 };
+
+	if(str) memcpy(value, str, min(strlen(str), sizeof(value)));
+	else name |= BINTRACE_NULL;
+	add(call, name, value[0]);
+	add(call, 0, value[1]);
+}
+
+
+void BinaryTracer::addList(BinTraceCall &call, unsigned short name,
+	const int *list, bool glx13)
+{
+	int n = 0;
+
+	add(call, name, (unsigned long long)(unsigned long)list);
+	if(list)
+	{
+		// Count the entries, including the terminating None, the same way that
+		// the PRARGAL11() and PRARGAL13() macros walk the list.
+		for(n = 0; n < BINTRACE_MAXLIST && list[n] != None; n++)
+		{
+			if(glx13) n++;
+			else if(list[n] != GLX_USE_GL && list[n] != GLX_DOUBLEBUFFER
+				&& list[n] != GLX_STEREO && list[n] != GLX_RGBA)
+				n++;
+		}
+		if(n < BINTRACE_MAXLIST) n++;
+		if(n > BINTRACE_MAXLIST) n = BINTRACE_MAXLIST;
+	}
+	add(call, 0, n);
+	for(int i = 0; i < n; i += 2)
+		add(call, 0, (unsigned long long)(unsigned int)list[i]
+			| (i + 1 < n ? (unsigned long long)(unsigned int)list[i + 1] << 32 : 0));
+}
@@ -0,0 +1,192 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __BINARYTRACE_H__
+#define __BINARYTRACE_H__
+
+#include <stdlib.h>
+#include <X11/Xlib.h>
+#include "Mutex.h"
+
+
+// Binary tracing.  If the VGL_TRACEFILE environment variable is set to a file
+// name, then each call to an interposed function is recorded, along with its
+// raw arguments, return value, thread, start time, and duration, as one or
+// more fixed-size records in a ring buffer belonging to the calling thread.
+// The ring buffers live in a memory-mapped file, so recording a call costs
+// only a few stores, and the most recent calls survive a crash.  Function and
+// argument names are stored once in a name table at the beginning of the
+// file.  vgltrace decodes the file into the same text format that VGL_TRACE
+// produces.
+
+#define BINTRACE_ID  "VGLTRC01"
+
+#define BINTRACE_MAXNAMES  4096
+#define BINTRACE_MAXTHREADS  64
+#define BINTRACE_RINGSIZE  8192  // Records per thread
+#define BINTRACE_SLOTS  10  // Argument slots per record
+#define BINTRACE_MAXSLOTS  64  // Argument slots per call
+#define BINTRACE_MAXLIST  40  // Attribute list entries per argument
+
+// Flag (in the name ID of an argument slot) indicating that a string argument
+// was NULL
+#define BINTRACE_NULL  0x8000
+
+// Record types
+enum { BINTRACE_CALL = 1, BINTRACE_MORE };
+
+// Name types.  Each argument name has the type of the PRARG*() macro that
+// recorded it.  The value of a D, S, V, C, A, or B argument occupies more than
+// one slot.  D = display (pointer, display name ID), S = string (first 16
+// characters), I = integer, X = hex integer, Y = integer and hex integer,
+// F = double, V = visual (pointer, visual ID), C = FB config (pointer, FB
+// config ID), A/B = GLX 1.1/1.3 attribute list (pointer, number of entries,
+// entries packed two per slot)
+enum { BINTRACE_FUNC = 'f', BINTRACE_DPYNAME = 'n' };
+
+typedef struct
+{
+	char id[8];
+	unsigned int headerSize, nameSize, threadSize, recordSize;
+	unsigned int maxNames, maxThreads, ringSize, slots;
+	unsigned int nNames, nThreads;
+	int pid;
+	unsigned int reserved;
+	double startTime;
+} BinTraceHeader;
+
+typedef struct
+{
+	char type;
+	char name[63];
+} BinTraceName;
+
+typedef struct
+{
+	unsigned long long threadID;
+	unsigned long long nRecords;  // Total records written (not wrapped)
+	unsigned int nCalls;  // Calls opened so far
+	unsigned char reserved[44];
+} BinTraceThread;
+
+typedef struct
+{
+	double start, duration;  // Seconds since the trace started
+	unsigned int seq;  // Order in which the call started, within the thread
+	unsigned short funcID;
+	unsigned char type;  // BINTRACE_CALL or BINTRACE_MORE
+	unsigned char nSlots;  // Argument slots used in this record
+	unsigned char nIn;  // Argument slots recorded before the call
+	unsigned char level;  // Nesting level
+	unsigned char reserved[2];
+	unsigned short names[BINTRACE_SLOTS];
+	unsigned long long values[BINTRACE_SLOTS];
+} BinTraceRecord;
+
+
+namespace vglserver
+{
+	// The arguments of a call in progress.  This is allocated by OPENTRACE()
+	// and freed when the interposed function returns.
+
+	typedef struct
+	{
+		int thread;  // -1 if the call isn't being recorded
+		unsigned int seq;
+		double start;
+		unsigned short funcID;
+		unsigned char level, nIn;
+		int nSlots;
+		unsigned short names[BINTRACE_MAXSLOTS];
+		unsigned long long values[BINTRACE_MAXSLOTS];
+	} BinTraceCall;
+
+	// Owns the BinTraceCall structure of an interposed function.  The structure
+	// is allocated only if binary tracing is enabled.
+
+	class BinTraceCallPtr
+	{
+		public:
+
+			BinTraceCallPtr(void) : call(NULL) {}
+			~BinTraceCallPtr(void) { free(call); }
+
+			// Returns false if the structure could not be allocated, in which case
+			// the call is not recorded.
+			bool alloc(void)
+			{
+				if(!call) call = (BinTraceCall *)malloc(sizeof(BinTraceCall));
+				if(call) call->thread = -1;
+				return call != NULL;
+			}
+
+			bool isRecording(void) { return call && call->thread >= 0; }
+			BinTraceCall &operator*(void) { return *call; }
+			BinTraceCall *operator->(void) { return call; }
+
+		private:
+
+			BinTraceCall *call;
+	};
+
+	class BinaryTracer
+	{
+		public:
+
+			static BinaryTracer *getInstance(void);
+			bool isEnabled(void) { return enabled; }
+			unsigned short registerName(const char *name, char type);
+			void open(BinTraceCall &call, unsigned short funcID, long level);
+			void close(BinTraceCall &call, double duration);
+
+			static void add(BinTraceCall &call, unsigned short name,
+				unsigned long long value)
+			{
+				if(call.nSlots < BINTRACE_MAXSLOTS)
+				{
+					call.names[call.nSlots] = name;
+					call.values[call.nSlots++] = value;
+				}
+			}
+			void addDisplay(BinTraceCall &call, unsigned short name,
+				Display *dpy);
+			static void addString(BinTraceCall &call, unsigned short name,
+				const char *str);
+			static void addList(BinTraceCall &call, unsigned short name,
+				const int *list, bool glx13);
+
+		private:
+
+			BinaryTracer(void);
+			~BinaryTracer(void) {}
+			int newThread(void);
+
+			static const int MAXDISPLAYS = 16;
+			static BinaryTracer *instance;
+			static vglutil::CriticalSection instanceMutex;
+			vglutil::CriticalSection mutex;
+			bool enabled;
+			unsigned char *map;  size_t mapSize;
+			BinTraceHeader *header;
+			BinTraceName *names;
+			BinTraceThread *threads;
+			BinTraceRecord *rings;
+			double startTime;
+			// Name IDs of the display names that have been recorded so far
+			Display * volatile displays[MAXDISPLAYS];
+			unsigned short displayNames[MAXDISPLAYS];
+	};
+}
+
+#define bintrace  (*(vglserver::BinaryTracer::getInstance()))
+
+#endif  // __BINARYTRACE_H__
@@ -0,0 +1,243 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include "FrameCapture.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Error.h"
+#include "Log.h"
+#include "vglutil.h"
+
+using namespace vglutil;
+using namespace vglcommon;
+using namespace vglserver;
+
+
+// The file is extended in increments of at least this many bytes, so that it
+// doesn't have to be remapped for every frame.
+#define MINGROWTH  (64 * 1024 * 1024)
+
+
+FrameCapture *FrameCapture::instance = NULL;
+CriticalSection FrameCapture::instanceMutex;
+
+
+FrameCapture *FrameCapture::getInstance(void)
+{
+	if(instance == NULL)
+	{
+		CriticalSection::SafeLock l(instanceMutex);
+		if(instance == NULL) instance = new FrameCapture;
+	}
+	return instance;
+}
+
+
+FrameCapture::FrameCapture(void) : enabled(false), fd(-1), map(NULL),
+	mapSize(0), offset(0), startTime(0.0), nWindows(0)
+{
+	char *env = getenv("VGL_CAPTURE");
+
+	if(!env || strlen(env) < 1) return;
+	if((fd = open(env, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1)
+	{
+		vglout.println("[VGL] WARNING: Could not open frame capture file %s",
+			env);
+		return;
+	}
+	enabled = true;
+	if(!reserve(sizeof(CaptureHeader))) return;
+
+	CaptureHeader *header = (CaptureHeader *)map;
+	memcpy(header->id, CAPTURE_ID, 8);
+	header->headerSize = sizeof(CaptureHeader);
+	header->recordSize = sizeof(CaptureRecord);
+	offset = sizeof(CaptureHeader);
+	startTime = GetTime();
+	atexit(closeAtExit);
+}
+
+
+void FrameCapture::closeAtExit(void)
+{
+	if(instance) instance->close();
+}
+
+
+// Ensure that at least size bytes are mapped beyond the current offset
+
+bool FrameCapture::reserve(size_t size)
+{
+	if(offset + size <= mapSize) return true;
+
+	size_t newSize = max(mapSize * 2, offset + size + MINGROWTH);
+	if(map) munmap(map, mapSize);
+	map = NULL;  mapSize = 0;
+	if(ftruncate(fd, newSize) == -1
+		|| (map = (unsigned char *)mmap(NULL, newSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		vglout.println("[VGL] WARNING: Could not extend frame capture file (%s)",
+			strerror(errno));
+		vglout.println("[VGL]    Frame capture disabled.");
+		map = NULL;
+		::close(fd);  fd = -1;
+		enabled = false;
+		return false;
+	}
+	mapSize = newSize;
+	return true;
+}
+
+
+bool FrameCapture::isDuplicate(Frame &f, int index)
+{
+	CaptureRecord *last = (CaptureRecord *)&map[lastRecord[index]];
+
+	if(last->width != f.hdr.width || last->height != f.hdr.height
+		|| last->format != f.pf->id || last->flags != (f.flags & FRAME_BOTTOMUP))
+		return false;
+
+	int rowSize = f.hdr.width * f.pf->size;
+	unsigned char *src = f.bits, *dst = &map[last->dataOffset];
+	for(int i = 0; i < f.hdr.height; i++, src += f.pitch, dst += rowSize)
+		if(memcmp(src, dst, rowSize)) return false;
+	return true;
+}
+
+
+void FrameCapture::write(Frame &f, unsigned int winID)
+{
+	if(!enabled || !f.bits) return;
+	CriticalSection::SafeLock l(mutex);
+	if(!enabled) return;
+
+	int rowSize = f.hdr.width * f.pf->size, index;
+	size_t size = (size_t)rowSize * (size_t)f.hdr.height;
+
+	for(index = 0; index < nWindows; index++)
+		if(winIDs[index] == winID) break;
+	bool duplicate = index < nWindows && isDuplicate(f, index);
+
+	if(!reserve(sizeof(CaptureRecord) + (duplicate ? 0 : size))) return;
+
+	CaptureRecord *rec = (CaptureRecord *)&map[offset];
+	rec->time = GetTime() - startTime;
+	rec->winID = winID;
+	rec->width = f.hdr.width;  rec->height = f.hdr.height;
+	rec->format = f.pf->id;  rec->flags = f.flags & FRAME_BOTTOMUP;
+	rec->reserved[0] = rec->reserved[1] = 0;
+	if(duplicate)
+	{
+		rec->dataOffset = ((CaptureRecord *)&map[lastRecord[index]])->dataOffset;
+		rec->size = 0;
+	}
+	else
+	{
+		rec->dataOffset = offset + sizeof(CaptureRecord);
+		rec->size = (unsigned int)size;
+		unsigned char *src = f.bits, *dst = &map[rec->dataOffset];
+		for(int i = 0; i < f.hdr.height; i++, src += f.pitch, dst += rowSize)
+			memcpy(dst, src, rowSize);
+	}
+
+	if(index == nWindows && nWindows < MAXWINDOWS)
+	{
+		winIDs[index] = winID;  nWindows++;
+	}
+	if(index < nWindows) lastRecord[index] = offset;
+	offset += sizeof(CaptureRecord) + rec->size;
+}
+
+
+void FrameCapture::close(void)
+{
+	CriticalSection::SafeLock l(mutex);
+
+	if(!enabled) return;
+	enabled = false;
+	if(map) munmap(map, mapSize);
+	map = NULL;  mapSize = 0;
+	if(ftruncate(fd, offset) == -1)
+		vglout.println("[VGL] WARNING: Could not truncate frame capture file");
+	::close(fd);  fd = -1;
+}
+
+
+CaptureReader::CaptureReader(const char *fileName) : fd(-1), map(NULL),
+	mapSize(0), offset(0)
+{
+	struct stat sb;
+
+	if(!fileName) THROW("Invalid argument");
+	try
+	{
+		if((fd = open(fileName, O_RDONLY)) == -1) THROW_UNIX();
+		if(fstat(fd, &sb) == -1) THROW_UNIX();
+		mapSize = sb.st_size;
+		if(mapSize < sizeof(CaptureHeader))
+			THROW("Frame capture file is too small");
+		if((map = (unsigned char *)mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd,
+			0)) == MAP_FAILED)
+		{
+			map = NULL;  THROW_UNIX();
+		}
+
+		CaptureHeader *header = (CaptureHeader *)map;
+		if(memcmp(header->id, CAPTURE_ID, 8)
+			|| header->recordSize != sizeof(CaptureRecord))
+			THROW("Invalid frame capture file");
+		offset = header->headerSize;
+	}
+	catch(...)
+	{
+		if(map) munmap(map, mapSize);
+		if(fd != -1) ::close(fd);
+		throw;
+	}
+}
+
+
+CaptureReader::~CaptureReader(void)
+{
+	if(map) munmap(map, mapSize);
+	if(fd != -1) ::close(fd);
+}
+
+
+CaptureRecord *CaptureReader::next(unsigned char **bits)
+{
+	if(offset + sizeof(CaptureRecord) > mapSize) return NULL;
+
+	CaptureRecord *rec = (CaptureRecord *)&map[offset];
+	PF *pf = pf_get(rec->format);
+	size_t size = (size_t)rec->width * (size_t)pf->size * (size_t)rec->height;
+
+	if(rec->dataOffset + size > mapSize
+		|| offset + sizeof(CaptureRecord) + rec->size > mapSize
+		|| pf->id == PF_COMP)
+		THROW("Frame capture file is truncated or corrupt");
+	if(bits) *bits = &map[rec->dataOffset];
+	offset += sizeof(CaptureRecord) + rec->size;
+	return rec;
+}
+
+
+void CaptureReader::rewind(void)
+{
+	offset = ((CaptureHeader *)map)->headerSize;
+}
@@ -0,0 +1,108 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __FRAMECAPTURE_H__
+#define __FRAMECAPTURE_H__
+
+#include <sys/types.h>
+#include "Frame.h"
+#include "Mutex.h"
+
+
+// Frame capture.  If the VGL_CAPTURE environment variable is set to a file
+// name, then every frame that the VirtualGL Faker reads back is appended to
+// that file, along with its size, pixel format, window ID, and timestamp.  The
+// file is written through a memory mapping.  A frame that is identical to the
+// previous frame captured from the same window is stored as a reference to the
+// previous frame's pixels, so static content costs only the record header.
+// vglreplay reads the file and feeds the frames through the VGL Transport.
+
+#define CAPTURE_ID  "VGLCAP01"
+
+typedef struct
+{
+	char id[8];
+	unsigned int headerSize, recordSize;
+} CaptureHeader;
+
+typedef struct
+{
+	double time;  // Seconds since the capture started
+	// Offset (from the beginning of the file) of the pixels, which are stored
+	// contiguously (pitch = width * pixel size) in the row order indicated by
+	// flags
+	unsigned long long dataOffset;
+	unsigned int winID;
+	unsigned int size;  // Bytes of pixel data following this record (0 if the
+	                    // frame refers to the pixels of a previous frame)
+	unsigned short width, height;
+	unsigned char format, flags;  // PF_* and FRAME_*
+	unsigned char reserved[2];
+} CaptureRecord;
+
+
+namespace vglserver
+{
+	class FrameCapture
+	{
+		public:
+
+			static FrameCapture *getInstance(void);
+			bool isEnabled(void) { return enabled; }
+			void write(vglcommon::Frame &f, unsigned int winID);
+			void close(void);
+
+		private:
+
+			FrameCapture(void);
+			~FrameCapture(void) {}
+			static void closeAtExit(void);
+			bool reserve(size_t size);
+			bool isDuplicate(vglcommon::Frame &f, int index);
+
+			static const int MAXWINDOWS = 64;
+			static FrameCapture *instance;
+			static vglutil::CriticalSection instanceMutex;
+			vglutil::CriticalSection mutex;
+			bool enabled;
+			int fd;
+			unsigned char *map;  size_t mapSize, offset;
+			double startTime;
+			// Most recent record captured from each window
+			unsigned int winIDs[MAXWINDOWS];  size_t lastRecord[MAXWINDOWS];
+			int nWindows;
+	};
+
+
+	class CaptureReader
+	{
+		public:
+
+			CaptureReader(const char *fileName);
+			~CaptureReader(void);
+			// Returns the next record, or NULL at the end of the file.  bits is set
+			// to the record's pixels, which remain valid until the reader is
+			// destroyed.
+			CaptureRecord *next(unsigned char **bits);
+			void rewind(void);
+
+		private:
+
+			int fd;
+			unsigned char *map;  size_t mapSize, offset;
+	};
+}
+
+
+#define framecapture  (*(vglserver::FrameCapture::getInstance()))
+
+#endif  // __FRAMECAPTURE_H__
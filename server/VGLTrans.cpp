@@ -13,10 +13,13 @@
 // wxWindows Library License for more details.
 
 #include "VGLTrans.h"
+#include "TileEncoder.h"
 #include "Timer.h"
 #include "fakerconfig.h"
 #include "vglutil.h"
 #include "Log.h"
+#include "FrameTrace.h"
+#include "fakerstats.h"
 #include <fcntl.h>
 #include <sys/stat.h>
 
@@ -73,7 +76,7 @@ using namespace vglserver;
 }
 
 
-void VGLTrans::sendHeader(rrframeheader h, bool eof)
+void VGLTrans::sendHeader(rrframeheader h, bool eof, bool halfSize)
 {
 	if(version.major == 0 && version.minor == 0)
 	{
@@ -101,6 +104,15 @@ void VGLTrans::sendHeader(rrframeheader h, bool eof)
 				v = version;
 				v.major = RR_MAJOR_VERSION;  v.minor = RR_MINOR_VERSION;
 				send((char *)&v, sizeof_rrversion);
+				if(versionAtLeast(2, 2))
+				{
+					unsigned char buf[4];
+					recv((char *)buf, 4);
+					size_t clientKB = (size_t)buf[0] | ((size_t)buf[1] << 8)
+						| ((size_t)buf[2] << 16) | ((size_t)buf[3] << 24);
+					tileCache.setBudget(min((size_t)fconfig.tilecache * 1048576,
+						clientKB * 1024));
+				}
 			}
 			if(fconfig.verbose)
 				vglout.println("[VGL] Client version: %d.%d", version.major,
@@ -110,7 +122,13 @@ void VGLTrans::sendHeader(rrframeheader h, bool eof)
 	if((version.major < 2 || (version.major == 2 && version.minor < 1))
 		&& h.compress != RRCOMP_JPEG)
 		THROW("This compression mode requires VirtualGL Client v2.1 or later");
-	if(eof) h.flags = RR_EOF;
+	if((version.major < 2 || (version.major == 2 && version.minor < 2))
+		&& (h.compress == RRCOMP_LOSSLESS || h.compress == RRCOMP_DELTA
+			|| h.compress == RRCOMP_COPYRECT || h.compress == RRCOMP_CACHEPUT
+			|| h.compress == RRCOMP_CACHEGET || h.compress == RRCOMP_SOLID
+			|| h.compress == RRCOMP_JPEGSLICES || h.compress == RRCOMP_FRAMEID))
+		THROW("This encoding requires VirtualGL Client v2.6.4 or later");
+	if(eof) h.flags = halfSize ? RR_EOF | RR_HALFSIZE : RR_EOF;
 	if(version.major == 1 && version.minor == 0)
 	{
 		rrframeheader_v1 h1;
@@ -137,16 +155,25 @@ void VGLTrans::sendHeader(rrframeheader h, bool eof)
 
 
 VGLTrans::VGLTrans(void) : nprocs(fconfig.np), socket(NULL), thread(NULL),
-	deadYet(false), dpynum(0)
+	deadYet(false), yuvEncoder(NULL), dpynum(0), lastQueued(NULL),
+	lastFingerprint(0), stored(NULL), nStored(0), maxStored(0), nextTile(0),
+	motionFrames(0), halfIndex(0)
 {
 	memset(&version, 0, sizeof(rrversion));
 	profTotal.setName("Total     ");
 }
 
 
+// When interactive mode is enabled, a frame that was sent at half size is
+// sent again at full size if no new frame arrives within this many seconds.
+#define REFRESH_DELAY  0.25
+
 void VGLTrans::run(void)
 {
-	Frame *lastf = NULL, *f = NULL;
+	// lastf is the previous frame as it was rendered, and lastSent is the
+	// previous frame as it was sent (which may be a half-size copy of lastf.)
+	Frame *lastf = NULL, *lastSent = NULL, *f = NULL;
+	bool refreshPending = false;
 	long bytes = 0;
 	Timer timer, sleepTimer;  double err = 0.;  bool first = true;
 	int i;
@@ -168,32 +195,106 @@ void VGLTrans::run(void)
 		while(!deadYet)
 		{
 			int np;
-			void *ftemp = NULL;
+			void *ftemp = NULL;  bool refresh = false;
 
-			q.get(&ftemp);  f = (Frame *)ftemp;  if(deadYet) break;
+			if(refreshPending)
+			{
+				q.timedGet(&ftemp, REFRESH_DELAY);
+				if(!ftemp && !deadYet)
+				{
+					// Motion has stopped, so send the last frame at full size.
+					ftemp = lastf;  refresh = true;
+				}
+			}
+			else q.get(&ftemp);
+			f = (Frame *)ftemp;  if(deadYet) break;
 			if(!f) THROW("Queue has been shut down");
-			ready.signal();
-			np = nprocs;  if(f->hdr.compress == RRCOMP_YUV) np = 1;
+			if(!refresh)
+			{
+				ready.signal();
+				FSTATS_ADD(queueDepth, -1);
+				frametrace.record("Queue", f->traceID, f->traceTime);
+			}
+			np = nprocs;
+			if(f->hdr.compress == RRCOMP_YUV)
+			{
+				// YUV frames are sent as a single image, so rather than dividing the
+				// frame into tiles, the YUV encoder divides it into bands of rows.
+				if(!yuvEncoder) NEWCHECK(yuvEncoder = new YUVEncoder(nprocs));
+				np = 1;
+			}
+			// sf is the frame as it will be sent.
+			Frame *sf = f;
+			refreshPending = false;
+			if(fconfig.interactive > 0 && !refresh
+				&& f->hdr.compress != RRCOMP_YUV && !f->stereo && f->pf->bpc == 8
+				&& versionAtLeast(2, 2))
+			{
+				// If a large part of the frame has changed in each of the last two
+				// frames, then the user is probably rotating or panning the scene, so
+				// send the frame at half size until the motion stops.
+				if(f->percentChanged(lastf) >= fconfig.interactive) motionFrames++;
+				else motionFrames = 0;
+				if(motionFrames >= 2)
+				{
+					halfIndex = (halfIndex + 1) % 2;
+					sf = &halfFrames[halfIndex];
+					sf->downsample(*f);
+					sf->traceID = f->traceID;
+					refreshPending = true;
+				}
+			}
+			else motionFrames = 0;
+			tileCache.newFrame();
+			if(frametrace.isEnabled() && versionAtLeast(2, 2))
+			{
+				sendFrameID(sf, f->traceID);
+				bytes += sizeof_rrframeheader + 4;
+			}
+			// The copy must be sent before any of the tiles, and the tiles are
+			// compared with the previous frame as it appears on the client after
+			// the copy.
+			Frame *ref = lastSent;
+			if(lastSent && sf->hdr.compress != RRCOMP_YUV && fconfig.interframe)
+			{
+				ref = sendScroll(sf, lastSent);
+				if(ref != lastSent) bytes += sizeof_rrframeheader + 4;
+			}
+			if(sf->hdr.compress != RRCOMP_YUV)
+			{
+				tiler.divide(*sf, fconfig.interframe ? ref : NULL, fconfig.tilesize,
+					fconfig.mintilesize, np);
+				initTiles(tiler.getCount());
+			}
 			if(np > 1)
 			{
 				for(i = 1; i < np; i++)
 				{
-					cthread[i]->checkError();  comp[i]->go(f, lastf);
+					cthread[i]->checkError();  comp[i]->go(sf, ref);
 				}
 			}
-			comp[0]->compressSend(f, lastf);
+			double statsStart = fstats_time();
+			comp[0]->compressSend(sf, ref);
 			bytes += comp[0]->bytes;
+			fstats_addstage(FSTATS_COMPRESS, statsStart);
+			statsStart = fstats_time();
+			double traceStart = frametrace.time();
 			if(np > 1)
 			{
 				for(i = 1; i < np; i++)
 				{
-					comp[i]->stop();  cthread[i]->checkError();  comp[i]->send();
+					comp[i]->stop();  cthread[i]->checkError();  sendTiles();
 					bytes += comp[i]->bytes;
 				}
 			}
-			sendHeader(f->hdr, true);
-
-			profTotal.endFrame(f->hdr.width * f->hdr.height, bytes, 1);
+			sendHeader(sf->hdr, true, sf != f);
+			frametrace.record("Send", f->traceID, traceStart);
+			fstats_addstage(FSTATS_SEND, statsStart);
+			FSTATS_ADD(framesSent, 1);
+			FSTATS_ADD(pixelsSent, sf->hdr.width * sf->hdr.height);
+			FSTATS_ADD(bytesSent, bytes);
+
+			profTotal.endFrame(sf->hdr.width * sf->hdr.height, bytes, 1);
 			bytes = 0;
 			profTotal.startFrame();
 
@@ -221,8 +322,8 @@ void VGLTrans::run(void)
 				timer.start();
 			}
 
-			if(lastf) lastf->signalComplete();
-			lastf = f;
+			if(lastf && lastf != f) lastf->signalComplete();
+			lastf = f;  lastSent = sf;
 		}
 
 		for(i = 0; i < nprocs; i++) comp[i]->shutdown();
@@ -244,6 +345,55 @@ void VGLTrans::run(void)
 }
 
 
+// Send f's trace ID in an RRCOMP_FRAMEID tile, so the client can reuse it
+
+void VGLTrans::sendFrameID(Frame *f, unsigned int traceID)
+{
+	rrframeheader h = f->hdr;
+	h.x = h.y = 0;  h.width = h.framew;  h.height = h.frameh;
+	h.compress = RRCOMP_FRAMEID;  h.flags = 0;  h.size = 4;
+	unsigned char data[4] = {
+		(unsigned char)(traceID & 0xFF), (unsigned char)((traceID >> 8) & 0xFF),
+		(unsigned char)((traceID >> 16) & 0xFF), (unsigned char)(traceID >> 24)
+	};
+	sendHeader(h);
+	send((char *)data, 4);
+}
+
+
+// If part of f is a scrolled copy of part of lastf, then tell the client to
+// copy that part of its frame buffer, and return a copy of lastf to which the
+// same copy has been applied.  Otherwise, return lastf.
+
+Frame *VGLTrans::sendScroll(Frame *f, Frame *lastf)
+{
+	int srcX, srcY, dstX, dstY, width, height;
+
+	if(!fconfig.scroll || !versionAtLeast(2, 2) || f->stereo
+		|| !scrollDetector.detect(*f, *lastf, srcX, srcY, dstX, dstY, width,
+			height))
+		return lastf;
+
+	rrframeheader h = f->hdr;
+	h.x = dstX;  h.y = dstY;  h.width = width;  h.height = height;
+	h.compress = RRCOMP_COPYRECT;  h.flags = 0;  h.size = 4;
+	unsigned char data[4] = {
+		(unsigned char)(srcX & 0xFF), (unsigned char)(srcX >> 8),
+		(unsigned char)(srcY & 0xFF), (unsigned char)(srcY >> 8)
+	};
+	sendHeader(h);
+	send((char *)data, 4);
+
+	rrframeheader refHdr = lastf->hdr;
+	scrollRef.init(refHdr, lastf->pf->id, lastf->flags);
+	for(int i = 0; i < lastf->hdr.height; i++)
+		memcpy(&scrollRef.bits[scrollRef.pitch * i], &lastf->bits[lastf->pitch * i],
+			lastf->hdr.width * lastf->pf->size);
+	scrollRef.copyRect(srcX, srcY, dstX, dstY, width, height);
+	return &scrollRef;
+}
+
+
 Frame *VGLTrans::getFrame(int width, int height, int pixelFormat, int flags,
 	bool stereo)
 {
@@ -294,7 +444,39 @@ void VGLTrans::sendFrame(Frame *f)
 {
 	if(thread) thread->checkError();
 	f->hdr.dpynum = dpynum;
-	q.spoil((void *)f, _VGLTrans_spoilfct);
+
+	// Applications that swap buffers at a fixed rate often render the same
+	// frame over and over.  Such frames are discarded before they are queued,
+	// so they are never compared tile by tile, compressed, or sent.  Only the
+	// application thread (which calls getFrame() and sendFrame()) writes to the
+	// frames in the pool, and the last frame that was queued is not returned by
+	// getFrame() until the transport thread has received a newer frame, so the
+	// last frame can be safely compared with f.  This doesn't depend on
+	// interframe comparison, since the client already displays the pixels of
+	// a discarded frame.
+	if(fconfig.dedup)
+	{
+		unsigned long long fp = f->fingerprint();
+		if(lastQueued && lastQueued != f && fp == lastFingerprint
+			&& f->hdr.compress == lastQueued->hdr.compress
+			&& f->stereo == lastQueued->stereo
+			&& f->tileEquals(lastQueued, 0, 0, f->hdr.width, f->hdr.height))
+		{
+			// synchronize() waits for each frame to be dequeued.
+			ready.signal();
+			f->signalComplete();
+			profTotal.incSpoiled(1);
+			FSTATS_ADD(framesSpoiled, 1);
+			return;
+		}
+		lastFingerprint = fp;
+	}
+	lastQueued = f;
+
+	int spoiled = q.spoil((void *)f, _VGLTrans_spoilfct);
+	profTotal.incSpoiled(spoiled);
+	FSTATS_ADD(framesSpoiled, spoiled);
+	FSTATS_ADD(queueDepth, 1 - spoiled);
 }
 
 
@@ -303,55 +485,86 @@ void VGLTrans::Compressor::compressSend(Frame *f, Frame *lastf)
 	CompressedFrame cframe;
 
 	if(!f) return;
-	int tilesizex = fconfig.tilesize ? fconfig.tilesize : f->hdr.width;
-	int tilesizey = fconfig.tilesize ? fconfig.tilesize : f->hdr.height;
-	int i, j, n = 0;
+	FrameTraceSpan traceSpan("Compress", f->traceID);
 
 	if(f->hdr.compress == RRCOMP_YUV)
 	{
 		profComp.startFrame();
-		cframe = *f;
+		cframe.compressYUV(*f, parent->yuvEncoder);
 		profComp.endFrame(f->hdr.framew * f->hdr.frameh, 0, 1);
 		parent->sendHeader(cframe.hdr);
 		parent->send((char *)cframe.bits, cframe.hdr.size);
 		return;
 	}
 
+	// Delta, lossless, solid, and sliced tiles in a JPEG or RGB frame, as well
+	// as tile caching, require a client that supports protocol v2.2.
+	bool v22 = parent->versionAtLeast(2, 2);
+	TileEncoder encoder(fconfig.interframe && v22, fconfig.adaptive && v22,
+		v22 ? fconfig.slices : 1, fconfig.roiqual, &parent->tileCache);
+
+	// The tiles were chosen by VGLTrans::run(), which has already omitted the
+	// tiles that are unchanged in lastf and sorted the others in the order in
+	// which they should be sent.
+	Tiler &tiler = parent->tiler;
+	if(myRank == 0) profComp.incSkipped(tiler.getSkipped());
+
 	bytes = 0;
-	for(i = 0; i < f->hdr.height; i += tilesizey)
+	for(int t = 0; t < tiler.getCount(); t++)
 	{
-		int height = tilesizey, y = i;
-
-		if(f->hdr.height - i < (3 * tilesizey / 2))
+		if(tiler[t].rank != myRank) continue;
+		// The first thread sends its tiles directly if all of the tiles before
+		// them have been sent.  Otherwise, the tiles are stored until the first
+		// thread or VGLTrans::run() can send them in order.
+		if(myRank == 0) parent->sendTiles();
+		bool direct = (myRank == 0 && parent->nextTile == t);
+		CompressedFrame *ctile = NULL;
+		if(direct) ctile = &cframe;
+		else { NEWCHECK(ctile = new CompressedFrame()); }
+		TileEncoder::Result result;
+		profComp.startFrame();
+		try
 		{
-			height = f->hdr.height - i;  i += tilesizey;
+			encoder.encode(*f, lastf, tiler[t], *ctile, result);
 		}
-		for(j = 0; j < f->hdr.width; j += tilesizex, n++)
+		catch(...)
+		{
+			if(!direct) delete ctile;
+			throw;
+		}
+		double frames = (double)(tiler[t].width * tiler[t].height) /
+			(double)(f->hdr.framew * f->hdr.frameh);
+		profComp.endFrame(tiler[t].width * tiler[t].height, 0, frames);
+
+		StoredTile st;
+		st.cf = ctile;  st.compress = 0;
+		st.hdr = f->hdr;
+		st.hdr.x = tiler[t].x;  st.hdr.y = tiler[t].y;
+		st.hdr.width = tiler[t].width;  st.hdr.height = tiler[t].height;
+		if(result.getSlot >= 0)
+		{
+			// The client has cached a tile with the same pixels.
+			if(!direct) delete ctile;
+			st.cf = NULL;  st.compress = RRCOMP_CACHEGET;
+			st.slot = result.getSlot;  st.nReleased = 0;
+		}
+		else
 		{
-			int width = tilesizex, x = j;
-
-			if(f->hdr.width - j < (3 * tilesizex / 2))
-			{
-				width = f->hdr.width - j;  j += tilesizex;
-			}
-			if(n % nprocs != myRank) continue;
-			if(fconfig.interframe)
-			{
-				if(f->tileEquals(lastf, x, y, width, height)) continue;
-			}
-			Frame *tile = f->getTile(x, y, width, height);
-			CompressedFrame *ctile = NULL;
-			if(myRank > 0) { NEWCHECK(ctile = new CompressedFrame()); }
-			else ctile = &cframe;
-			profComp.startFrame();
-			*ctile = *tile;
-			double frames = (double)(tile->hdr.width * tile->hdr.height) /
-				(double)(tile->hdr.framew * tile->hdr.frameh);
-			profComp.endFrame(tile->hdr.width * tile->hdr.height, 0, frames);
 			bytes += ctile->hdr.size;
 			if(ctile->stereo) bytes += ctile->rhdr.size;
-			delete tile;
-			if(myRank == 0)
+			if(result.putSlot >= 0)
+			{
+				st.compress = RRCOMP_CACHEPUT;  st.slot = result.putSlot;
+				st.nReleased = result.nReleased;
+				memcpy(st.released, result.released,
+					sizeof(unsigned int) * result.nReleased);
+			}
+		}
+		if(st.compress) bytes += sizeof_rrframeheader + 4 * (st.nReleased + 1);
+		if(direct)
+		{
+			st.cf = NULL;
+			if(result.getSlot < 0)
 			{
 				parent->sendHeader(ctile->hdr);
 				parent->send((char *)ctile->bits, ctile->hdr.size);
@@ -361,12 +574,12 @@ void VGLTrans::Compressor::compressSend(Frame *f, Frame *lastf)
 					parent->send((char *)ctile->rbits, ctile->rhdr.size);
 				}
 			}
-			else
-			{
-				store(ctile);
-			}
+			parent->sendTile(st);
+			parent->nextTile++;
 		}
+		else parent->storeTile(t, st);
 	}
+	if(myRank == 0) parent->sendTiles();
 }
 
 
@@ -465,20 +678,109 @@ void VGLTrans::connect(char *displayName, unsigned short port)
 }
 
 
-void VGLTrans::Compressor::send(void)
+void VGLTrans::connectNull(void)
+{
+	version.major = RR_MAJOR_VERSION;  version.minor = RR_MINOR_VERSION;
+	tileCache.setBudget((size_t)fconfig.tilecache * 1048576);
+	NEWCHECK(thread = new Thread(this));
+	thread->start();
+}
+
+
+// Discard the tiles of the previous frame (if an error prevented them from
+// being sent) and prepare to receive the tiles of a new frame
+
+void VGLTrans::initTiles(int nTiles)
+{
+	CriticalSection::SafeLock l(storeMutex);
+
+	for(int i = 0; i < nStored; i++)
+	{
+		delete stored[i].cf;  stored[i].cf = NULL;
+	}
+	if(nTiles > maxStored)
+	{
+		StoredTile *newStored =
+			(StoredTile *)realloc(stored, sizeof(StoredTile) * nTiles);
+		if(!newStored) THROW("Memory allocation error");
+		stored = newStored;  maxStored = nTiles;
+	}
+	for(int i = 0; i < nTiles; i++)
+	{
+		stored[i].cf = NULL;  stored[i].ready = false;
+	}
+	nStored = nTiles;  nextTile = 0;
+}
+
+
+// Called by the compression threads to store tile t of the current frame
+
+void VGLTrans::storeTile(int t, StoredTile &st)
 {
-	for(int i = 0; i < storedFrames; i++)
+	CriticalSection::SafeLock l(storeMutex);
+
+	if(t < 0 || t >= nStored) THROW("Invalid argument");
+	stored[t] = st;
+	stored[t].ready = true;
+}
+
+
+// Send a stored tile, along with its tile cache command
+
+void VGLTrans::sendTile(StoredTile &st)
+{
+	CompressedFrame *cf = st.cf;
+	if(cf)
 	{
-		CompressedFrame *cf = cframes[i];
-		ERRIFNOT(cf);
-		parent->sendHeader(cf->hdr);
-		parent->send((char *)cf->bits, cf->hdr.size);
+		sendHeader(cf->hdr);
+		send((char *)cf->bits, cf->hdr.size);
 		if(cf->stereo && cf->rbits)
 		{
-			parent->sendHeader(cf->rhdr);
-			parent->send((char *)cf->rbits, cf->rhdr.size);
+			sendHeader(cf->rhdr);
+			send((char *)cf->rbits, cf->rhdr.size);
 		}
-		delete cf;
+		delete cf;  st.cf = NULL;
+	}
+	if(st.compress)
+		sendCacheCommand(st.hdr, st.compress, st.slot, st.released,
+			st.nReleased);
+}
+
+
+// Send the stored tiles that are next in order, stopping at the first tile
+// that has not been compressed yet
+
+void VGLTrans::sendTiles(void)
+{
+	while(nextTile < nStored)
+	{
+		StoredTile *st;
+		{
+			CriticalSection::SafeLock l(storeMutex);
+			if(!stored[nextTile].ready) return;
+			st = &stored[nextTile];
+		}
+		// The compression threads don't modify a tile after storing it, and
+		// only this thread reallocates the array.
+		sendTile(*st);
+		nextTile++;
+	}
+}
+
+
+void VGLTrans::sendCacheCommand(rrframeheader h, int compress, int slot,
+	unsigned int *released, int nReleased)
+{
+	unsigned char buf[4 * (TILECACHE_MAXRELEASE + 1)];
+
+	h.compress = compress;
+	h.size = 4 * (nReleased + 1);
+	for(int i = 0; i <= nReleased; i++)
+	{
+		unsigned int value = i ? released[i - 1] : slot;
+		buf[i * 4] = value & 0xFF;  buf[i * 4 + 1] = (value >> 8) & 0xFF;
+		buf[i * 4 + 2] = (value >> 16) & 0xFF;  buf[i * 4 + 3] = value >> 24;
 	}
-	storedFrames = 0;
+	sendHeader(h);
+	send((char *)buf, h.size);
 }
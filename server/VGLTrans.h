@@ -19,6 +19,8 @@
 #include "Thread.h"
 #include "rr.h"
 #include "Frame.h"
+#include "TileCache.h"
+#include "Tiler.h"
 #include "GenericQ.h"
 #include "Profiler.h"
 
@@ -36,6 +38,8 @@ namespace vglserver
 				deadYet = true;  q.release();
 				if(thread) { thread->stop();  delete thread;  thread = NULL; }
 				delete socket;  socket = NULL;
+				delete yuvEncoder;  yuvEncoder = NULL;
+				initTiles(0);  free(stored);  stored = NULL;
 			}
 
 			vglcommon::Frame *getFrame(int, int, int, int, bool stereo);
@@ -43,16 +47,47 @@ namespace vglserver
 			void synchronize(void);
 			void sendFrame(vglcommon::Frame *);
 			void run(void);
-			void sendHeader(rrframeheader h, bool eof = false);
+			void sendHeader(rrframeheader h, bool eof = false,
+				bool halfSize = false);
 			void send(char *, int);
 			void save(char *, int);
 			void recv(char *, int);
 			void connect(char *, unsigned short);
+			// Compress frames but discard them rather than sending them to a client
+			// (for benchmarking)
+			void connectNull(void);
 
 			int nprocs;
 
 		private:
 
+			bool versionAtLeast(int major, int minor)
+			{
+				return version.major > major
+					|| (version.major == major && version.minor >= minor);
+			}
+			void sendFrameID(vglcommon::Frame *f, unsigned int traceID);
+			vglcommon::Frame *sendScroll(vglcommon::Frame *f,
+				vglcommon::Frame *lastf);
+			void sendCacheCommand(rrframeheader h, int compress, int slot,
+				unsigned int *released, int nReleased);
+
+			// A compressed tile, along with the tile cache command (if any) that
+			// follows it
+			typedef struct
+			{
+				vglcommon::CompressedFrame *cf;  // NULL if only a command is sent
+				rrframeheader hdr;
+				int compress, slot, nReleased;
+				unsigned int released[TILECACHE_MAXRELEASE];
+				bool ready;
+			} StoredTile;
+
+			void initTiles(int nTiles);
+			void storeTile(int t, StoredTile &st);
+			void sendTile(StoredTile &st);
+			void sendTiles(void);
+
 			vglutil::Socket *socket;
 			static const int NFRAMES = 4;
 			vglutil::CriticalSection mutex;
@@ -61,16 +96,37 @@ namespace vglserver
 			vglutil::GenericQ q;
 			vglutil::Thread *thread;  bool deadYet;
 			vglcommon::Profiler profTotal;
+			vglcommon::YUVEncoder *yuvEncoder;
 			int dpynum;
+			// The last frame that was queued, and its fingerprint
+			vglcommon::Frame *lastQueued;  unsigned long long lastFingerprint;
 			rrversion version;
+			vglcommon::ScrollDetector scrollDetector;
+			// The previous frame, with the most recent scroll applied to it
+			vglcommon::Frame scrollRef;
+			// Digests of the tiles in the client's tile cache
+			vglcommon::TileCache tileCache;
+			// The tiles of the frame being compressed
+			vglcommon::Tiler tiler;
+			// The tiles are sent in the order chosen by the tiler, regardless of
+			// which thread compressed them.  Tiles that cannot be sent yet, because
+			// a more important tile is still being compressed, are stored here
+			// until the tiles before them have been sent.  nextTile is only
+			// accessed by the VGLTrans thread.
+			StoredTile *stored;  int nStored, maxStored, nextTile;
+			vglutil::CriticalSection storeMutex;
+			// Interactive mode (see VGL_INTERACTIVE):  the number of consecutive
+			// frames in which a large part of the frame changed, and the half-size
+			// copies of the current and previous frames
+			int motionFrames;
+			vglcommon::Frame halfFrames[2];  int halfIndex;
 
 		class Compressor : public vglutil::Runnable
 		{
 			public:
 
-				Compressor(int myRank_, VGLTrans *parent_) : bytes(0),
-					storedFrames(0), cframes(NULL), frame(NULL), lastFrame(NULL),
-					myRank(myRank_), deadYet(false), parent(parent_)
+				Compressor(int myRank_, VGLTrans *parent_) : bytes(0), frame(NULL),
+					lastFrame(NULL), myRank(myRank_), deadYet(false), parent(parent_)
 				{
 					if(parent) nprocs = parent->nprocs;
 					ready.wait();  complete.wait();
@@ -82,7 +138,6 @@ namespace vglserver
 				virtual ~Compressor(void)
 				{
 					shutdown();
-					free(cframes);  cframes = NULL;
 				}
 
 				void run(void)
@@ -116,22 +171,11 @@ namespace vglserver
 				void shutdown(void) { deadYet = true;  ready.signal(); }
 				void compressSend(vglcommon::Frame *frame,
 					vglcommon::Frame *lastFrame);
-				void send(void);
 
 				long bytes;
 
 			private:
 
-				void store(vglcommon::CompressedFrame *cf)
-				{
-					storedFrames++;
-					if(!(cframes = (vglcommon::CompressedFrame **)realloc(cframes,
-						sizeof(vglcommon::CompressedFrame *) * storedFrames)))
-						THROW("Memory allocation error");
-					cframes[storedFrames - 1] = cf;
-				}
-
-				int storedFrames;  vglcommon::CompressedFrame **cframes;
 				vglcommon::Frame *frame, *lastFrame;
 				int myRank, nprocs;
 				vglutil::Event ready, complete;  bool deadYet;
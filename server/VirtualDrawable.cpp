@@ -21,6 +21,7 @@
 #include "TempContext.h"
 #include "vglutil.h"
 #include "faker.h"
+#include "fakerstats.h"
 #include "glpf.h"
 
 using namespace vglcommon;
@@ -203,6 +204,7 @@ VirtualDrawable::VirtualDrawable(Display *dpy_, Drawable x11Draw_)
 	usePBO = (fconfig.readback == RRREAD_PBO);
 	alreadyPrinted = alreadyWarned = alreadyWarnedRenderMode = false;
 	ext = NULL;
+	checkedPackInvert = usePackInvert = false;
 }
 
 
@@ -309,12 +311,21 @@ static const char *formatString(int glFormat)
 }
 
 
+// If topDown is non-NULL, then the caller can accept a top-down image.  In
+// that case, the pixels will be read back in top-down order if the OpenGL
+// implementation supports GL_MESA_pack_invert, and *topDown will be set to
+// true if that occurred.  Otherwise, the pixels are read back in OpenGL's
+// native (bottom-up) order.
+
 void VirtualDrawable::readPixels(GLint x, GLint y, GLint width, GLint pitch,
 	GLint height, GLenum glFormat, PF *pf, GLubyte *bits, GLint readBuf,
-	bool stereo)
+	bool stereo, bool *topDown)
 {
 	double t0 = 0.0, tRead, tTotal;
 	GLenum type = GL_UNSIGNED_BYTE;
+	bool invert = false;
+
+	if(topDown) *topDown = false;
 
 	// Compute OpenGL format from pixel format of frame
 	if(glFormat == GL_NONE)
@@ -378,6 +389,20 @@ void VirtualDrawable::readPixels(GLint x, GLint y, GLint width, GLint pitch,
 
 	_glReadBuffer(readBuf);
 
+	if(topDown)
+	{
+		if(!checkedPackInvert)
+		{
+			const char *extensions = (const char *)_glGetString(GL_EXTENSIONS);
+			usePackInvert =
+				(extensions && strstr(extensions, "GL_MESA_pack_invert") != NULL);
+			if(usePackInvert && fconfig.verbose)
+				vglout.println("[VGL] Using GL_MESA_pack_invert to read back pixels in top-down order");
+			checkedPackInvert = true;
+		}
+		invert = usePackInvert;
+	}
+
 	if(pitch % 8 == 0) _glPixelStorei(GL_PACK_ALIGNMENT, 8);
 	else if(pitch % 4 == 0) _glPixelStorei(GL_PACK_ALIGNMENT, 4);
 	else if(pitch % 2 == 0) _glPixelStorei(GL_PACK_ALIGNMENT, 2);
@@ -422,8 +447,15 @@ void VirtualDrawable::readPixels(GLint x, GLint y, GLint width, GLint pitch,
 	int e = _glGetError();
 	while(e != GL_NO_ERROR) e = _glGetError();  // Clear previous error
 	profReadback.startFrame();
+	double statsStart = fstats_time();
 	if(usePBO) t0 = GetTime();
+	if(invert) _glPixelStorei(GL_PACK_INVERT_MESA, GL_TRUE);
 	_glReadPixels(x, y, width, height, glFormat, type, usePBO ? NULL : bits);
+	if(invert)
+	{
+		_glPixelStorei(GL_PACK_INVERT_MESA, GL_FALSE);
+		*topDown = true;
+	}
 
 	if(usePBO)
 	{
@@ -464,6 +496,7 @@ void VirtualDrawable::readPixels(GLint x, GLint y, GLint width, GLint pitch,
 	}
 
 	profReadback.endFrame(width * height, 0, stereo ? 0.5 : 1);
+	fstats_addstage(FSTATS_READBACK, statsStart);
 	CHECKGL("Read Pixels");
 
 	// If automatic faker testing is enabled, store the FB color in an
@@ -87,7 +87,8 @@ namespace vglserver
 			};
 
 			void readPixels(GLint x, GLint y, GLint width, GLint pitch, GLint height,
-				GLenum glFormat, PF *pf, GLubyte *bits, GLint readBuf, bool stereo);
+				GLenum glFormat, PF *pf, GLubyte *bits, GLint readBuf, bool stereo,
+				bool *topDown = NULL);
 
 			vglutil::CriticalSection mutex;
 			Display *dpy;  Drawable x11Draw;
@@ -103,6 +104,7 @@ namespace vglserver
 			bool usePBO;
 			bool alreadyPrinted, alreadyWarned, alreadyWarnedRenderMode;
 			const char *ext;
+			bool checkedPackInvert, usePackInvert;
 	};
 }
 
@@ -19,6 +19,9 @@
 #include "fakerconfig.h"
 #include "glxvisual.h"
 #include "vglutil.h"
+#include "FrameTrace.h"
+#include "fakerstats.h"
+#include "FrameCapture.h"
 
 using namespace vglutil;
 using namespace vglcommon;
@@ -66,6 +69,7 @@ VirtualWin::VirtualWin(Display *dpy_, Window win) :
 	doVGLWMDelete = false;
 	newConfig = false;
 	swapInterval = 0;
+	pointerX = pointerY = -1;
 	XWindowAttributes xwa;
 	if(!XGetWindowAttributes(dpy, win, &xwa) || !xwa.visual)
 		throw(vglutil::Error(__FUNCTION__, "Invalid window", -1));
@@ -73,7 +77,7 @@ VirtualWin::VirtualWin(Display *dpy_, Window win) :
 	{
 		if(!(eventdpy = _XOpenDisplay(DisplayString(dpy))))
 			THROW("Could not clone X display connection");
-		XSelectInput(eventdpy, win, StructureNotifyMask);
+		XSelectInput(eventdpy, win, StructureNotifyMask | ExposureMask);
 		if(fconfig.verbose)
 			vglout.println("[VGL] Selecting structure notify events in window 0x%.8x",
 				win);
@@ -196,6 +200,8 @@ void VirtualWin::checkResize(void)
 			if(event.type == ConfigureNotify && event.xconfigure.window == x11Draw
 				&& event.xconfigure.width > 0 && event.xconfigure.height > 0)
 				resize(event.xconfigure.width, event.xconfigure.height);
+			else if(event.type == Expose && event.xexpose.window == x11Draw)
+				expose();
 		}
 	}
 }
@@ -241,6 +247,16 @@ void VirtualWin::wmDelete(void)
 }
 
 
+// The X11 Transport draws only the portions of each frame that have changed,
+// so it has to be told when the window contents have been lost.
+
+void VirtualWin::expose(void)
+{
+	CriticalSection::SafeLock l(mutex);
+	if(x11trans) x11trans->invalidate();
+}
+
+
 void VirtualWin::vglWMDelete(void)
 {
 	CriticalSection::SafeLock l(mutex);
@@ -248,6 +264,15 @@ void VirtualWin::vglWMDelete(void)
 }
 
 
+// The VGL Transport sends the tiles near the mouse pointer first.
+
+void VirtualWin::setPointer(int x, int y)
+{
+	CriticalSection::SafeLock l(mutex);
+	pointerX = x;  pointerY = y;
+}
+
+
 void VirtualWin::readback(GLint drawBuf, bool spoilLast, bool sync)
 {
 	fconfig_reloadenv();
@@ -319,6 +344,7 @@ void VirtualWin::readback(GLint drawBuf, bool spoilLast, bool sync)
 		case RRCOMP_JPEG:
 		case RRCOMP_RGB:
 		case RRCOMP_YUV:
+		case RRCOMP_LOSSLESS:
 			if(!vglconn)
 			{
 				NEWCHECK(vglconn = new VGLTrans());
@@ -353,7 +379,9 @@ void VirtualWin::sendPlugin(GLint drawBuf, bool spoilLast, bool sync,
 	}
 
 	if(spoilLast && fconfig.spoil && !plugin->ready())
-		return;
+	{
+		FSTATS_ADD(framesSpoiled, 1);  return;
+	}
 	if(!fconfig.spoil) plugin->synchronize();
 
 	if(oglDraw->getRGBSize() != 24)
@@ -402,7 +430,9 @@ void VirtualWin::sendPlugin(GLint drawBuf, bool spoilLast, bool sync,
 				rrframe->rbits, REYE(drawBuf), doStereo);
 	}
 	if(!syncdpy) { XSync(dpy, False);  syncdpy = true; }
+	if(framecapture.isEnabled()) framecapture.write(f, x11Draw);
 	if(fconfig.logo) f.addLogo();
+	FSTATS_ADD(framesRead, 1);
 	plugin->sendFrame(rrframe, sync);
 }
 
@@ -413,7 +443,9 @@ void VirtualWin::sendVGL(GLint drawBuf, bool spoilLast, bool doStereo,
 	int w = oglDraw->getWidth(), h = oglDraw->getHeight();
 
 	if(spoilLast && fconfig.spoil && !vglconn->isReady())
-		return;
+	{
+		FSTATS_ADD(framesSpoiled, 1);  return;
+	}
 	Frame *f;
 
 	if(oglDraw->getRGBSize() != 24)
@@ -430,6 +462,8 @@ void VirtualWin::sendVGL(GLint drawBuf, bool spoilLast, bool doStereo,
 	if(!fconfig.spoil) vglconn->synchronize();
 	ERRIFNOT(f = vglconn->getFrame(w, h, pixelFormat, FRAME_BOTTOMUP,
 		doStereo && stereoMode == RRSTEREO_QUADBUF));
+	f->traceID = frametrace.newFrameID();
+	double traceStart = frametrace.time();
 	if(doStereo && IS_ANAGLYPHIC(stereoMode))
 	{
 		stereoFrame.deInit();
@@ -460,8 +494,12 @@ void VirtualWin::sendVGL(GLint drawBuf, bool spoilLast, bool doStereo,
 	f->hdr.qual = qual;
 	f->hdr.subsamp = subsamp;
 	f->hdr.compress = (unsigned char)compress;
+	f->pointerX = pointerX;  f->pointerY = pointerY;
 	if(!syncdpy) { XSync(dpy, False);  syncdpy = true; }
+	if(framecapture.isEnabled()) framecapture.write(*f, x11Draw);
 	if(fconfig.logo) f->addLogo();
+	f->traceTime = frametrace.record("Readback", f->traceID, traceStart);
+	FSTATS_ADD(framesRead, 1);
 	vglconn->sendFrame(f);
 }
 
@@ -472,10 +510,34 @@ void VirtualWin::sendX11(GLint drawBuf, bool spoilLast, bool sync,
 	int width = oglDraw->getWidth(), height = oglDraw->getHeight();
 
 	FBXFrame *f;
-	if(!x11trans) NEWCHECK(x11trans = new X11Trans());
-	if(spoilLast && fconfig.spoil && !x11trans->isReady()) return;
+	if(!x11trans)
+	{
+		NEWCHECK(x11trans = new X11Trans());
+		// The X11 Transport draws only the tiles that have changed since the
+		// previous frame, so it must know when the window has been exposed, even
+		// if the application does not select Expose events.
+		if(!eventdpy)
+		{
+			if(!(eventdpy = _XOpenDisplay(DisplayString(dpy))))
+				THROW("Could not clone X display connection");
+			XSelectInput(eventdpy, x11Draw, ExposureMask);
+			if(fconfig.verbose)
+				vglout.println("[VGL] Selecting expose events in window 0x%.8x",
+					x11Draw);
+		}
+	}
+	XEvent event;  bool exposed = false;
+	while(_XCheckTypedWindowEvent(eventdpy, x11Draw, Expose, &event))
+		exposed = true;
+	if(exposed) x11trans->invalidate();
+	if(spoilLast && fconfig.spoil && !x11trans->isReady())
+	{
+		FSTATS_ADD(framesSpoiled, 1);  return;
+	}
 	if(!fconfig.spoil) x11trans->synchronize();
 	ERRIFNOT(f = x11trans->getFrame(dpy, x11Draw, width, height));
+	f->traceID = frametrace.newFrameID();
+	double traceStart = frametrace.time();
 	f->flags |= FRAME_BOTTOMUP;
 	if(doStereo && IS_ANAGLYPHIC(stereoMode))
 	{
@@ -493,11 +555,19 @@ void VirtualWin::sendX11(GLint drawBuf, bool spoilLast, bool sync,
 			GLint readBuf = drawBuf;
 			if(stereoMode == RRSTEREO_REYE) readBuf = REYE(drawBuf);
 			else if(stereoMode == RRSTEREO_LEYE) readBuf = LEYE(drawBuf);
+			// Reading back the pixels in top-down order, if possible, eliminates
+			// the need for FBXFrame::redraw() to flip them.
+			bool topDown = false;
 			readPixels(0, 0, min(width, f->hdr.framew), f->pitch,
-				min(height, f->hdr.frameh), GL_NONE, f->pf, f->bits, readBuf, false);
+				min(height, f->hdr.frameh), GL_NONE, f->pf, f->bits, readBuf, false,
+				&topDown);
+			if(topDown) f->flags &= ~FRAME_BOTTOMUP;
 		}
 	}
+	if(framecapture.isEnabled()) framecapture.write(*f, x11Draw);
 	if(fconfig.logo) f->addLogo();
+	f->traceTime = frametrace.record("Readback", f->traceID, traceStart);
+	FSTATS_ADD(framesRead, 1);
 	x11trans->sendFrame(f, sync);
 }
 
@@ -511,9 +581,14 @@ void VirtualWin::sendXV(GLint drawBuf, bool spoilLast, bool sync,
 
 	XVFrame *f;
 	if(!xvtrans) NEWCHECK(xvtrans = new XVTrans());
-	if(spoilLast && fconfig.spoil && !xvtrans->isReady()) return;
+	if(spoilLast && fconfig.spoil && !xvtrans->isReady())
+	{
+		FSTATS_ADD(framesSpoiled, 1);  return;
+	}
 	if(!fconfig.spoil) xvtrans->synchronize();
 	ERRIFNOT(f = xvtrans->getFrame(dpy, x11Draw, width, height));
+	unsigned int traceID = frametrace.newFrameID();
+	double traceStart = frametrace.time();
 	rrframeheader hdr;
 	hdr.x = hdr.y = 0;
 	hdr.width = hdr.framew = width;
@@ -549,9 +624,14 @@ void VirtualWin::sendXV(GLint drawBuf, bool spoilLast, bool sync,
 			false);
 	}
 
+	if(framecapture.isEnabled()) framecapture.write(frame, x11Draw);
 	if(fconfig.logo) frame.addLogo();
+	traceStart = frametrace.record("Readback", traceID, traceStart);
+	FSTATS_ADD(framesRead, 1);
 
 	*f = frame;
+	f->traceID = traceID;
+	f->traceTime = frametrace.record("Encode YUV", traceID, traceStart);
 	xvtrans->sendFrame(f, sync);
 }
 
@@ -601,10 +681,11 @@ void VirtualWin::makePassive(Frame *f, int drawBuf, GLenum glFormat,
 
 
 void VirtualWin::readPixels(GLint x, GLint y, GLint width, GLint pitch,
-	GLint height, GLenum glFormat, PF *pf, GLubyte *bits, GLint buf, bool stereo)
+	GLint height, GLenum glFormat, PF *pf, GLubyte *bits, GLint buf, bool stereo,
+	bool *topDown)
 {
 	VirtualDrawable::readPixels(x, y, width, pitch, height, glFormat, pf, bits,
-		buf, stereo);
+		buf, stereo, topDown);
 
 	// Gamma correction
 	if(fconfig.gamma != 0.0 && fconfig.gamma != 1.0 && fconfig.gamma != -1.0)
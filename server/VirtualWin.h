@@ -43,7 +43,9 @@ namespace vglserver
 			void swapBuffers(void);
 			bool isStereo(void);
 			void wmDelete(void);
+			void expose(void);
 			void vglWMDelete(void);
+			void setPointer(int x, int y);
 			int getSwapInterval(void) { return swapInterval; }
 			void setSwapInterval(int swapInterval_) { swapInterval = swapInterval_; }
 
@@ -53,7 +55,8 @@ namespace vglserver
 
 			int init(int w, int h, GLXFBConfig config);
 			void readPixels(GLint x, GLint y, GLint width, GLint pitch, GLint height,
-				GLenum glFormat, PF *pf, GLubyte *bits, GLint buf, bool stereo);
+				GLenum glFormat, PF *pf, GLubyte *bits, GLint buf, bool stereo,
+				bool *topDown = NULL);
 			void makeAnaglyph(vglcommon::Frame *f, int drawBuf, int stereoMode);
 			void makePassive(vglcommon::Frame *f, int drawBuf, GLenum glFormat,
 				int stereoMode);
@@ -85,6 +88,7 @@ namespace vglserver
 			bool doVGLWMDelete;
 			bool newConfig;
 			int swapInterval;
+			int pointerX, pointerY;
 	};
 }
 
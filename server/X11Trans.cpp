@@ -17,13 +17,16 @@
 #include "fakerconfig.h"
 #include "vglutil.h"
 #include "Log.h"
+#include "FrameTrace.h"
+#include "fakerstats.h"
 
 using namespace vglutil;
 using namespace vglcommon;
 using namespace vglserver;
 
 
-X11Trans::X11Trans(void) : thread(NULL), deadYet(false)
+X11Trans::X11Trans(void) : nextFrame(0), thread(NULL), deadYet(false),
+	fullRedraw(false)
 {
 	for(int i = 0; i < NFRAMES; i++) frames[i] = NULL;
 	NEWCHECK(thread = new Thread(this));
@@ -37,18 +40,35 @@ X11Trans::X11Trans(void) : thread(NULL), deadYet(false)
 void X11Trans::run(void)
 {
 	Timer timer, sleepTimer;  double err = 0.;  bool first = true;
+	FBXFrame *lastf = NULL;
 
 	try
 	{
 		while(!deadYet)
 		{
-			FBXFrame *f;  void *ftemp = NULL;
+			FBXFrame *f;  void *ftemp = NULL;  bool full;
 
 			q.get(&ftemp);  f = (FBXFrame *)ftemp;  if(deadYet) return;
 			if(!f) THROW("Queue has been shut down");
 			ready.signal();
+			FSTATS_ADD(queueDepth, -1);
+			frametrace.record("Queue", f->traceID, f->traceTime);
+			{
+				CriticalSection::SafeLock l(mutex);
+				full = fullRedraw;  fullRedraw = false;
+			}
 			profBlit.startFrame();
-			f->redraw();
+			double traceStart = frametrace.time(), statsStart = fstats_time();
+			// Each frame in the pool has its own display connection, so the puts
+			// of the previous frame must complete before this frame is drawn.
+			// Otherwise, the X server could draw the older frame over this one.
+			if(lastf) lastf->wait();
+			profBlit.incSkipped(f->redraw(false,
+				fconfig.interframe && !full ? lastf : NULL, fconfig.tilesize));
+			frametrace.record("Blit", f->traceID, traceStart);
+			fstats_addstage(FSTATS_BLIT, statsStart);
+			FSTATS_ADD(framesSent, 1);
+			FSTATS_ADD(pixelsSent, f->hdr.width * f->hdr.height);
 			profBlit.endFrame(f->hdr.width * f->hdr.height, 0, 1);
 
 			profTotal.endFrame(f->hdr.width * f->hdr.height, 0, 1);
@@ -78,7 +98,10 @@ void X11Trans::run(void)
 				timer.start();
 			}
 
-			f->signalComplete();
+			// The most recently drawn frame is retained so that the next frame can
+			// be compared against it.
+			if(lastf) lastf->signalComplete();
+			lastf = f;
 		}
 
 	}
@@ -98,11 +121,20 @@ FBXFrame *X11Trans::getFrame(Display *dpy, Window win, int width, int height)
 	{
 		CriticalSection::SafeLock l(mutex);
 
+		// Frames are blitted asynchronously, so reuse them in round-robin order.
+		// This gives the X server as much time as possible to finish reading
+		// a frame's shared memory segment before we read back into it again.
 		int index = -1;
 		for(int i = 0; i < NFRAMES; i++)
-			if(!frames[i] || (frames[i] && frames[i]->isComplete()))
-				index = i;
+		{
+			int j = (nextFrame + i) % NFRAMES;
+			if(!frames[j] || frames[j]->isComplete())
+			{
+				index = j;  break;
+			}
+		}
 		if(index < 0) THROW("No free buffers in pool");
+		nextFrame = (index + 1) % NFRAMES;
 		if(!frames[index])
 			NEWCHECK(frames[index] = new FBXFrame(dpy, win));
 		f = frames[index];  f->waitUntilComplete();
@@ -131,6 +163,17 @@ void X11Trans::synchronize(void)
 }
 
 
+// Force the next frame to be drawn in its entirety, because the contents of
+// the window no longer match the most recently drawn frame (due to an Expose
+// event, for instance.)
+
+void X11Trans::invalidate(void)
+{
+	CriticalSection::SafeLock l(mutex);
+	fullRedraw = true;
+}
+
+
 static void __X11Trans_spoilfct(void *f)
 {
 	if(f) ((FBXFrame *)f)->signalComplete();
@@ -143,10 +186,22 @@ void X11Trans::sendFrame(FBXFrame *f, bool sync)
 	if(sync)
 	{
 		profBlit.startFrame();
+		double traceStart = frametrace.time(), statsStart = fstats_time();
 		f->redraw();
+		frametrace.record("Blit", f->traceID, traceStart);
+		fstats_addstage(FSTATS_BLIT, statsStart);
+		FSTATS_ADD(framesSent, 1);
+		FSTATS_ADD(pixelsSent, f->hdr.width * f->hdr.height);
 		f->signalComplete();
 		profBlit.endFrame(f->hdr.width * f->hdr.height, 0, 1);
+		invalidate();
 		ready.signal();
 	}
-	else q.spoil((void *)f, __X11Trans_spoilfct);
+	else
+	{
+		int spoiled = q.spoil((void *)f, __X11Trans_spoilfct);
+		profTotal.incSpoiled(spoiled);
+		FSTATS_ADD(framesSpoiled, spoiled);
+		FSTATS_ADD(queueDepth, 1 - spoiled);
+	}
 }
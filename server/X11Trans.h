@@ -42,6 +42,7 @@ namespace vglserver
 
 			bool isReady(void);
 			void synchronize(void);
+			void invalidate(void);
 			void sendFrame(vglcommon::FBXFrame *, bool sync = false);
 			void run(void);
 			vglcommon::FBXFrame *getFrame(Display *dpy, Window win, int width,
@@ -49,13 +50,14 @@ namespace vglserver
 
 		private:
 
-			static const int NFRAMES = 3;
+			static const int NFRAMES = 4;
 			vglutil::CriticalSection mutex;
 			vglcommon::FBXFrame *frames[NFRAMES];
+			int nextFrame;
 			vglutil::Event ready;
 			vglutil::GenericQ q;
 			vglutil::Thread *thread;
-			bool deadYet;
+			bool deadYet, fullRedraw;
 			vglcommon::Profiler profBlit, profTotal;
 	};
 }
@@ -17,15 +17,18 @@
 #include "Timer.h"
 #include "fakerconfig.h"
 #include "Log.h"
+#include "FrameTrace.h"
+#include "fakerstats.h"
 
 using namespace vglutil;
 using namespace vglcommon;
 using namespace vglserver;
 
 
-XVTrans::XVTrans(void) : thread(NULL), deadYet(false)
+XVTrans::XVTrans(void) : encoder(NULL), thread(NULL), deadYet(false)
 {
 	for(int i = 0; i < NFRAMES; i++) frames[i] = NULL;
+	NEWCHECK(encoder = new YUVEncoder(fconfig.np));
 	NEWCHECK(thread = new Thread(this));
 	thread->start();
 	profXV.setName("XV        ");
@@ -47,8 +50,15 @@ void XVTrans::run(void)
 			q.get(&ftemp);  f = (XVFrame *)ftemp;  if(deadYet) return;
 			if(!f) throw("Queue has been shut down");
 			ready.signal();
+			FSTATS_ADD(queueDepth, -1);
+			frametrace.record("Queue", f->traceID, f->traceTime);
 			profXV.startFrame();
+			double traceStart = frametrace.time(), statsStart = fstats_time();
 			f->redraw();
+			frametrace.record("Blit", f->traceID, traceStart);
+			fstats_addstage(FSTATS_BLIT, statsStart);
+			FSTATS_ADD(framesSent, 1);
+			FSTATS_ADD(pixelsSent, f->hdr.width * f->hdr.height);
 			profXV.endFrame(f->hdr.width * f->hdr.height, 0, 1);
 
 			profTotal.endFrame(f->hdr.width * f->hdr.height, 0, 1);
@@ -104,7 +114,7 @@ XVFrame *XVTrans::getFrame(Display *dpy, Window win, int width, int height)
 				index = i;
 		if(index < 0) THROW("No free buffers in pool");
 		if(!frames[index])
-			NEWCHECK(frames[index] = new XVFrame(dpy, win));
+			NEWCHECK(frames[index] = new XVFrame(dpy, win, encoder));
 		f = frames[index];  f->waitUntilComplete();
 	}
 
@@ -143,10 +153,21 @@ void XVTrans::sendFrame(XVFrame *f, bool sync)
 	if(sync)
 	{
 		profXV.startFrame();
+		double traceStart = frametrace.time(), statsStart = fstats_time();
 		f->redraw();
+		frametrace.record("Blit", f->traceID, traceStart);
+		fstats_addstage(FSTATS_BLIT, statsStart);
+		FSTATS_ADD(framesSent, 1);
+		FSTATS_ADD(pixelsSent, f->hdr.width * f->hdr.height);
 		f->signalComplete();
 		profXV.endFrame(f->hdr.width * f->hdr.height, 0, 1);
 		ready.signal();
 	}
-	else q.spoil((void *)f, __XVTrans_spoilfct);
+	else
+	{
+		int spoiled = q.spoil((void *)f, __XVTrans_spoilfct);
+		profTotal.incSpoiled(spoiled);
+		FSTATS_ADD(framesSpoiled, spoiled);
+		FSTATS_ADD(queueDepth, 1 - spoiled);
+	}
 }
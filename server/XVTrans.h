@@ -38,6 +38,7 @@ namespace vglserver
 				{
 					delete frames[i];  frames[i] = NULL;
 				}
+				delete encoder;  encoder = NULL;
 			}
 
 			bool isReady(void);
@@ -51,6 +52,7 @@ namespace vglserver
 			static const int NFRAMES = 3;
 			vglutil::CriticalSection mutex;
 			vglcommon::XVFrame *frames[NFRAMES];
+			vglcommon::YUVEncoder *encoder;
 			vglutil::Event ready;
 			vglutil::GenericQ q;
 			vglutil::Thread *thread;
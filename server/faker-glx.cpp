@@ -2591,7 +2591,7 @@ void glXUseXFont(Font font, int first, int count, int list_base)
 		OPENTRACE(glXUseXFont);  PRARGX(font);  PRARGI(first);  PRARGI(count);
 		PRARGI(list_base);  STARTTRACE();
 
-	Fake_glXUseXFont(font, first, count, list_base);
+	Fake_glXUseXFont(font, first, count, list_base, vglTraceCall);
 
 		STOPTRACE();  CLOSETRACE();
 
@@ -354,7 +354,8 @@ Status XGetGeometry(Display *dpy, Drawable drawable, Window *root, int *x,
 
 		STOPTRACE();  if(root) PRARGX(*root);  if(x) PRARGI(*x);  if(y) PRARGI(*y);
 		PRARGI(width);  PRARGI(height);  if(border_width) PRARGI(*border_width);
-		if(depth) PRARGI(*depth);  CLOSETRACE();
+		if(depth) PRARGI(*depth);
+		CLOSETRACE();
 
 	if(width_return) *width_return = width;
 	if(height_return) *height_return = height;
@@ -512,7 +513,8 @@ Bool XQueryExtension(Display *dpy, _Xconst char *name, int *major_opcode,
 
 		STOPTRACE();  if(major_opcode) PRARGI(*major_opcode);
 		if(first_event) PRARGI(*first_event);
-		if(first_error) PRARGI(*first_error);  CLOSETRACE();
+		if(first_error) PRARGI(*first_error);
+		CLOSETRACE();
 
 	return retval;
 }
@@ -560,6 +562,11 @@ static void handleEvent(Display *dpy, XEvent *xe)
 				STOPTRACE();  CLOSETRACE();
 		}
 	}
+	else if(xe && xe->type == Expose)
+	{
+		if(winhash.find(dpy, xe->xexpose.window, vw))
+			vw->expose();
+	}
 	else if(xe && xe->type == KeyPress)
 	{
 		unsigned int state2, state = (xe->xkey.state) & (~(LockMask));
@@ -584,6 +591,20 @@ static void handleEvent(Display *dpy, XEvent *xe)
 			&& winhash.find(dpy, cme->window, vw))
 			vw->wmDelete();
 	}
+	else if(xe && (xe->type == MotionNotify || xe->type == ButtonPress
+		|| xe->type == ButtonRelease || xe->type == EnterNotify
+		|| xe->type == LeaveNotify))
+	{
+		if(winhash.find(dpy, xe->xany.window, vw))
+		{
+			if(xe->type == MotionNotify)
+				vw->setPointer(xe->xmotion.x, xe->xmotion.y);
+			else if(xe->type == EnterNotify)
+				vw->setPointer(xe->xcrossing.x, xe->xcrossing.y);
+			else if(xe->type == LeaveNotify) vw->setPointer(-1, -1);
+			else vw->setPointer(xe->xbutton.x, xe->xbutton.y);
+		}
+	}
 }
 
 
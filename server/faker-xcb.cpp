@@ -119,7 +119,8 @@ xcb_glx_query_version_reply_t *
 		STOPTRACE();
 		if(error)
 		{
-			if(*error) PRARGERR(*error)  else PRARGX(*error);
+			if(*error) PRARGERR(*error);
+			else PRARGX(*error);
 		}
 		else PRARGX(error);
 		if(reply)
@@ -23,6 +23,7 @@
 #include "VisualHash.h"
 #include "WindowHash.h"
 #include "fakerconfig.h"
+#include "fakerstats.h"
 #include "threadlocal.h"
 #include <dlfcn.h>
 #include <X11/Xlibint.h>
@@ -73,6 +74,7 @@ void safeExit(int retcode)
 	{
 		deadYet = true;
 		cleanup();
+		fstats_deleteinstance();
 		fconfig_deleteinstance();
 	}
 	globalMutex.unlock(false);
@@ -90,6 +92,7 @@ class GlobalCleanup
 			vglfaker::GlobalCriticalSection *gcs =
 				vglfaker::GlobalCriticalSection::getInstance(false);
 			if(gcs) gcs->lock(false);
+			fstats_deleteinstance();
 			fconfig_deleteinstance();
 			deadYet = true;
 			if(gcs) gcs->unlock(false);
@@ -23,6 +23,7 @@
 #include "fakerconfig.h"
 #include "vglutil.h"
 #include "DisplayHash.h"
+#include "BinaryTrace.h"
 
 
 namespace vglfaker
@@ -91,91 +92,238 @@ namespace vglfaker
 
 // Tracing stuff
 
-#define PRARGD(a)  vglout.print("%s=0x%.8lx(%s) ", #a, (unsigned long)a, \
-		a ? DisplayString(a) : "NULL")
+// If binary tracing is enabled (VGL_TRACEFILE), then the tracing macros record
+// the raw arguments in a BinTraceCall structure rather than printing them.
+// Each function and argument name is registered once per call site.
 
-#define PRARGS(a)  vglout.print("%s=%s ", #a, a ? a : "NULL")
+#define IS_BINTRACE  (vglTraceCall.isRecording())
 
-#define PRARGX(a)  vglout.print("%s=0x%.8lx ", #a, a)
+#define BINTRACE_ARG(a, type) \
+	static unsigned short __name = bintrace.registerName(a, type);
 
-#define PRARGIX(a)  vglout.print("%s=%d(0x%.lx) ", #a, (unsigned long)a, \
-	(unsigned long)a)
+#define PRARGD(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'D');  bintrace.addDisplay(*vglTraceCall, __name, a); \
+	} \
+	else vglout.print("%s=0x%.8lx(%s) ", #a, (unsigned long)a, \
+		a ? DisplayString(a) : "NULL"); \
+} while(0)
 
-#define PRARGI(a)  vglout.print("%s=%d ", #a, a)
+#define PRARGS(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'S'); \
+		vglserver::BinaryTracer::addString(*vglTraceCall, __name, a); \
+	} \
+	else vglout.print("%s=%s ", #a, a ? a : "NULL"); \
+} while(0)
 
-#define PRARGF(a)  vglout.print("%s=%f ", #a, (double)a)
+#define PRARGX(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'X'); \
+		vglserver::BinaryTracer::add(*vglTraceCall, __name, \
+			(unsigned long long)(unsigned long)a); \
+	} \
+	else vglout.print("%s=0x%.8lx ", #a, a); \
+} while(0)
+
+#define PRARGIX(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'Y'); \
+		vglserver::BinaryTracer::add(*vglTraceCall, __name, \
+			(unsigned long long)(unsigned long)a); \
+	} \
+	else \
+		vglout.print("%s=%d(0x%.lx) ", #a, (unsigned long)a, (unsigned long)a); \
+} while(0)
+
+#define PRARGI(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'I'); \
+		vglserver::BinaryTracer::add(*vglTraceCall, __name, \
+			(unsigned long long)(long long)a); \
+	} \
+	else vglout.print("%s=%d ", #a, a); \
+} while(0)
 
-#define PRARGV(a) \
-	vglout.print("%s=0x%.8lx(0x%.2lx) ", #a, (unsigned long)a, \
-		a ? (a)->visualid : 0)
+#define PRARGF(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'F'); \
+		double __d = (double)a;  unsigned long long __v; \
+		memcpy(&__v, &__d, sizeof(double)); \
+		vglserver::BinaryTracer::add(*vglTraceCall, __name, __v); \
+	} \
+	else vglout.print("%s=%f ", #a, (double)a); \
+} while(0)
 
-#define PRARGC(a) \
-	vglout.print("%s=0x%.8lx(0x%.2x) ", #a, (unsigned long)a, a ? FBCID(a) : 0)
+#define PRARGV(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'V'); \
+		vglserver::BinaryTracer::add(*vglTraceCall, __name, \
+			(unsigned long long)(unsigned long)a); \
+		vglserver::BinaryTracer::add(*vglTraceCall, 0, a ? (a)->visualid : 0); \
+	} \
+	else vglout.print("%s=0x%.8lx(0x%.2lx) ", #a, (unsigned long)a, \
+		a ? (a)->visualid : 0); \
+} while(0)
 
-#define PRARGAL11(a)  if(a) \
+#define PRARGC(a)  do \
 { \
-	vglout.print(#a "=["); \
-	for(int __an = 0; a[__an] != None; __an++) \
-	{ \
-		vglout.print("0x%.4x", a[__an]); \
-		if(a[__an] != GLX_USE_GL && a[__an] != GLX_DOUBLEBUFFER \
-			&& a[__an] != GLX_STEREO && a[__an] != GLX_RGBA) \
-			vglout.print("=0x%.4x", a[++__an]); \
-		vglout.print(" "); \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'C'); \
+		vglserver::BinaryTracer::add(*vglTraceCall, __name, \
+			(unsigned long long)(unsigned long)a); \
+		vglserver::BinaryTracer::add(*vglTraceCall, 0, a ? FBCID(a) : 0); \
 	} \
-	vglout.print("] "); \
-}
+	else vglout.print("%s=0x%.8lx(0x%.2x) ", #a, (unsigned long)a, \
+		a ? FBCID(a) : 0); \
+} while(0)
 
-#define PRARGAL13(a)  if(a != NULL) \
+// These print attribute lists regardless of whether binary tracing is enabled.
+
+#define PRINTAL11(a)  do \
 { \
-	vglout.print(#a "=["); \
-	for(int __an = 0; a[__an] != None; __an += 2) \
+	if(a) \
 	{ \
-		vglout.print("0x%.4x=0x%.4x ", a[__an], a[__an + 1]); \
+		vglout.print(#a "=["); \
+		for(int __an = 0; a[__an] != None; __an++) \
+		{ \
+			vglout.print("0x%.4x", a[__an]); \
+			if(a[__an] != GLX_USE_GL && a[__an] != GLX_DOUBLEBUFFER \
+				&& a[__an] != GLX_STEREO && a[__an] != GLX_RGBA) \
+				vglout.print("=0x%.4x", a[++__an]); \
+			vglout.print(" "); \
+		} \
+		vglout.print("] "); \
 	} \
-	vglout.print("] "); \
-}
+} while(0)
+
+#define PRINTAL13(a)  do \
+{ \
+	if(a != NULL) \
+	{ \
+		vglout.print(#a "=["); \
+		for(int __an = 0; a[__an] != None; __an += 2) \
+		{ \
+			vglout.print("0x%.4x=0x%.4x ", a[__an], a[__an + 1]); \
+		} \
+		vglout.print("] "); \
+	} \
+} while(0)
+
+#define PRARGAL11(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'A'); \
+		vglserver::BinaryTracer::addList(*vglTraceCall, __name, a, false); \
+	} \
+	else PRINTAL11(a); \
+} while(0)
+
+#define PRARGAL13(a)  do \
+{ \
+	if(IS_BINTRACE) \
+	{ \
+		BINTRACE_ARG(#a, 'B'); \
+		vglserver::BinaryTracer::addList(*vglTraceCall, __name, a, true); \
+	} \
+	else PRINTAL13(a); \
+} while(0)
 
 #ifdef FAKEXCB
-#define PRARGERR(a) \
+#define PRARGERR(a)  do \
 { \
-	vglout.print("(%s)->response_type=%d ", #a, (a)->response_type); \
-	vglout.print("(%s)->error_code=%d ", #a, (a)->error_code); \
-}
+	if(IS_BINTRACE) \
+	{ \
+		{ \
+			BINTRACE_ARG("(" #a ")->response_type", 'I'); \
+			vglserver::BinaryTracer::add(*vglTraceCall, __name, \
+				(a)->response_type); \
+		} \
+		BINTRACE_ARG("(" #a ")->error_code", 'I'); \
+		vglserver::BinaryTracer::add(*vglTraceCall, __name, (a)->error_code); \
+	} \
+	else \
+	{ \
+		vglout.print("(%s)->response_type=%d ", #a, (a)->response_type); \
+		vglout.print("(%s)->error_code=%d ", #a, (a)->error_code); \
+	} \
+} while(0)
 #endif
 
+// The BinTraceCall structure is only allocated if binary tracing is enabled,
+// so the stack footprint of an interposed function is unchanged otherwise.
+
 #define OPENTRACE(f) \
 	double vglTraceTime = 0.; \
-	if(fconfig.trace) \
+	vglserver::BinTraceCallPtr vglTraceCall; \
+	if(bintrace.isEnabled() && vglTraceCall.alloc()) \
+	{ \
+		static unsigned short __func = \
+			bintrace.registerName(#f, BINTRACE_FUNC); \
+		bintrace.open(*vglTraceCall, __func, vglfaker::getTraceLevel()); \
+	} \
+	if(IS_BINTRACE || fconfig.trace) \
 	{ \
-		if(vglfaker::getTraceLevel() > 0) \
+		if(!IS_BINTRACE) \
 		{ \
-			vglout.print("\n[VGL 0x%.8x] ", pthread_self()); \
-			for(int __i = 0; __i < vglfaker::getTraceLevel(); __i++) \
-				vglout.print("  "); \
+			if(vglfaker::getTraceLevel() > 0) \
+			{ \
+				vglout.print("\n[VGL 0x%.8x] ", pthread_self()); \
+				for(int __i = 0; __i < vglfaker::getTraceLevel(); __i++) \
+					vglout.print("  "); \
+			} \
+			else vglout.print("[VGL 0x%.8x] ", pthread_self()); \
 		} \
-		else vglout.print("[VGL 0x%.8x] ", pthread_self()); \
 		vglfaker::setTraceLevel(vglfaker::getTraceLevel() + 1); \
-		vglout.print("%s (", #f); \
+		if(!IS_BINTRACE) vglout.print("%s (", #f); \
 
 #define STARTTRACE() \
 		vglTraceTime = GetTime(); \
+		if(IS_BINTRACE) \
+		{ \
+			vglTraceCall->nIn = vglTraceCall->nSlots; \
+			vglTraceCall->start = vglTraceTime; \
+		} \
 	}
 
 #define STOPTRACE() \
-	if(fconfig.trace) \
+	if(IS_BINTRACE || fconfig.trace) \
 	{ \
 		vglTraceTime = GetTime() - vglTraceTime;
 
 #define CLOSETRACE() \
-		vglout.PRINT(") %f ms\n", vglTraceTime * 1000.); \
-		vglfaker::setTraceLevel(vglfaker::getTraceLevel() - 1); \
-		if(vglfaker::getTraceLevel() > 0) \
+		if(IS_BINTRACE) \
 		{ \
-			vglout.print("[VGL 0x%.8x] ", pthread_self()); \
-			if(vglfaker::getTraceLevel() > 1) \
-				for(int __i = 0; __i < vglfaker::getTraceLevel() - 1; __i++) \
-					vglout.print("  "); \
+			vglfaker::setTraceLevel(vglfaker::getTraceLevel() - 1); \
+			bintrace.close(*vglTraceCall, vglTraceTime); \
+		} \
+		else \
+		{ \
+			vglout.PRINT(") %f ms\n", vglTraceTime * 1000.); \
+			vglfaker::setTraceLevel(vglfaker::getTraceLevel() - 1); \
+			if(vglfaker::getTraceLevel() > 0) \
+			{ \
+				vglout.print("[VGL 0x%.8x] ", pthread_self()); \
+				if(vglfaker::getTraceLevel() > 1) \
+					for(int __i = 0; __i < vglfaker::getTraceLevel() - 1; __i++) \
+						vglout.print("  "); \
+			} \
 		} \
 	}
 
@@ -160,6 +160,7 @@ static void fconfig_init(void)
 	memset(&fconfig_env, 0, sizeof(FakerConfig));
 	fconfig.compress = -1;
 	strncpy(fconfig.config, VGLCONFIG_PATH, MAXSTR);
+	fconfig.dedup = 1;
 	#ifdef sun
 	fconfig.dlsymloader = true;
 	#endif
@@ -174,6 +175,7 @@ static void fconfig_init(void)
 	fconfig.guimod = ShiftMask | ControlMask;
 	fconfig.interframe = 1;
 	strncpy(fconfig.localdpystring, ":0", MAXSTR);
+	fconfig.mintilesize = RR_DEFAULTMINTILESIZE;
 	fconfig.np = 1;
 	fconfig.port = -1;
 	fconfig.probeglx = 1;
@@ -181,10 +183,13 @@ static void fconfig_init(void)
 	fconfig.readback = RRREAD_PBO;
 	fconfig.refreshrate = 60.0;
 	fconfig.samples = -1;
+	fconfig.scroll = 1;
+	fconfig.slices = MAXPROCS;
 	fconfig.spoil = 1;
 	fconfig.spoillast = 1;
 	fconfig.stereo = RRSTEREO_QUADBUF;
 	fconfig.subsamp = -1;
+	fconfig.tilecache = RR_DEFAULTTILECACHE;
 	fconfig.tilesize = RR_DEFAULTTILESIZE;
 	fconfig.transpixel = -1;
 	fconfig_reloadenv();
@@ -270,6 +275,7 @@ void fconfig_reloadenv(void)
 
 	CriticalSection::SafeLock l(fcmutex);
 
+	FETCHENV_BOOL("VGL_ADAPTIVE", adaptive);
 	FETCHENV_BOOL("VGL_ALLOWINDIRECT", allowindirect);
 	FETCHENV_BOOL("VGL_AUTOTEST", autotest);
 	FETCHENV_STR("VGL_CLIENT", client);
@@ -309,6 +315,7 @@ void fconfig_reloadenv(void)
 		else if(!strnicmp(env, "r", 1)) compress = RRCOMP_RGB;
 		else if(!strnicmp(env, "x", 1)) compress = RRCOMP_XV;
 		else if(!strnicmp(env, "y", 1)) compress = RRCOMP_YUV;
+		else if(!strnicmp(env, "l", 1)) compress = RRCOMP_LOSSLESS;
 		if(compress >= 0 && (!fconfig_envset || fconfig_env.compress != compress))
 		{
 			fconfig_setcompress(fconfig, compress);
@@ -316,6 +323,7 @@ void fconfig_reloadenv(void)
 		}
 	}
 	FETCHENV_STR("VGL_CONFIG", config);
+	FETCHENV_BOOL("VGL_DEDUP", dedup);
 	FETCHENV_STR("VGL_DEFAULTFBCONFIG", defaultfbconfig);
 	if((env = getenv("VGL_DISPLAY")) != NULL && strlen(env) > 0)
 	{
@@ -406,9 +414,11 @@ void fconfig_reloadenv(void)
 			fconfig.gui = true;
 		}
 	}
+	FETCHENV_INT("VGL_INTERACTIVE", interactive, 0, 100);
 	FETCHENV_BOOL("VGL_INTERFRAME", interframe);
 	FETCHENV_STR("VGL_LOG", log);
 	FETCHENV_BOOL("VGL_LOGO", logo);
+	FETCHENV_INT("VGL_MINTILESIZE", mintilesize, 0, 1024);
 	FETCHENV_INT("VGL_NPROCS", np, 1, min(NumProcs(), MAXPROCS));
 	#ifdef FAKEOPENCL
 	FETCHENV_STR("VGL_OCLLIB", ocllib);
@@ -432,7 +442,10 @@ void fconfig_reloadenv(void)
 			fconfig.readback = fconfig_env.readback = readback;
 	}
 	FETCHENV_DBL("VGL_REFRESHRATE", refreshrate, 0.0, 1000000.0);
+	FETCHENV_INT("VGL_ROIQUAL", roiqual, 0, 100);
 	FETCHENV_INT("VGL_SAMPLES", samples, 0, 64);
+	FETCHENV_BOOL("VGL_SCROLL", scroll);
+	FETCHENV_INT("VGL_SLICES", slices, 1, MAXPROCS);
 	FETCHENV_BOOL("VGL_SPOIL", spoil);
 	FETCHENV_BOOL("VGL_SPOILLAST", spoillast);
 	FETCHENV_BOOL("VGL_SSL", ssl);
@@ -459,6 +472,7 @@ void fconfig_reloadenv(void)
 		}
 	}
 	FETCHENV_BOOL("VGL_SYNC", sync);
+	FETCHENV_INT("VGL_TILECACHE", tilecache, 0, 4096);
 	FETCHENV_INT("VGL_TILESIZE", tilesize, 8, 1024);
 	FETCHENV_BOOL("VGL_TRACE", trace);
 	FETCHENV_INT("VGL_TRANSPIXEL", transpixel, 0, 255);
@@ -594,10 +608,12 @@ void fconfig_setcompress(FakerConfig &fc, int i)
 
 void fconfig_print(FakerConfig &fc)
 {
+	PRCONF_INT(adaptive);
 	PRCONF_INT(allowindirect);
 	PRCONF_STR(client);
 	PRCONF_INT(compress);
 	PRCONF_STR(config);
+	PRCONF_INT(dedup);
 	PRCONF_STR(defaultfbconfig);
 	PRCONF_INT(dlsymloader);
 	PRCONF_INT(drawable);
@@ -613,10 +629,12 @@ void fconfig_print(FakerConfig &fc)
 	PRCONF_INT(guikey);
 	PRCONF_STR(guikeyseq);
 	PRCONF_INT(guimod);
+	PRCONF_INT(interactive);
 	PRCONF_INT(interframe);
 	PRCONF_STR(localdpystring);
 	PRCONF_STR(log);
 	PRCONF_INT(logo);
+	PRCONF_INT(mintilesize);
 	PRCONF_INT(np);
 	#ifdef FAKEOPENCL
 	PRCONF_STR(ocllib);
@@ -624,13 +642,17 @@ void fconfig_print(FakerConfig &fc)
 	PRCONF_INT(port);
 	PRCONF_INT(qual);
 	PRCONF_INT(readback);
+	PRCONF_INT(roiqual);
 	PRCONF_INT(samples);
+	PRCONF_INT(scroll);
+	PRCONF_INT(slices);
 	PRCONF_INT(spoil);
 	PRCONF_INT(spoillast);
 	PRCONF_INT(ssl);
 	PRCONF_INT(stereo);
 	PRCONF_INT(subsamp);
 	PRCONF_INT(sync);
+	PRCONF_INT(tilecache);
 	PRCONF_INT(tilesize);
 	PRCONF_INT(trace);
 	PRCONF_INT(transpixel);
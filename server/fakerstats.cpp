@@ -0,0 +1,116 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/shm.h>
+#include <sys/ipc.h>
+#include <sys/types.h>
+#include "Log.h"
+#include "Mutex.h"
+#include "fakerstats.h"
+
+using namespace vglutil;
+
+
+static FakerStats *fstats_instance = NULL;
+static int fstats_shmid = -1;
+static bool fstats_initialized = false;
+static CriticalSection fstats_mutex;
+
+
+int fstats_getshmid(void) { return fstats_shmid; }
+
+
+static void fstats_getprogname(char *name, int len)
+{
+	name[0] = 0;
+
+	#ifdef __linux__
+	FILE *file = fopen("/proc/self/cmdline", "r");
+	if(file)
+	{
+		char temps[1024];
+		size_t n = fread(temps, 1, 1023, file);
+		temps[n] = 0;
+		fclose(file);
+		char *ptr = strrchr(temps, '/');
+		strncpy(name, ptr ? &ptr[1] : temps, len - 1);
+		name[len - 1] = 0;
+	}
+	#endif
+}
+
+
+FakerStats *fstats_getinstance(void)
+{
+	if(!fstats_initialized)
+	{
+		CriticalSection::SafeLock l(fstats_mutex);
+		if(!fstats_initialized)
+		{
+			char *env = NULL;
+			void *addr = NULL;
+
+			fstats_initialized = true;
+			if((env = getenv("VGL_STATS")) != NULL && !strncmp(env, "0", 1))
+				return NULL;
+			if((fstats_shmid = shmget(IPC_PRIVATE, sizeof(FakerStats),
+				IPC_CREAT | 0600)) == -1
+				|| (addr = shmat(fstats_shmid, 0, 0)) == (void *)-1 || !addr)
+			{
+				vglout.println("[VGL] WARNING: Could not create shared memory segment for vglstat");
+				if(fstats_shmid != -1) shmctl(fstats_shmid, IPC_RMID, 0);
+				fstats_shmid = -1;
+				return NULL;
+			}
+			#ifdef linux
+			// On Linux, the segment can still be attached by its ID after it is
+			// marked for removal, and marking it now ensures that it goes away when
+			// the process exits, however the process exits.
+			shmctl(fstats_shmid, IPC_RMID, 0);
+			#endif
+			if((env = getenv("VGL_VERBOSE")) != NULL && strlen(env) > 0
+				&& !strncmp(env, "1", 1))
+				vglout.println("[VGL] Shared memory segment ID for vglstat: %d",
+					fstats_shmid);
+
+			FakerStats *fs = (FakerStats *)addr;
+			memset(fs, 0, sizeof(FakerStats));
+			fs->pid = (int)getpid();
+			fstats_getprogname(fs->progName, 256);
+			fs->version = FSTATS_VERSION;
+			// Set the magic number last, so vglstat ignores a partially initialized
+			// segment.
+			fs->magic = FSTATS_MAGIC;
+			fstats_instance = fs;
+		}
+	}
+	return fstats_instance;
+}
+
+
+void fstats_deleteinstance(void)
+{
+	if(fstats_instance != NULL)
+	{
+		CriticalSection::SafeLock l(fstats_mutex, false);
+		if(fstats_instance != NULL)
+		{
+			shmdt((char *)fstats_instance);
+			if(fstats_shmid != -1) shmctl(fstats_shmid, IPC_RMID, 0);
+			fstats_instance = NULL;
+		}
+	}
+}
@@ -0,0 +1,91 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+#ifndef __FAKERSTATS_H__
+#define __FAKERSTATS_H__
+
+#include "vglutil.h"
+
+
+// Live statistics for a single VirtualGL Faker process.  The structure is
+// stored in a shared memory segment so that vglstat can read it while the 3D
+// application is running.  The counters are only ever incremented, so vglstat
+// computes rates from the difference between two samples.  All 64-bit fields
+// are 8-byte aligned, so the layout is the same for 32-bit and 64-bit
+// processes.
+
+#define FSTATS_MAGIC  0x56474C53  // "VGLS"
+#define FSTATS_VERSION  1
+
+enum
+{
+	FSTATS_READBACK = 0, FSTATS_COMPRESS, FSTATS_SEND, FSTATS_BLIT,
+	FSTATS_NSTAGES
+};
+
+typedef struct
+{
+	int magic, version, pid, reserved;
+	// Frames read back from the Pbuffer, frames discarded (because the
+	// transport was busy, because a newer frame replaced them in the queue, or
+	// because they were identical to the previous frame), and frames delivered
+	// to the 2D X server or the VirtualGL Client
+	long long framesRead, framesSpoiled, framesSent;
+	// Pixels and (compressed) bytes delivered
+	long long pixelsSent, bytesSent;
+	// Number of frames currently waiting in transport queues
+	long long queueDepth;
+	// Total time (in microseconds) spent in, and number of invocations of, each
+	// stage of the image pipeline
+	long long stageTime[FSTATS_NSTAGES], stageCount[FSTATS_NSTAGES];
+	char progName[256];
+} FakerStats;
+
+
+// Returns NULL if statistics are disabled or the shared memory segment could
+// not be created
+FakerStats *fstats_getinstance(void);
+void fstats_deleteinstance(void);
+int fstats_getshmid(void);
+
+
+static INLINE void fstats_add(long long *counter, long long n)
+{
+	#ifdef __GNUC__
+	__sync_fetch_and_add(counter, n);
+	#else
+	*counter += n;
+	#endif
+}
+
+#define FSTATS_ADD(member, n) \
+{ \
+	FakerStats *__fs = fstats_getinstance(); \
+	if(__fs) fstats_add(&__fs->member, n); \
+}
+
+// Returns 0.0 if statistics are disabled, so the timer isn't read needlessly
+static INLINE double fstats_time(void)
+{
+	return fstats_getinstance() ? GetTime() : 0.0;
+}
+
+static INLINE void fstats_addstage(int stage, double start)
+{
+	FakerStats *fs = fstats_getinstance();
+	if(!fs || start == 0.0) return;
+	fstats_add(&fs->stageTime[stage],
+		(long long)((GetTime() - start) * 1000000.));
+	fstats_add(&fs->stageCount[stage], 1);
+}
+
+#endif  // __FAKERSTATS_H__
@@ -23,7 +23,9 @@
 #include <dlfcn.h>
 #include <unistd.h>
 #include "Error.h"
+#include "Mutex.h"
 #include "Thread.h"
+#include "Timer.h"
 #include "glext-vgl.h"
 #include <X11/Xmd.h>
 #include <GL/glxproto.h>
@@ -2915,6 +2917,229 @@ int procAddrTest(void)
 }
 
 
+// Interposition overhead benchmark.  This measures the time per call of
+// interposed functions that applications commonly call many times per frame.
+// Comparing the results with and without vglrun reveals the fixed overhead of
+// the interposers, and comparing the results with different numbers of threads
+// reveals contention within the faker.
+
+#define BENCHCALLS  100000
+
+enum
+{
+	BENCH_GLXMAKECURRENT, BENCH_GLXMAKECONTEXTCURRENT, BENCH_GLXGETCURRENTCONTEXT,
+	BENCH_GLXGETCURRENTDRAWABLE, BENCH_GLXGETCURRENTREADDRAWABLE,
+	BENCH_GLXGETCURRENTDISPLAY, BENCH_GLXGETPROCADDRESS, BENCH_GLDRAWBUFFER,
+	BENCH_GLVIEWPORT, BENCH_XSERVERVENDOR, BENCH_XCHECKWINDOWEVENT, NBENCH
+};
+
+static const char *benchName[NBENCH] =
+{
+	"glXMakeCurrent", "glXMakeContextCurrent", "glXGetCurrentContext",
+	"glXGetCurrentDrawable", "glXGetCurrentReadDrawable",
+	"glXGetCurrentDisplay", "glXGetProcAddressARB", "glDrawBuffer",
+	"glViewport", "XServerVendor", "XCheckWindowEvent"
+};
+
+
+class BenchThread : public Runnable
+{
+	public:
+
+		BenchThread(Display *dpy_, Window win_, GLXContext ctx_,
+			Semaphore &ready_, Semaphore &go_) : dpy(dpy_), win(win_), ctx(ctx_),
+			ready(ready_), go(go_)
+		{
+			for(int i = 0; i < NBENCH; i++) elapsed[i] = 0.;
+		}
+
+		void run(void)
+		{
+			Timer timer;  XEvent xe;
+
+			try
+			{
+				if(!(glXMakeCurrent(dpy, win, ctx)))
+					THROWNL("Could not make context current");
+			}
+			catch(...)
+			{
+				// Don't leave the other threads waiting
+				for(int i = 0; i < NBENCH; i++) { ready.post();  go.wait(); }
+				ready.post();
+				throw;
+			}
+			glViewport(0, 0, 100, 100);
+
+			for(int i = 0; i < NBENCH; i++)
+			{
+				// Wait until all threads are ready, so that they call each function
+				// concurrently.
+				ready.post();  go.wait();
+				timer.start();
+				for(int j = 0; j < BENCHCALLS; j++)
+				{
+					switch(i)
+					{
+						case BENCH_GLXMAKECURRENT:
+							glXMakeCurrent(dpy, win, ctx);  break;
+						case BENCH_GLXMAKECONTEXTCURRENT:
+							glXMakeContextCurrent(dpy, win, win, ctx);  break;
+						case BENCH_GLXGETCURRENTCONTEXT:
+							glXGetCurrentContext();  break;
+						case BENCH_GLXGETCURRENTDRAWABLE:
+							glXGetCurrentDrawable();  break;
+						case BENCH_GLXGETCURRENTREADDRAWABLE:
+							glXGetCurrentReadDrawable();  break;
+						case BENCH_GLXGETCURRENTDISPLAY:
+							glXGetCurrentDisplay();  break;
+						case BENCH_GLXGETPROCADDRESS:
+							glXGetProcAddressARB((const GLubyte *)"glFlush");  break;
+						case BENCH_GLDRAWBUFFER:
+							glDrawBuffer(GL_BACK);  break;
+						case BENCH_GLVIEWPORT:
+							glViewport(0, 0, 100, 100);  break;
+						case BENCH_XSERVERVENDOR:
+							XServerVendor(dpy);  break;
+						case BENCH_XCHECKWINDOWEVENT:
+							XCheckWindowEvent(dpy, win, StructureNotifyMask, &xe);  break;
+					}
+				}
+				elapsed[i] = timer.elapsed();
+			}
+			ready.post();
+			glXMakeCurrent(dpy, 0, 0);
+		}
+
+		double elapsed[NBENCH];
+
+	private:
+
+		Display *dpy;
+		Window win;
+		GLXContext ctx;
+		Semaphore &ready, &go;
+};
+
+
+int overheadBenchmark(int maxThreads)
+{
+	int glxattribs[] = { GLX_DOUBLEBUFFER, GLX_RGBA, GLX_RED_SIZE, 8,
+		GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, None };
+	XVisualInfo *vis = NULL;
+	Display *dpy = NULL;  Window windows[MAXTHREADS];
+	GLXContext contexts[MAXTHREADS];
+	BenchThread *benchThreads[MAXTHREADS];  Thread *threads[MAXTHREADS];
+	double nsPerCall[NBENCH][MAXTHREADS];
+	int threadCounts[MAXTHREADS], nCounts = 0;
+	XSetWindowAttributes swa;
+	int i, retval = 1;
+
+	for(i = 0; i < maxThreads; i++)
+	{
+		windows[i] = 0;  contexts[i] = 0;  benchThreads[i] = NULL;
+		threads[i] = NULL;
+	}
+	for(int n = 1; n < maxThreads; n *= 2) threadCounts[nCounts++] = n;
+	threadCounts[nCounts++] = maxThreads;
+
+	char *env = getenv("LD_PRELOAD");
+	printf("Interposition overhead benchmark (%s the VirtualGL Faker)\n\n",
+		env && strstr(env, "faker") ? "with" : "without");
+
+	try
+	{
+		if(!(dpy = XOpenDisplay(0))) THROW("Could not open display");
+
+		if((vis = glXChooseVisual(dpy, DefaultScreen(dpy), glxattribs)) == NULL)
+			THROW("Could not find a suitable visual");
+		Window root = RootWindow(dpy, DefaultScreen(dpy));
+		swa.colormap = XCreateColormap(dpy, root, vis->visual, AllocNone);
+		swa.border_pixel = 0;
+		swa.event_mask = StructureNotifyMask;
+		for(i = 0; i < maxThreads; i++)
+		{
+			int winX = (i % 10) * 100, winY = (i / 10) * 120;
+			if((windows[i] = XCreateWindow(dpy, root, winX, winY, 100, 100, 0,
+				vis->depth, InputOutput, vis->visual,
+				CWBorderPixel | CWColormap | CWEventMask, &swa)) == 0)
+				THROW("Could not create window");
+			XMapWindow(dpy, windows[i]);
+			if(!(contexts[i] = glXCreateContext(dpy, vis, NULL, True)))
+				THROW("Could not establish GLX context");
+		}
+		XSync(dpy, False);
+		XFree(vis);  vis = NULL;
+
+		for(int c = 0; c < nCounts; c++)
+		{
+			int nThreads = threadCounts[c];
+			Semaphore ready, go;
+
+			for(i = 0; i < nThreads; i++)
+			{
+				benchThreads[i] = new BenchThread(dpy, windows[i], contexts[i], ready,
+					go);
+				threads[i] = new Thread(benchThreads[i]);
+				if(!benchThreads[i] || !threads[i])
+					PRERROR1("Could not create thread %d", i);
+				threads[i]->start();
+			}
+			for(int b = 0; b < NBENCH; b++)
+			{
+				for(i = 0; i < nThreads; i++) ready.wait();
+				for(i = 0; i < nThreads; i++) go.post();
+			}
+			for(i = 0; i < nThreads; i++) ready.wait();
+			for(i = 0; i < nThreads; i++) threads[i]->stop();
+			for(i = 0; i < nThreads; i++) threads[i]->checkError();
+
+			for(int b = 0; b < NBENCH; b++)
+			{
+				double total = 0.;
+				for(i = 0; i < nThreads; i++) total += benchThreads[i]->elapsed[b];
+				nsPerCall[b][c] = total / (double)nThreads / (double)BENCHCALLS *
+					1000000000.;
+			}
+			for(i = 0; i < nThreads; i++)
+			{
+				delete threads[i];  threads[i] = NULL;
+				delete benchThreads[i];  benchThreads[i] = NULL;
+			}
+		}
+
+		printf("%-26s", "ns/call with N threads:");
+		for(int c = 0; c < nCounts; c++) printf(" %8d", threadCounts[c]);
+		printf("\n");
+		for(int b = 0; b < NBENCH; b++)
+		{
+			printf("%-26s", benchName[b]);
+			for(int c = 0; c < nCounts; c++) printf(" %8.1f", nsPerCall[b][c]);
+			printf("\n");
+		}
+	}
+	catch(Error &e)
+	{
+		printf("Failed! (%s)\n", e.getMessage());  retval = 0;
+	}
+	fflush(stdout);
+
+	for(i = 0; i < maxThreads; i++)
+	{
+		if(threads[i]) { threads[i]->stop();  delete threads[i]; }
+		delete benchThreads[i];
+	}
+	if(vis) { XFree(vis);  vis = NULL; }
+	for(i = 0; i < maxThreads; i++)
+	{
+		if(dpy && contexts[i]) glXDestroyContext(dpy, contexts[i]);
+		if(dpy && windows[i]) XDestroyWindow(dpy, windows[i]);
+	}
+	if(dpy) { XCloseDisplay(dpy);  dpy = NULL; }
+	return retval;
+}
+
+
 void usage(char **argv)
 {
 	fprintf(stderr, "\nUSAGE: %s [options]\n\n", argv[0]);
@@ -2928,6 +3153,11 @@ void usage(char **argv)
 	fprintf(stderr, "              with a double-buffered visual or FB config.\n");
 	fprintf(stderr, "-nocopycontext = Disable glXCopyContext() tests\n");
 	fprintf(stderr, "-selectevent = Enable glXSelectEvent() tests\n");
+	fprintf(stderr, "-bench <n> = Instead of running the unit tests, measure the time per call\n");
+	fprintf(stderr, "             of frequently-called interposed functions using 1, 2, 4, ...\n");
+	fprintf(stderr, "             up to <n> (1 <= <n> <= %d) threads.  Run this with and\n",
+		MAXTHREADS);
+	fprintf(stderr, "             without vglrun in order to measure the faker's overhead.\n");
 	fprintf(stderr, "\n");
 	exit(1);
 }
@@ -2935,7 +3165,7 @@ void usage(char **argv)
 
 int main(int argc, char **argv)
 {
-	int ret = 0, nThreads = DEFTHREADS;
+	int ret = 0, nThreads = DEFTHREADS, benchThreads = 0;
 	bool doStereo = true, doDBPixmap = true, doCopyContext = true,
 		doSelectEvent = false;
 
@@ -2959,6 +3189,11 @@ int main(int argc, char **argv)
 		else if(!strcasecmp(argv[i], "-nodbpixmap")) doDBPixmap = false;
 		else if(!strcasecmp(argv[i], "-nocopycontext")) doCopyContext = false;
 		else if(!strcasecmp(argv[i], "-selectevent")) doSelectEvent = true;
+		else if(!strcasecmp(argv[i], "-bench") && i < argc - 1)
+		{
+			benchThreads = atoi(argv[++i]);
+			if(benchThreads < 1 || benchThreads > MAXTHREADS) usage(argv);
+		}
 		else usage(argv);
 	}
 
@@ -2968,6 +3203,8 @@ int main(int argc, char **argv)
 
 	if(!XInitThreads())
 		THROW("XInitThreads() failed");
+	if(benchThreads)
+		return overheadBenchmark(benchThreads) ? 0 : -1;
 	if(!extensionQueryTest()) ret = -1;
 	printf("\n");
 	if(!procAddrTest()) ret = -1;
@@ -1,6 +1,6 @@
 /* This defines the necessary constants and prototypes for the
-   GL_EXT_framebuffer_object extension, since not all platforms define
-   these (even when the extension is supported) */
+   GL_EXT_framebuffer_object and GL_MESA_pack_invert extensions, since not all
+   platforms define these (even when the extension is supported) */
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,6 +34,10 @@ extern "C" {
 #define GL_RENDERBUFFER_EXT  0x8D41
 #endif
 
+#ifndef GL_PACK_INVERT_MESA
+#define GL_PACK_INVERT_MESA  0x8758
+#endif
+
 #ifndef GL_EXT_framebuffer_object
 extern void glBindFramebufferEXT(GLenum, GLuint);
 extern void glBindRenderbufferEXT(GLenum, GLuint);
@@ -281,7 +281,7 @@ GLXFBConfig *configsFromVisAttribs(const int attribs[], int &level,
 	}
 	glxattribs[j] = None;
 
-	if(fconfig.trace) PRARGAL13(glxattribs);
+	if(fconfig.trace) PRINTAL13(glxattribs);
 
 	return _glXChooseFBConfig(DPY3D, DefaultScreen(DPY3D), glxattribs,
 		&nElements);
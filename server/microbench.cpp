@@ -0,0 +1,511 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+// Microbenchmarks for the inner loops of the image pipeline and the faker's
+// data structures.  All inputs are synthetic, and no X server is required.
+// The results can be written as JSON and compared with microbenchcmp.
+
+#include "Frame.h"
+#include "GenericQ.h"
+#include "Hash.h"
+#include "Thread.h"
+#include "Timer.h"
+#include "vglutil.h"
+#include "fakerconfig.h"
+
+using namespace vglutil;
+using namespace vglcommon;
+using namespace vglserver;
+
+
+#define WIDTH  1920
+#define HEIGHT  1080
+
+static double minTime = 0.2;
+static const char *filter = NULL;
+static bool json = false;
+static int nResults = 0;
+// Prevents the compiler from optimizing away the work being benchmarked
+static void * volatile sink;
+
+
+// Each benchmark performs a fixed amount of work per call to run() and
+// reports its throughput in (units per run) / (seconds per run).
+
+class Benchmark
+{
+	public:
+
+		Benchmark(double unitsPerRun_, const char *unit_) :
+			unitsPerRun(unitsPerRun_), unit(unit_) {}
+		virtual ~Benchmark(void) {}
+		virtual void run(void) = 0;
+
+		double unitsPerRun;
+		const char *unit;
+};
+
+
+static void report(const char *name, Benchmark &b)
+{
+	// Warm up, then run until at least minTime seconds have elapsed.
+	b.run();
+	Timer timer;  int iter = 0;  double elapsed;
+	timer.start();
+	do
+	{
+		b.run();  iter++;
+	} while((elapsed = timer.elapsed()) < minTime);
+	double value = b.unitsPerRun * (double)iter / elapsed / 1000000.;
+
+	if(json)
+		printf("%s\n    { \"name\": \"%s\", \"value\": %.3f, \"unit\": \"M%s/sec\", \"iterations\": %d }",
+			nResults ? "," : "", name, value, b.unit, iter);
+	else
+		printf("%-48s %12.3f M%s/sec\n", name, value, b.unit);
+	fflush(stdout);
+	nResults++;
+}
+
+
+// Fill a frame with a deterministic pattern that has both smooth regions and
+// noise, so that it is neither trivial nor incompressible for JPEG.
+
+static void initFrame(Frame &f, int w, int h, int format, bool bottomUp,
+	bool stereo = false)
+{
+	rrframeheader hdr;
+	memset(&hdr, 0, sizeof(rrframeheader));
+	hdr.width = hdr.framew = w;  hdr.height = hdr.frameh = h;
+	hdr.qual = 95;  hdr.subsamp = 4;  hdr.compress = RRCOMP_JPEG;
+	f.init(hdr, format, bottomUp ? FRAME_BOTTOMUP : 0, stereo);
+
+	unsigned int seed = 1;
+	for(int eye = 0; eye < (stereo ? 2 : 1); eye++)
+	{
+		unsigned char *bits = eye ? f.rbits : f.bits;
+		for(int y = 0; y < h; y++)
+		{
+			for(int x = 0; x < w; x++)
+			{
+				seed = seed * 1103515245 + 12345;
+				int noise = (seed >> 16) & 15;
+				unsigned char *pixel = &bits[f.pitch * y + x * f.pf->size];
+				if(f.pf->id == PF_COMP)
+					*pixel = (x + y + noise) & 0xFF;
+				else
+					f.pf->setRGB(pixel, (x * 255 / w + noise) & 0xFF,
+						(y * 255 / h + noise) & 0xFF, ((x ^ y) + eye * 64) & 0xFF);
+			}
+		}
+	}
+}
+
+
+class PFConvert : public Benchmark
+{
+	public:
+
+		PFConvert(int srcFormat, int dstFormat) : Benchmark(WIDTH * HEIGHT, "pixels")
+		{
+			initFrame(src, WIDTH, HEIGHT, srcFormat, false);
+			initFrame(dst, WIDTH, HEIGHT, dstFormat, false);
+		}
+
+		void run(void)
+		{
+			src.pf->convert(src.bits, WIDTH, src.pitch, HEIGHT, dst.bits, dst.pitch,
+				dst.pf);
+		}
+
+	private:
+
+		Frame src, dst;
+};
+
+
+class TileEquals : public Benchmark
+{
+	public:
+
+		TileEquals(int tileSize_, bool differ) :
+			Benchmark(WIDTH * HEIGHT, "pixels"), tileSize(tileSize_)
+		{
+			initFrame(frame, WIDTH, HEIGHT, PF_BGRX, true);
+			initFrame(last, WIDTH, HEIGHT, PF_BGRX, true);
+			// Make the first row of every tile differ, which is the best case.
+			// Otherwise, every tile is unchanged, which is the worst case.
+			if(differ)
+			{
+				for(int y = 0; y < HEIGHT; y += tileSize)
+					for(int x = 0; x < WIDTH; x++)
+						last.bits[last.pitch * (HEIGHT - 1 - y) + x * 4] ^= 0xFF;
+			}
+		}
+
+		void run(void)
+		{
+			for(int y = 0; y < HEIGHT; y += tileSize)
+			{
+				int h = min(tileSize, HEIGHT - y);
+				for(int x = 0; x < WIDTH; x += tileSize)
+					frame.tileEquals(&last, x, y, min(tileSize, WIDTH - x), h);
+			}
+		}
+
+	private:
+
+		Frame frame, last;
+		int tileSize;
+};
+
+
+class Anaglyph : public Benchmark
+{
+	public:
+
+		Anaglyph(int format) : Benchmark(WIDTH * HEIGHT, "pixels")
+		{
+			initFrame(dst, WIDTH, HEIGHT, format, false);
+			initFrame(r, WIDTH, HEIGHT, PF_COMP, false);
+			initFrame(g, WIDTH, HEIGHT, PF_COMP, false);
+			initFrame(b, WIDTH, HEIGHT, PF_COMP, false);
+		}
+
+		void run(void) { dst.makeAnaglyph(r, g, b); }
+
+	private:
+
+		Frame dst, r, g, b;
+};
+
+
+class Passive : public Benchmark
+{
+	public:
+
+		Passive(int format, int mode_) :
+			Benchmark(WIDTH * HEIGHT, "pixels"), mode(mode_)
+		{
+			initFrame(dst, WIDTH, HEIGHT, format, false);
+			initFrame(stf, WIDTH, HEIGHT, format, false, true);
+		}
+
+		void run(void) { dst.makePassive(stf, mode); }
+
+	private:
+
+		Frame dst, stf;
+		int mode;
+};
+
+
+class JPEGCompress : public Benchmark
+{
+	public:
+
+		JPEGCompress(int tileSize_, int subsamp) :
+			Benchmark(WIDTH * HEIGHT, "pixels"), tileSize(tileSize_)
+		{
+			initFrame(frame, WIDTH, HEIGHT, PF_BGRX, true);
+			frame.hdr.subsamp = subsamp;
+		}
+
+		// Same tiling algorithm as the VGL Transport
+		void run(void)
+		{
+			int tileW = tileSize ? tileSize : WIDTH,
+				tileH = tileSize ? tileSize : HEIGHT;
+			for(int i = 0; i < HEIGHT; i += tileH)
+			{
+				int h = tileH, y = i;
+				if(HEIGHT - i < (3 * tileH / 2)) { h = HEIGHT - i;  i += tileH; }
+				for(int j = 0; j < WIDTH; j += tileW)
+				{
+					int w = tileW, x = j;
+					if(WIDTH - j < (3 * tileW / 2)) { w = WIDTH - j;  j += tileW; }
+					Frame *tile = frame.getTile(x, y, w, h);
+					cframe = *tile;
+					delete tile;
+				}
+			}
+		}
+
+	private:
+
+		Frame frame;
+		CompressedFrame cframe;
+		int tileSize;
+};
+
+
+// Same loops as VirtualWin::readPixels()
+
+class Gamma : public Benchmark
+{
+	public:
+
+		Gamma(int format) : Benchmark(WIDTH * HEIGHT, "pixels")
+		{
+			initFrame(frame, WIDTH, HEIGHT, format, false);
+			fconfig_setgamma(fc, 2.22);
+		}
+
+		void run(void)
+		{
+			PF *pf = frame.pf;  int pitch = frame.pitch;
+			unsigned char *bits = frame.bits;
+
+			if(pf->bpc == 10)
+			{
+				int h = HEIGHT;
+				while(h--)
+				{
+					int w = WIDTH;
+					unsigned int *srcPixel = (unsigned int *)bits;
+					while(w--)
+					{
+						unsigned int r = fc.gamma_lut10[(*srcPixel >> pf->rshift) & 1023];
+						unsigned int g = fc.gamma_lut10[(*srcPixel >> pf->gshift) & 1023];
+						unsigned int b = fc.gamma_lut10[(*srcPixel >> pf->bshift) & 1023];
+						*srcPixel++ =
+							(r << pf->rshift) | (g << pf->gshift) | (b << pf->bshift);
+					}
+					bits += pitch;
+				}
+			}
+			else
+			{
+				unsigned short *ptr1, *ptr2 =
+					(unsigned short *)(&bits[pitch * HEIGHT]);
+				for(ptr1 = (unsigned short *)bits; ptr1 < ptr2; ptr1++)
+					*ptr1 = fc.gamma_lut16[*ptr1];
+				if((pitch * HEIGHT) % 2 != 0)
+					bits[pitch * HEIGHT - 1] = fc.gamma_lut[bits[pitch * HEIGHT - 1]];
+			}
+		}
+
+	private:
+
+		Frame frame;
+		static FakerConfig fc;
+};
+
+FakerConfig Gamma::fc;
+
+
+#define ITEMS  10000
+
+class QueueConsumer : public Runnable
+{
+	public:
+
+		QueueConsumer(GenericQ &q_) : q(q_) {}
+
+	private:
+
+		void run(void)
+		{
+			void *item;
+			for(int i = 0; i < ITEMS; i++) q.get(&item);
+		}
+
+		GenericQ &q;
+};
+
+
+// Hands off ITEMS items from a producer thread to a consumer thread, as the
+// transports do with frames
+
+class QueueHandoff : public Benchmark
+{
+	public:
+
+		QueueHandoff(void) : Benchmark(ITEMS, "items"), consumer(q) {}
+
+		void run(void)
+		{
+			Thread thread(&consumer);
+			thread.start();
+			for(long i = 1; i <= ITEMS; i++) q.add((void *)i);
+			thread.stop();
+			thread.checkError();
+		}
+
+	private:
+
+		GenericQ q;
+		QueueConsumer consumer;
+};
+
+
+class TestHash : public Hash<char *, unsigned long, void *>
+{
+	public:
+
+		TestHash(void) {}
+		~TestHash(void) { TestHash::kill(); }
+		void add(char *key1, unsigned long key2)
+		{
+			Hash::add(key1, key2, (void *)1);
+		}
+		void *find(char *key1, unsigned long key2)
+		{
+			return Hash::find(key1, key2);
+		}
+
+	private:
+
+		void detach(HashEntry *entry) {}
+
+		// Same comparison as WindowHash
+		bool compare(char *key1, unsigned long key2, HashEntry *entry)
+		{
+			return key1 && !strcasecmp(key1, entry->key1) && key2 == entry->key2;
+		}
+};
+
+
+#define LOOKUPS  10000
+
+class HashFind : public Benchmark
+{
+	public:
+
+		HashFind(int entries, bool hit) : Benchmark(LOOKUPS, "lookups")
+		{
+			for(int i = 0; i < entries; i++) hash.add(dpyString, i + 1);
+			// Look up the most recently added entry (the worst case for a hit), or
+			// an entry that doesn't exist.
+			key2 = hit ? entries : entries + 1;
+		}
+
+		void run(void)
+		{
+			// The faker looks up display strings that are stored elsewhere, so the
+			// direct (pointer) match rarely succeeds.
+			void *value = NULL;
+			for(int i = 0; i < LOOKUPS; i++)
+			{
+				value = hash.find(lookupString, key2);  sink = value;
+			}
+		}
+
+	private:
+
+		TestHash hash;
+		static char dpyString[], lookupString[];
+		unsigned long key2;
+};
+
+char HashFind::dpyString[] = "localhost:10.0",
+	HashFind::lookupString[] = "localhost:10.0";
+
+
+void usage(char **argv)
+{
+	fprintf(stderr, "\nUSAGE: %s [options]\n\n", argv[0]);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-json = Write the results as JSON (for use with microbenchcmp)\n");
+	fprintf(stderr, "-time <t> = Run each benchmark for at least <t> seconds (default: %.1f)\n",
+		minTime);
+	fprintf(stderr, "-filter <s> = Run only the benchmarks whose names contain <s>\n\n");
+	exit(1);
+}
+
+
+#define RUN(b, ...) \
+{ \
+	char name[256]; \
+	snprintf(name, 256, __VA_ARGS__); \
+	if(!filter || strstr(name, filter)) \
+	{ \
+		b;  report(name, bench); \
+	} \
+}
+
+
+int main(int argc, char **argv)
+{
+	int retval = 0;
+	static const int tileSizes[] = { 64, 128, 256, 512, 0 };
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!stricmp(argv[i], "-json")) json = true;
+		else if(!stricmp(argv[i], "-time") && i < argc - 1)
+		{
+			minTime = atof(argv[++i]);  if(minTime <= 0.) usage(argv);
+		}
+		else if(!stricmp(argv[i], "-filter") && i < argc - 1) filter = argv[++i];
+		else usage(argv);
+	}
+
+	try
+	{
+		if(json) printf("{\n  \"benchmarks\": [");
+
+		for(int src = 0; src < PIXELFORMATS - 1; src++)
+			for(int dst = 0; dst < PIXELFORMATS - 1; dst++)
+				RUN(PFConvert bench(src, dst), "pf_convert/%s/%s", pf_get(src)->name,
+					pf_get(dst)->name);
+
+		for(int i = 0; i < 4; i++)
+		{
+			RUN(TileEquals bench(tileSizes[i], false), "tileEquals/equal/%d",
+				tileSizes[i]);
+			RUN(TileEquals bench(tileSizes[i], true), "tileEquals/differ/%d",
+				tileSizes[i]);
+		}
+
+		RUN(Anaglyph bench(PF_RGB), "makeAnaglyph/RGB");
+		RUN(Anaglyph bench(PF_BGRX), "makeAnaglyph/BGRX");
+		RUN(Passive bench(PF_BGRX, RRSTEREO_INTERLEAVED),
+			"makePassive/interleaved/BGRX");
+		RUN(Passive bench(PF_BGRX, RRSTEREO_TOPBOTTOM),
+			"makePassive/topbottom/BGRX");
+		RUN(Passive bench(PF_BGRX, RRSTEREO_SIDEBYSIDE),
+			"makePassive/sidebyside/BGRX");
+
+		for(int i = 0; i < 5; i++)
+		{
+			char tileSize[16] = "frame";
+			if(tileSizes[i]) snprintf(tileSize, 16, "%d", tileSizes[i]);
+			RUN(JPEGCompress bench(tileSizes[i], 4), "compressJPEG/420/%s",
+				tileSize);
+			RUN(JPEGCompress bench(tileSizes[i], 1), "compressJPEG/444/%s",
+				tileSize);
+		}
+
+		RUN(Gamma bench(PF_BGRX), "gamma/BGRX");
+		RUN(Gamma bench(PF_RGB), "gamma/RGB");
+		RUN(Gamma bench(PF_X2_BGR10), "gamma/X2_BGR10");
+
+		RUN(QueueHandoff bench, "GenericQ/handoff");
+
+		for(int entries = 1; entries <= 64; entries *= 4)
+		{
+			RUN(HashFind bench(entries, true), "Hash/find/hit/%d", entries);
+			RUN(HashFind bench(entries, false), "Hash/find/miss/%d", entries);
+		}
+
+		if(json) printf("\n  ]\n}\n");
+	}
+	catch(Error &e)
+	{
+		if(json) printf("\n  ]\n}\n");
+		fprintf(stderr, "%s--\n%s\n", e.getMethod(), e.getMessage());
+		retval = -1;
+	}
+
+	return retval;
+}
@@ -15,6 +15,7 @@
 #include <X11/Xlib.h>
 #include "rrtransport.h"
 #include "VGLTrans.h"
+#include "fakerstats.h"
 
 using namespace vglutil;
 using namespace vglcommon;
@@ -40,6 +41,7 @@ static const int pf2trans[PIXELFORMATS] =
 
 
 FakerConfig *fconfig_getinstance(void) { return fconfig; }
+FakerStats *fstats_getinstance(void) { return NULL; }
 
 
 // This just wraps the VGLTrans class in order to demonstrate how to build a
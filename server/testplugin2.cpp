@@ -15,6 +15,7 @@
 #include <X11/Xlib.h>
 #include "rrtransport.h"
 #include "X11Trans.h"
+#include "fakerstats.h"
 
 using namespace vglutil;
 using namespace vglcommon;
@@ -36,6 +37,7 @@ static const int pf2trans[PIXELFORMATS] =
 
 
 FakerConfig *fconfig_getinstance(void) { return fconfig; }
+FakerStats *fstats_getinstance(void) { return NULL; }
 
 
 // This just wraps the X11Trans class in order to demonstrate how to
@@ -0,0 +1,208 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+// Feeds frames that were captured by the VirtualGL Faker (using VGL_CAPTURE)
+// through the VGL Transport as fast as possible
+
+#include "VGLTrans.h"
+#include "FrameCapture.h"
+#include "vglutil.h"
+#include "Timer.h"
+#include "fakerconfig.h"
+
+using namespace vglutil;
+using namespace vglcommon;
+using namespace vglserver;
+
+
+void usage(char **argv)
+{
+	fprintf(stderr, "\nUSAGE: %s <capture file> [options]\n\n", argv[0]);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-client <hostname or IP> = Hostname or IP address where the frames should be\n");
+	fprintf(stderr, "                           sent (the VirtualGL Client must be running on that\n");
+	fprintf(stderr, "                           machine) or 0 to compress the frames and discard\n");
+	fprintf(stderr, "                           them (default: 0)\n");
+	fprintf(stderr, "-port <p> = TCP port on which the VirtualGL Client is listening\n");
+	fprintf(stderr, "            (default: %d)\n",
+		fconfig.port < 0 ? (fconfig.ssl ? RR_DEFAULTSSLPORT : RR_DEFAULTPORT) :
+		fconfig.port);
+	fprintf(stderr, "-c <c> = Compression type: jpeg, rgb, yuv, or lossless\n");
+	fprintf(stderr, "         (default: jpeg)\n");
+	fprintf(stderr, "-samp <s> = JPEG chrominance subsampling factor: 0 (gray), 1, 2, or 4\n");
+	fprintf(stderr, "            (default: %d)\n", fconfig.subsamp);
+	fprintf(stderr, "-qual <q> = JPEG quality, 1 <= <q> <= 100 (default: %d)\n",
+		fconfig.qual);
+	fprintf(stderr, "-tilesize <n> = Width/height of each multithreaded compression/interframe\n");
+	fprintf(stderr, "                comparison tile (default: %d x %d pixels)\n",
+		fconfig.tilesize, fconfig.tilesize);
+	fprintf(stderr, "-nointerframe = Disable interframe comparison\n");
+	#ifdef USESSL
+	fprintf(stderr, "-ssl = Use SSL tunnel (default: %s)\n",
+		fconfig.ssl ? "On" : "Off");
+	#endif
+	fprintf(stderr, "-np <n> = Number of threads to use for compression (default: %d)\n",
+		fconfig.np);
+	fprintf(stderr, "-loops <n> = Replay the capture <n> times (default: 1)\n\n");
+	exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+	Timer timer;  double elapsed;
+	Display *dpy = NULL;  Window win = 0;
+	int i, retval = 0, loops = 1;
+	CaptureReader *reader = NULL;
+
+	try
+	{
+		fconfig_setcompress(fconfig, RRCOMP_JPEG);
+
+		bool localtest = true;
+		if(argc < 2) usage(argv);
+		if(!stricmp(argv[1], "-h") || !strcmp(argv[1], "-?")) usage(argv);
+
+		if(argc > 2) for(i = 2; i < argc; i++)
+		{
+			if(!stricmp(argv[i], "-h") || !strcmp(argv[i], "-?")) usage(argv);
+			#ifdef USESSL
+			else if(!stricmp(argv[i], "-ssl")) fconfig.ssl = 1;
+			#endif
+			else if(!stricmp(argv[i], "-client") && i < argc - 1)
+			{
+				strncpy(fconfig.client, argv[++i], MAXSTR - 1);
+				localtest = !stricmp(fconfig.client, "0");
+				if(localtest) fconfig.client[0] = 0;
+			}
+			else if(!stricmp(argv[i], "-port") && i < argc - 1)
+			{
+				fconfig.port = atoi(argv[++i]);
+			}
+			else if(!stricmp(argv[i], "-c") && i < argc - 1)
+			{
+				i++;
+				if(!stricmp(argv[i], "jpeg")) fconfig_setcompress(fconfig, RRCOMP_JPEG);
+				else if(!stricmp(argv[i], "rgb"))
+					fconfig_setcompress(fconfig, RRCOMP_RGB);
+				else if(!stricmp(argv[i], "yuv"))
+					fconfig_setcompress(fconfig, RRCOMP_YUV);
+				else if(!stricmp(argv[i], "lossless"))
+					fconfig_setcompress(fconfig, RRCOMP_LOSSLESS);
+				else usage(argv);
+			}
+			else if(!stricmp(argv[i], "-samp") && i < argc - 1)
+			{
+				fconfig.subsamp = atoi(argv[++i]);
+			}
+			else if(!stricmp(argv[i], "-qual") && i < argc - 1)
+			{
+				fconfig.qual = atoi(argv[++i]);
+			}
+			else if(!stricmp(argv[i], "-tilesize") && i < argc - 1)
+			{
+				fconfig.tilesize = atoi(argv[++i]);
+			}
+			else if(!stricmp(argv[i], "-nointerframe")) fconfig.interframe = 0;
+			else if(!stricmp(argv[i], "-np") && i < argc - 1)
+			{
+				fconfig.np = atoi(argv[++i]);
+			}
+			else if(!stricmp(argv[i], "-loops") && i < argc - 1)
+			{
+				loops = atoi(argv[++i]);  if(loops < 1) usage(argv);
+			}
+			else usage(argv);
+		}
+
+		NEWCHECK(reader = new CaptureReader(argv[1]));
+
+		// Scan the capture in order to size the window and report its contents
+		CaptureRecord *rec;  int frames = 0, uniqueFrames = 0, w = 0, h = 0;
+		double duration = 0.0, pixels = 0.0;
+		while((rec = reader->next(NULL)) != NULL)
+		{
+			frames++;  if(rec->size) uniqueFrames++;
+			w = max(w, rec->width);  h = max(h, rec->height);
+			duration = rec->time;  pixels += (double)rec->width * rec->height;
+		}
+		if(frames < 1) THROW("Capture file contains no frames");
+		printf("Capture: %d frames (%d unique), max. %d x %d, %.2f seconds\n",
+			frames, uniqueFrames, w, h, duration);
+
+		if(!localtest)
+		{
+			if(!XInitThreads()) THROW("Could not initialize X threads");
+			if((dpy = XOpenDisplay(0)) == NULL) THROW("Could not open display");
+			if((win = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, w, h, 0,
+				WhitePixel(dpy, DefaultScreen(dpy)),
+				BlackPixel(dpy, DefaultScreen(dpy)))) == 0)
+				THROW("Could not create window");
+			ERRIFNOT(XMapRaised(dpy, win));
+			XSync(dpy, False);
+			if(strlen(fconfig.client) == 0)
+				strncpy(fconfig.client, DisplayString(dpy), MAXSTR - 1);
+			fconfig_setdefaultsfromdpy(dpy);
+		}
+
+		VGLTrans vglconn;
+		if(!localtest) vglconn.connect(fconfig.client, fconfig.port);
+		else vglconn.connectNull();
+
+		timer.start();
+		for(int loop = 0; loop < loops; loop++)
+		{
+			unsigned char *bits = NULL;
+
+			reader->rewind();
+			while((rec = reader->next(&bits)) != NULL)
+			{
+				Frame *f;
+				PF *pf = pf_get(rec->format);
+				int pixelFormat = rec->format, rowSize = rec->width * pf->size;
+
+				// The RGB encoder requires an RGB frame, so convert other formats.
+				if(fconfig.compress == RRCOMP_RGB) pixelFormat = PF_RGB;
+
+				vglconn.synchronize();
+				ERRIFNOT(f = vglconn.getFrame(rec->width, rec->height, pixelFormat,
+					rec->flags, false));
+				if(pixelFormat == rec->format)
+				{
+					for(int y = 0; y < rec->height; y++)
+						memcpy(&f->bits[f->pitch * y], &bits[rowSize * y], rowSize);
+				}
+				else
+					pf->convert(bits, rec->width, rowSize, rec->height, f->bits,
+						f->pitch, f->pf);
+				f->hdr.qual = fconfig.qual;  f->hdr.subsamp = fconfig.subsamp;
+				f->hdr.winid = win;  f->hdr.compress = fconfig.compress;
+				vglconn.sendFrame(f);
+			}
+		}
+		vglconn.synchronize();
+		elapsed = timer.elapsed();
+
+		printf("%f frames/sec\n", (double)(frames * loops) / elapsed);
+		printf("%f Megapixels/sec\n", pixels * loops / 1000000. / elapsed);
+	}
+	catch(Error &e)
+	{
+		printf("%s--\n%s\n", e.getMethod(), e.getMessage());
+		retval = -1;
+	}
+
+	delete reader;
+	if(win) XDestroyWindow(dpy, win);
+	if(dpy) XCloseDisplay(dpy);
+	return retval;
+}
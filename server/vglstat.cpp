@@ -0,0 +1,240 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+// Displays live statistics from running VirtualGL Faker processes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/shm.h>
+#include "Error.h"
+#include "Log.h"
+#include "vglutil.h"
+#include "fakerstats.h"
+
+using namespace vglutil;
+
+
+#define MAXSEGS  256
+
+typedef struct
+{
+	int shmid;
+	FakerStats *fs;
+	FakerStats last;
+	double lastTime;
+	bool seen;
+} Segment;
+
+static Segment segs[MAXSEGS];
+static int nSegs = 0;
+static int shmidArg = -1, pidArg = -1;
+
+
+void usage(char **argv)
+{
+	vglout.print("\nUSAGE: %s [options]\n\n", argv[0]);
+	vglout.print("Options:\n");
+	vglout.print("-shmid <s> = Monitor only the VirtualGL Faker process whose statistics are\n");
+	vglout.print("             stored in shared memory segment <s> (reported by the\n");
+	vglout.print("             VirtualGL Faker when the environment variable VGL_VERBOSE\n");
+	vglout.print("             is set to 1)\n");
+	vglout.print("-pid <p> = Monitor only process <p>\n");
+	vglout.print("-i <t> = Update the statistics every <t> seconds (default: 1.0)\n");
+	vglout.print("-n <n> = Exit after <n> updates\n\n");
+	#ifdef __linux__
+	vglout.print("By default, all VirtualGL Faker processes that the current user can access\n");
+	vglout.print("are monitored.\n\n");
+	#else
+	vglout.print("On this platform, -shmid must be specified.\n\n");
+	#endif
+	exit(1);
+}
+
+
+static void attach(int shmid)
+{
+	for(int i = 0; i < nSegs; i++)
+	{
+		if(segs[i].shmid == shmid)
+		{
+			segs[i].seen = true;  return;
+		}
+	}
+	if(nSegs >= MAXSEGS) return;
+
+	FakerStats *fs = (FakerStats *)shmat(shmid, 0, SHM_RDONLY);
+	if(fs == (FakerStats *)-1 || !fs) return;
+	if(fs->magic != FSTATS_MAGIC || fs->version != FSTATS_VERSION
+		|| (pidArg > 0 && fs->pid != pidArg))
+	{
+		shmdt((char *)fs);  return;
+	}
+	Segment &seg = segs[nSegs++];
+	seg.shmid = shmid;  seg.fs = fs;  seg.seen = true;
+	memcpy(&seg.last, fs, sizeof(FakerStats));
+	seg.lastTime = GetTime();
+}
+
+
+// Find the shared memory segments that are the size of a FakerStats structure
+// and contain the expected magic number.
+
+static void scan(void)
+{
+	for(int i = 0; i < nSegs; i++) segs[i].seen = false;
+
+	if(shmidArg >= 0) attach(shmidArg);
+	#ifdef __linux__
+	else
+	{
+		FILE *file = fopen("/proc/sysvipc/shm", "r");
+		if(!file) THROW_UNIX();
+		char line[1024];
+		// Skip the header
+		if(fgets(line, 1024, file))
+		{
+			while(fgets(line, 1024, file))
+			{
+				long key, shmid, perms;  unsigned long size;
+				if(sscanf(line, "%ld %ld %lo %lu", &key, &shmid, &perms, &size) == 4
+					&& size == sizeof(FakerStats))
+					attach((int)shmid);
+			}
+		}
+		fclose(file);
+	}
+	#endif
+
+	// Detach from the segments of processes that have exited
+	for(int i = 0; i < nSegs; i++)
+	{
+		if(!segs[i].seen
+			|| (kill(segs[i].fs->pid, 0) == -1 && errno == ESRCH))
+		{
+			shmdt((char *)segs[i].fs);
+			segs[i] = segs[--nSegs];  i--;
+		}
+	}
+}
+
+
+static double rate(long long cur, long long last, double elapsed)
+{
+	return elapsed > 0. ? (double)(cur - last) / elapsed : 0.;
+}
+
+
+static double avgMS(FakerStats &cur, FakerStats &last, int stage)
+{
+	long long count = cur.stageCount[stage] - last.stageCount[stage];
+	if(count <= 0) return 0.;
+	return (double)(cur.stageTime[stage] - last.stageTime[stage]) /
+		(double)count / 1000.;
+}
+
+
+static void update(bool clear)
+{
+	FakerStats cur[MAXSEGS];  double elapsed[MAXSEGS], readRate[MAXSEGS];
+	int order[MAXSEGS];
+
+	for(int i = 0; i < nSegs; i++)
+	{
+		double now = GetTime();
+		memcpy(&cur[i], segs[i].fs, sizeof(FakerStats));
+		elapsed[i] = now - segs[i].lastTime;  segs[i].lastTime = now;
+		readRate[i] = rate(cur[i].framesRead, segs[i].last.framesRead,
+			elapsed[i]);
+		// Sort by readback rate, so the busiest processes are listed first
+		int j = i;
+		while(j > 0 && readRate[order[j - 1]] < readRate[i])
+		{
+			order[j] = order[j - 1];  j--;
+		}
+		order[j] = i;
+	}
+
+	if(clear) printf("\033[H\033[2J");
+	printf("%7s %-16s %7s %7s %7s %7s %7s %5s %8s %8s %8s %8s\n", "PID",
+		"PROGRAM", "READ/s", "SPOIL/s", "SENT/s", "Mpix/s", "Mbit/s", "QUEUE",
+		"READBACK", "COMPRESS", "SEND", "BLIT");
+	for(int k = 0; k < nSegs; k++)
+	{
+		int i = order[k];  FakerStats &c = cur[i], &l = segs[i].last;
+		printf("%7d %-16.16s %7.1f %7.1f %7.1f %7.2f %7.2f %5lld %8.2f %8.2f %8.2f %8.2f\n",
+			c.pid, c.progName, readRate[i],
+			rate(c.framesSpoiled, l.framesSpoiled, elapsed[i]),
+			rate(c.framesSent, l.framesSent, elapsed[i]),
+			rate(c.pixelsSent, l.pixelsSent, elapsed[i]) / 1000000.,
+			rate(c.bytesSent, l.bytesSent, elapsed[i]) * 8. / 1000000.,
+			c.queueDepth, avgMS(c, l, FSTATS_READBACK),
+			avgMS(c, l, FSTATS_COMPRESS), avgMS(c, l, FSTATS_SEND),
+			avgMS(c, l, FSTATS_BLIT));
+		memcpy(&l, &c, sizeof(FakerStats));
+	}
+	if(clear) printf("\n(stage times are in milliseconds per frame)\n");
+	fflush(stdout);
+}
+
+
+int main(int argc, char **argv)
+{
+	double interval = 1.0;  int count = -1, status = 0;
+
+	try
+	{
+		for(int i = 1; i < argc; i++)
+		{
+			if(!stricmp(argv[i], "-shmid") && i < argc - 1)
+			{
+				shmidArg = atoi(argv[++i]);  if(shmidArg < 0) usage(argv);
+			}
+			else if(!stricmp(argv[i], "-pid") && i < argc - 1)
+			{
+				pidArg = atoi(argv[++i]);  if(pidArg <= 0) usage(argv);
+			}
+			else if(!stricmp(argv[i], "-i") && i < argc - 1)
+			{
+				interval = atof(argv[++i]);  if(interval <= 0.) usage(argv);
+			}
+			else if(!stricmp(argv[i], "-n") && i < argc - 1)
+			{
+				count = atoi(argv[++i]);  if(count < 1) usage(argv);
+			}
+			else usage(argv);
+		}
+		#ifndef __linux__
+		if(shmidArg < 0) usage(argv);
+		#endif
+
+		bool clear = isatty(fileno(stdout));
+		scan();
+		while(count < 0 || count-- > 0)
+		{
+			usleep((useconds_t)(interval * 1000000.));
+			update(clear);
+			scan();
+		}
+	}
+	catch(Error &e)
+	{
+		vglout.print("Error in vglstat--\n%s\n", e.getMessage());
+		status = -1;
+	}
+	for(int i = 0; i < nSegs; i++) shmdt((char *)segs[i].fs);
+	return status;
+}
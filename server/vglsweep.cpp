@@ -0,0 +1,656 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+// Compresses frames that were captured by the VirtualGL Faker (using
+// VGL_CAPTURE) with a range of image transport settings and reports the
+// bandwidth, compression time, and image quality of each combination, along
+// with the combinations that are Pareto-optimal (no other combination is
+// smaller, faster, and of higher quality.)
+
+#include <math.h>
+#include "FrameCapture.h"
+#include "Frame.h"
+#include "TileCache.h"
+#include "TileEncoder.h"
+#include "Tiler.h"
+#include "Timer.h"
+#include "vglutil.h"
+#include "rr.h"
+
+using namespace vglutil;
+using namespace vglcommon;
+using namespace vglserver;
+
+
+#define MAXVALUES  32
+
+typedef struct
+{
+	int values[MAXVALUES];  int n;
+} List;
+
+typedef struct
+{
+	int compress, qual, subsamp, tileSize, minTileSize, np, interframe,
+		adaptive;
+	double bytes, time, psnr, ssim;  // Per-frame averages (time in ms)
+	bool pareto;
+} Result;
+
+static Result *results = NULL;
+static int nResults = 0, maxResults = 0;
+
+static List comps, quals, samps, tileSizes, minTileSizes, nps, interframes,
+	adaptives;
+static int maxFrames = -1, tileCacheSize = RR_DEFAULTTILECACHE;
+static bool csv = false;
+
+static const char *compName[] = { "", "JPEG", "RGB", "", "YUV",
+	"LOSSLESS" };
+
+
+void usage(char **argv)
+{
+	fprintf(stderr, "\nUSAGE: %s <capture file> [options]\n\n", argv[0]);
+	fprintf(stderr, "Each option takes a comma-separated list of values to sweep.\n\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "-c <c> = Compression types: jpeg, rgb, yuv, lossless\n");
+	fprintf(stderr, "         (default: jpeg,yuv)\n");
+	fprintf(stderr, "-qual <q> = JPEG qualities (default: 30,50,70,80,90,95)\n");
+	fprintf(stderr, "-samp <s> = JPEG chrominance subsampling factors: 0 (gray), 1, 2, 4\n");
+	fprintf(stderr, "            (default: 1,2,4)\n");
+	fprintf(stderr, "-tilesize <n> = Tile sizes (default: 128,256,512)\n");
+	fprintf(stderr, "-mintilesize <n> = Minimum tile sizes for adaptive tiling, or 0 to use fixed\n");
+	fprintf(stderr, "                   tiling (default: %d)\n", RR_DEFAULTMINTILESIZE);
+	fprintf(stderr, "-np <n> = Numbers of compression threads (default: 1,2,4)\n");
+	fprintf(stderr, "-interframe <i> = Interframe comparison off/on: 0, 1 (default: 0,1)\n");
+	fprintf(stderr, "-adaptive <a> = Content-adaptive tile encoding off/on: 0, 1 (default: 0)\n");
+	fprintf(stderr, "-tilecache <n> = Size (in megabytes) of the client's tile cache, or 0 to\n");
+	fprintf(stderr, "                 disable it (default: %d)\n", RR_DEFAULTTILECACHE);
+	fprintf(stderr, "-frames <n> = Use only the first <n> frames of the capture\n");
+	fprintf(stderr, "-csv = Print all results as comma-separated values\n\n");
+	fprintf(stderr, "Compression times for JPEG, RGB, and lossless are estimated by assigning tiles to\n");
+	fprintf(stderr, "threads in the same way as the VGL Transport and taking the busiest\n");
+	fprintf(stderr, "thread's total.  YUV frames are encoded as a whole, so their times are\n");
+	fprintf(stderr, "measured using the multithreaded YUV encoder.\n\n");
+	exit(1);
+}
+
+
+static void parseList(List &list, char *arg, char **argv)
+{
+	char *ptr = arg, *end;
+
+	list.n = 0;
+	while(*ptr)
+	{
+		if(list.n >= MAXVALUES) usage(argv);
+		if(!strncasecmp(ptr, "jpeg", 4))
+		{
+			list.values[list.n++] = RRCOMP_JPEG;  end = ptr + 4;
+		}
+		else if(!strncasecmp(ptr, "rgb", 3))
+		{
+			list.values[list.n++] = RRCOMP_RGB;  end = ptr + 3;
+		}
+		else if(!strncasecmp(ptr, "lossless", 8))
+		{
+			list.values[list.n++] = RRCOMP_LOSSLESS;  end = ptr + 8;
+		}
+		else if(!strncasecmp(ptr, "yuv", 3))
+		{
+			list.values[list.n++] = RRCOMP_YUV;  end = ptr + 3;
+		}
+		else
+		{
+			list.values[list.n++] = strtol(ptr, &end, 10);
+			if(end == ptr) usage(argv);
+		}
+		if(*end == ',') end++;
+		else if(*end) usage(argv);
+		ptr = end;
+	}
+	if(list.n < 1) usage(argv);
+}
+
+
+static void setList(List &list, int n, const int *values)
+{
+	list.n = n;
+	for(int i = 0; i < n; i++) list.values[i] = values[i];
+}
+
+
+static Result &addResult(void)
+{
+	if(nResults >= maxResults)
+	{
+		maxResults = maxResults ? maxResults * 2 : 64;
+		Result *temp = (Result *)realloc(results, sizeof(Result) * maxResults);
+		if(!temp) THROW("Memory allocation error");
+		results = temp;
+	}
+	memset(&results[nResults], 0, sizeof(Result));
+	return results[nResults++];
+}
+
+
+// Decode a 4:2:0 YUV image in the plane layout produced by
+// CompressedFrame::compressYUV() into a top-down RGB image, using the same
+// color conversion as JPEG
+
+static void decodeYUV(unsigned char *yuv, int width, int height,
+	unsigned char *rgb)
+{
+	int ypitch = TJPAD(width), cpitch = TJPAD((width + 1) / 2);
+	int ch = (height + 1) / 2;
+	unsigned char *yplane = yuv, *uplane = &yuv[ypitch * ch * 2],
+		*vplane = &yuv[ypitch * ch * 2 + cpitch * ch];
+
+	for(int j = 0; j < height; j++)
+	{
+		for(int i = 0; i < width; i++, rgb += 3)
+		{
+			double y = yplane[ypitch * j + i],
+				cb = (double)uplane[cpitch * (j / 2) + i / 2] - 128.,
+				cr = (double)vplane[cpitch * (j / 2) + i / 2] - 128.;
+			double r = y + 1.402 * cr, g = y - 0.34414 * cb - 0.71414 * cr,
+				b = y + 1.772 * cb;
+			rgb[0] = (unsigned char)max(0., min(255., r + 0.5));
+			rgb[1] = (unsigned char)max(0., min(255., g + 0.5));
+			rgb[2] = (unsigned char)max(0., min(255., b + 0.5));
+		}
+	}
+}
+
+
+// Returns the sum of the squared component errors, which is the basis of
+// imgdiff's total PSNR
+
+static double sumSquares(unsigned char *img1, unsigned char *img2, int size)
+{
+	double sum = 0.;
+
+	for(int i = 0; i < size; i++)
+	{
+		double err = (double)img1[i] - (double)img2[i];
+		sum += err * err;
+	}
+	return sum;
+}
+
+
+// Returns the mean structural similarity of the luminance of two top-down RGB
+// images, computed over non-overlapping 8x8 windows
+
+static double ssim(unsigned char *img1, unsigned char *img2, int width,
+	int height)
+{
+	const double c1 = (0.01 * 255.) * (0.01 * 255.),
+		c2 = (0.03 * 255.) * (0.03 * 255.);
+	double total = 0.;  int windows = 0;
+
+	for(int wy = 0; wy + 8 <= height; wy += 8)
+	{
+		for(int wx = 0; wx + 8 <= width; wx += 8)
+		{
+			double sum1 = 0., sum2 = 0., sq1 = 0., sq2 = 0., prod = 0.;
+			for(int j = wy; j < wy + 8; j++)
+			{
+				unsigned char *p1 = &img1[(width * j + wx) * 3],
+					*p2 = &img2[(width * j + wx) * 3];
+				for(int i = 0; i < 8; i++, p1 += 3, p2 += 3)
+				{
+					double y1 = 0.299 * p1[0] + 0.587 * p1[1] + 0.114 * p1[2];
+					double y2 = 0.299 * p2[0] + 0.587 * p2[1] + 0.114 * p2[2];
+					sum1 += y1;  sum2 += y2;  sq1 += y1 * y1;  sq2 += y2 * y2;
+					prod += y1 * y2;
+				}
+			}
+			double mu1 = sum1 / 64., mu2 = sum2 / 64.;
+			double var1 = sq1 / 64. - mu1 * mu1, var2 = sq2 / 64. - mu2 * mu2,
+				cov = prod / 64. - mu1 * mu2;
+			total += ((2. * mu1 * mu2 + c1) * (2. * cov + c2)) /
+				((mu1 * mu1 + mu2 * mu2 + c1) * (var1 + var2 + c2));
+			windows++;
+		}
+	}
+	return windows ? total / (double)windows : 1.;
+}
+
+
+// Builds a tile cache command in the same format as
+// VGLTrans::sendCacheCommand()
+
+static void initCommand(CompressedFrame &command, rrframeheader h,
+	int compress, int slot, unsigned int *released, int nReleased)
+{
+	h.compress = compress;
+	h.size = 4 * (nReleased + 1);
+	command.init(h, 0);
+	for(int i = 0; i <= nReleased; i++)
+	{
+		unsigned int value = i ? released[i - 1] : slot;
+		command.bits[i * 4] = value & 0xFF;
+		command.bits[i * 4 + 1] = (value >> 8) & 0xFF;
+		command.bits[i * 4 + 2] = (value >> 16) & 0xFF;
+		command.bits[i * 4 + 3] = value >> 24;
+	}
+}
+
+
+// Compress every frame in the capture with the given settings, and add a
+// result for each number of threads
+
+static void runConfig(CaptureReader &reader, List &npList, int compress,
+	int qual, int subsamp, int tileSize, int minTileSize, int interframe,
+	int adaptive)
+{
+	Frame frames[2], *f = NULL, *lastf = NULL, scrollRef;
+	CompressedFrame cframe;
+	ScrollDetector scrollDetector;
+	TileCache tileCache;  TileStore tileStore;  CompressedFrame command;
+	Tiler tiler;
+	YUVEncoder *encoders[MAXVALUES];
+	unsigned char *ref = NULL, *recon = NULL;  int bufSize = 0;
+	double bytes = 0., sqErr = 0., samples = 0., ssimTotal = 0.;
+	double wall[MAXVALUES];
+	tjhandle tjhnd = NULL;
+	int count = 0;
+	CaptureRecord *rec;  unsigned char *bits;
+	Timer timer;
+
+	memset(encoders, 0, sizeof(encoders));
+	for(int k = 0; k < npList.n; k++)
+	{
+		wall[k] = 0.;
+		if(compress == RRCOMP_YUV)
+			NEWCHECK(encoders[k] = new YUVEncoder(npList.values[k]));
+	}
+	if(compress == RRCOMP_JPEG && !(tjhnd = tjInitDecompress()))
+		THROW(tjGetErrorStr());
+
+	tileCache.setBudget((size_t)tileCacheSize * 1048576);
+
+	try
+	{
+		reader.rewind();
+		while((rec = reader.next(&bits)) != NULL
+			&& (maxFrames < 0 || count < maxFrames))
+		{
+			rrframeheader hdr;
+			memset(&hdr, 0, sizeof(rrframeheader));
+			hdr.width = hdr.framew = rec->width;
+			hdr.height = hdr.frameh = rec->height;
+			hdr.winid = rec->winID;
+			hdr.qual = qual;  hdr.subsamp = subsamp;
+			hdr.compress = compress;
+
+			f = &frames[count % 2];
+			f->init(hdr, rec->format, rec->flags);
+			int w = rec->width, h = rec->height, rowSize = w * f->pf->size;
+			for(int y = 0; y < h; y++)
+				memcpy(&f->bits[f->pitch * y], &bits[rowSize * y], rowSize);
+
+			if(w * h * 3 > bufSize)
+			{
+				bufSize = w * h * 3;
+				free(ref);  free(recon);
+				if((ref = (unsigned char *)malloc(bufSize)) == NULL
+					|| (recon = (unsigned char *)malloc(bufSize)) == NULL)
+					THROW("Memory allocation error");
+			}
+			// Reference image (top-down RGB)
+			bool bu = (f->flags & FRAME_BOTTOMUP);
+			f->pf->convert(bu ? &f->bits[f->pitch * (h - 1)] : f->bits, w,
+				bu ? -f->pitch : f->pitch, h, ref, w * 3, pf_get(PF_RGB));
+			// Tiles that are skipped by the interframe comparison keep the contents
+			// of the previous frame from the same window.
+			if(!lastf || lastf->hdr.width != w || lastf->hdr.height != h
+				|| lastf->hdr.winid != hdr.winid)
+				memset(recon, 0, w * h * 3);
+
+			if(compress == RRCOMP_YUV)
+			{
+				for(int k = 0; k < npList.n; k++)
+				{
+					timer.start();
+					cframe.compressYUV(*f, encoders[k]);
+					wall[k] += timer.elapsed();
+				}
+				bytes += cframe.hdr.size;
+				decodeYUV(cframe.bits, w, h, recon);
+			}
+			else
+			{
+				double tileTimes[MAXVALUES][MAXPROCS];
+				memset(tileTimes, 0, sizeof(tileTimes));
+
+				Frame reconFrame(false);
+				reconFrame.init(recon, w, w * 3, h, PF_RGB, 0);
+
+				// Same scroll detection as VGLTrans::sendScroll().  The copy is
+				// performed by the main thread before the tiles are compressed.
+				Frame *scrolledLast = lastf;
+				int sx, sy, dx, dy, sw, sh;
+				timer.start();
+				if(interframe && lastf && !f->stereo
+					&& scrollDetector.detect(*f, *lastf, sx, sy, dx, dy, sw, sh))
+				{
+					rrframeheader refHdr = lastf->hdr;
+					scrollRef.init(refHdr, lastf->pf->id, lastf->flags);
+					memcpy(scrollRef.bits, lastf->bits, lastf->pitch * h);
+					scrollRef.copyRect(sx, sy, dx, dy, sw, sh);
+					scrolledLast = &scrollRef;
+					reconFrame.copyRect(sx, sy, dx, dy, sw, sh);
+					bytes += 4;
+				}
+				double scrollTime = timer.elapsed();
+				for(int k = 0; k < npList.n; k++) wall[k] += scrollTime;
+
+				tileCache.newFrame();
+				// Same per-tile encoding decisions as
+				// VGLTrans::Compressor::compressSend(), except that JPEG tiles are
+				// not sliced
+				TileEncoder encoder(interframe != 0, adaptive != 0, 1, 0, &tileCache);
+
+				// Same tiling algorithm as VGLTrans::run().  Adaptive tiling depends
+				// on the number of threads, so in that case, npList contains only one
+				// value.
+				timer.start();
+				tiler.divide(*f, interframe ? scrolledLast : NULL, tileSize,
+					minTileSize, npList.values[0]);
+				double tileTime = timer.elapsed();
+				for(int k = 0; k < npList.n; k++) wall[k] += tileTime;
+
+				for(int n = 0; n < tiler.getCount(); n++)
+				{
+					int x = tiler[n].x, y = tiler[n].y, width = tiler[n].width,
+						height = tiler[n].height, ranks[MAXVALUES];
+					for(int k = 0; k < npList.n; k++)
+						ranks[k] = minTileSize > 0 ?
+							tiler[n].rank : n % min(npList.values[k], MAXPROCS);
+					TileEncoder::Result result;
+					timer.start();
+					encoder.encode(*f, scrolledLast, tiler[n], cframe, result);
+					double t = timer.elapsed();
+					for(int k = 0; k < npList.n; k++) tileTimes[k][ranks[k]] += t;
+
+					rrframeheader commandHdr = f->hdr;
+					commandHdr.x = x;  commandHdr.y = y;
+					commandHdr.width = width;  commandHdr.height = height;
+					if(result.getSlot >= 0)
+					{
+						initCommand(command, commandHdr, RRCOMP_CACHEGET, result.getSlot,
+							NULL, 0);
+						tileStore.get(reconFrame, command);
+						bytes += command.hdr.size;
+						continue;
+					}
+					bytes += cframe.hdr.size;
+
+					unsigned char *dst = &recon[(w * y + x) * 3];
+					if(cframe.hdr.compress == RRCOMP_JPEG)
+					{
+						if(tjDecompress2(tjhnd, cframe.bits, cframe.hdr.size, dst, width,
+							w * 3, height, TJPF_RGB, 0) == -1)
+							THROW(tjGetErrorStr());
+					}
+					else if(cframe.hdr.compress == RRCOMP_LOSSLESS
+						|| cframe.hdr.compress == RRCOMP_DELTA)
+					{
+						// The decoder places the tile using its header.
+						reconFrame.decompressLossless(cframe, width, height, false);
+					}
+					else if(cframe.hdr.compress == RRCOMP_SOLID)
+						reconFrame.fill(cframe);
+					else
+					{
+						// RGB encoding is lossless.
+						for(int r = 0; r < height; r++)
+							memcpy(&dst[w * 3 * r], &ref[(w * (y + r) + x) * 3],
+								width * 3);
+					}
+					if(result.putSlot >= 0)
+					{
+						initCommand(command, commandHdr, RRCOMP_CACHEPUT, result.putSlot,
+							result.released, result.nReleased);
+						tileStore.put(reconFrame, command);
+						bytes += command.hdr.size;
+					}
+				}
+				for(int k = 0; k < npList.n; k++)
+				{
+					double maxTime = 0.;
+					for(int r = 0; r < min(npList.values[k], MAXPROCS); r++)
+						maxTime = max(maxTime, tileTimes[k][r]);
+					wall[k] += maxTime;
+				}
+			}
+
+			sqErr += sumSquares(ref, recon, w * h * 3);
+			samples += (double)w * (double)h * 3.;
+			ssimTotal += ssim(ref, recon, w, h);
+			lastf = f;  count++;
+		}
+	}
+	catch(...)
+	{
+		free(ref);  free(recon);
+		if(tjhnd) tjDestroy(tjhnd);
+		for(int k = 0; k < npList.n; k++) delete encoders[k];
+		throw;
+	}
+	free(ref);  free(recon);
+	if(tjhnd) tjDestroy(tjhnd);
+	for(int k = 0; k < npList.n; k++) delete encoders[k];
+	if(count < 1) THROW("Capture file contains no frames");
+
+	double rms = sqrt(sqErr / samples);
+	for(int k = 0; k < npList.n; k++)
+	{
+		Result &r = addResult();
+		r.compress = compress;  r.qual = qual;  r.subsamp = subsamp;
+		r.tileSize = tileSize;  r.minTileSize = minTileSize;
+		r.np = npList.values[k];  r.interframe = interframe;  r.adaptive = adaptive;
+		r.bytes = bytes / (double)count;
+		r.time = wall[k] * 1000. / (double)count;
+		r.psnr = rms > 0. ? 20. * log10(255. / rms) : INFINITY;
+		r.ssim = ssimTotal / (double)count;
+	}
+}
+
+
+static bool dominates(Result &a, Result &b)
+{
+	return a.bytes <= b.bytes && a.time <= b.time && a.ssim >= b.ssim
+		&& a.psnr >= b.psnr
+		&& (a.bytes < b.bytes || a.time < b.time || a.ssim > b.ssim
+			|| a.psnr > b.psnr);
+}
+
+
+static void printResult(Result &r)
+{
+	char qual[8] = "-", samp[8] = "-", tileSize[8] = "-", minTile[8] = "-",
+		iframe[8] = "-", adapt[8] = "-";
+
+	if(r.compress == RRCOMP_JPEG)
+	{
+		snprintf(qual, 8, "%d", r.qual);
+		snprintf(samp, 8, r.subsamp ? "%dx" : "gray", r.subsamp);
+	}
+	if(r.compress != RRCOMP_YUV)
+	{
+		snprintf(tileSize, 8, "%d", r.tileSize);
+		snprintf(minTile, 8, "%d", r.minTileSize);
+		snprintf(iframe, 8, "%s", r.interframe ? "on" : "off");
+		snprintf(adapt, 8, "%s", r.adaptive ? "on" : "off");
+	}
+	if(csv)
+		printf("%s,%s,%s,%s,%s,%d,%s,%s,%.0f,%.3f,%.3f,%.5f,%d\n",
+			compName[r.compress], qual, samp, tileSize, minTile, r.np, iframe, adapt,
+			r.bytes, r.time, r.psnr, r.ssim, r.pareto ? 1 : 0);
+	else
+		printf("%-8s %4s %4s %5s %4s %3d %5s %5s %10.1f %9.3f %7.2f %7.5f\n",
+			compName[r.compress], qual, samp, tileSize, minTile, r.np, iframe, adapt,
+			r.bytes / 1024., r.time, r.psnr, r.ssim);
+}
+
+
+static int compareBytes(const void *a, const void *b)
+{
+	double d = ((Result *)a)->bytes - ((Result *)b)->bytes;
+	return d < 0. ? -1 : (d > 0. ? 1 : 0);
+}
+
+
+int main(int argc, char **argv)
+{
+	int retval = 0;
+	CaptureReader *reader = NULL;
+	static const int defComps[] = { RRCOMP_JPEG, RRCOMP_YUV },
+		defQuals[] = { 30, 50, 70, 80, 90, 95 }, defSamps[] = { 1, 2, 4 },
+		defTileSizes[] = { 128, 256, 512 },
+		defMinTileSizes[] = { RR_DEFAULTMINTILESIZE }, defNPs[] = { 1, 2, 4 },
+		defInterframes[] = { 0, 1 }, defAdaptives[] = { 0 };
+
+	setList(comps, 2, defComps);  setList(quals, 6, defQuals);
+	setList(samps, 3, defSamps);  setList(tileSizes, 3, defTileSizes);
+	setList(minTileSizes, 1, defMinTileSizes);
+	setList(nps, 3, defNPs);  setList(interframes, 2, defInterframes);
+	setList(adaptives, 1, defAdaptives);
+
+	try
+	{
+		if(argc < 2) usage(argv);
+		if(!stricmp(argv[1], "-h") || !strcmp(argv[1], "-?")) usage(argv);
+
+		for(int i = 2; i < argc; i++)
+		{
+			if(!stricmp(argv[i], "-c") && i < argc - 1)
+				parseList(comps, argv[++i], argv);
+			else if(!stricmp(argv[i], "-qual") && i < argc - 1)
+				parseList(quals, argv[++i], argv);
+			else if(!stricmp(argv[i], "-samp") && i < argc - 1)
+				parseList(samps, argv[++i], argv);
+			else if(!stricmp(argv[i], "-tilesize") && i < argc - 1)
+				parseList(tileSizes, argv[++i], argv);
+			else if(!stricmp(argv[i], "-mintilesize") && i < argc - 1)
+				parseList(minTileSizes, argv[++i], argv);
+			else if(!stricmp(argv[i], "-np") && i < argc - 1)
+				parseList(nps, argv[++i], argv);
+			else if(!stricmp(argv[i], "-interframe") && i < argc - 1)
+				parseList(interframes, argv[++i], argv);
+			else if(!stricmp(argv[i], "-adaptive") && i < argc - 1)
+				parseList(adaptives, argv[++i], argv);
+			else if(!stricmp(argv[i], "-tilecache") && i < argc - 1)
+			{
+				tileCacheSize = atoi(argv[++i]);
+				if(tileCacheSize < 0) usage(argv);
+			}
+			else if(!stricmp(argv[i], "-frames") && i < argc - 1)
+			{
+				maxFrames = atoi(argv[++i]);  if(maxFrames < 1) usage(argv);
+			}
+			else if(!stricmp(argv[i], "-csv")) csv = true;
+			else usage(argv);
+		}
+		for(int i = 0; i < comps.n; i++)
+			if(comps.values[i] != RRCOMP_JPEG && comps.values[i] != RRCOMP_RGB
+				&& comps.values[i] != RRCOMP_YUV
+				&& comps.values[i] != RRCOMP_LOSSLESS)
+				usage(argv);
+		for(int i = 0; i < quals.n; i++)
+			if(quals.values[i] < 1 || quals.values[i] > 100) usage(argv);
+		for(int i = 0; i < samps.n; i++)
+			if(samps.values[i] != 0 && samps.values[i] != 1 && samps.values[i] != 2
+				&& samps.values[i] != 4)
+				usage(argv);
+		for(int i = 0; i < tileSizes.n; i++)
+			if(tileSizes.values[i] < 8) usage(argv);
+		for(int i = 0; i < minTileSizes.n; i++)
+			if(minTileSizes.values[i] < 0) usage(argv);
+		for(int i = 0; i < nps.n; i++)
+			if(nps.values[i] < 1 || nps.values[i] > MAXPROCS) usage(argv);
+
+		NEWCHECK(reader = new CaptureReader(argv[1]));
+
+		for(int c = 0; c < comps.n; c++)
+		{
+			int compress = comps.values[c];
+			bool jpeg = (compress == RRCOMP_JPEG), yuv = (compress == RRCOMP_YUV);
+			for(int q = 0; q < (jpeg ? quals.n : 1); q++)
+				for(int s = 0; s < (jpeg ? samps.n : 1); s++)
+					for(int t = 0; t < (yuv ? 1 : tileSizes.n); t++)
+						for(int m = 0; m < (yuv ? 1 : minTileSizes.n); m++)
+							for(int i = 0; i < (yuv ? 1 : interframes.n); i++)
+								for(int a = 0; a < (yuv ? 1 : adaptives.n); a++)
+								{
+									int minTileSize = yuv ? 0 : minTileSizes.values[m];
+									// Adaptive tiling depends on the number of threads, so each
+									// number of threads is run separately.
+									for(int k = 0; k < (minTileSize > 0 ? nps.n : 1); k++)
+									{
+										List npList = nps;
+										if(minTileSize > 0)
+										{
+											npList.n = 1;  npList.values[0] = nps.values[k];
+										}
+										runConfig(*reader, npList, compress,
+											jpeg ? quals.values[q] : 0,
+											jpeg ? samps.values[s] : (yuv ? 4 : 0),
+											yuv ? 0 : tileSizes.values[t], minTileSize,
+											yuv ? 0 : interframes.values[i],
+											yuv ? 0 : adaptives.values[a]);
+									}
+									if(!csv) { fprintf(stderr, ".");  fflush(stderr); }
+								}
+		}
+		if(!csv) fprintf(stderr, "\n");
+
+		for(int i = 0; i < nResults; i++)
+		{
+			results[i].pareto = true;
+			for(int j = 0; j < nResults && results[i].pareto; j++)
+				if(j != i && dominates(results[j], results[i]))
+					results[i].pareto = false;
+		}
+		qsort(results, nResults, sizeof(Result), compareBytes);
+
+		if(csv)
+		{
+			printf("comp,qual,samp,tilesize,mintilesize,np,interframe,adaptive,bytes_per_frame,ms_per_frame,psnr,ssim,pareto\n");
+			for(int i = 0; i < nResults; i++) printResult(results[i]);
+		}
+		else
+		{
+			printf("Pareto-optimal settings (smallest first):\n\n");
+			printf("COMP     QUAL SAMP  TILE MINT  NP IFRAM ADAPT   KB/frame  ms/frame    PSNR    SSIM\n");
+			for(int i = 0; i < nResults; i++)
+				if(results[i].pareto) printResult(results[i]);
+			int nPareto = 0;
+			for(int i = 0; i < nResults; i++) if(results[i].pareto) nPareto++;
+			printf("\n%d of %d combinations are Pareto-optimal.  Use -csv to see all of them.\n",
+				nPareto, nResults);
+		}
+	}
+	catch(Error &e)
+	{
+		printf("%s--\n%s\n", e.getMethod(), e.getMessage());
+		retval = -1;
+	}
+
+	delete reader;
+	free(results);
+	return retval;
+}
@@ -0,0 +1,349 @@
+// Copyright (C)2020 D. R. Commander
+//
+// This library is free software and may be redistributed and/or modified under
+// the terms of the wxWindows Library License, Version 3.1 or (at your option)
+// any later version.  The full license is in the LICENSE.txt file included
+// with this distribution.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// wxWindows Library License for more details.
+
+// Decodes a binary trace file written by the VirtualGL Faker (using
+// VGL_TRACEFILE) into the same text format that VGL_TRACE produces
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <GL/glx.h>
+#include "Error.h"
+#include "Log.h"
+#include "vglutil.h"
+#include "BinaryTrace.h"
+
+using namespace vglutil;
+
+
+typedef struct
+{
+	unsigned long long threadID;
+	unsigned int seq;
+	unsigned short funcID;
+	unsigned char level, nIn;
+	double start, duration;
+	int nSlots;
+	unsigned short names[BINTRACE_MAXSLOTS];
+	unsigned long long values[BINTRACE_MAXSLOTS];
+} Call;
+
+// A top-level call and the calls nested within it, which are printed together
+typedef struct
+{
+	Call *calls;
+	int nCalls;
+} Group;
+
+static BinTraceHeader *header = NULL;
+static unsigned char *nameTable = NULL;
+
+
+void usage(char **argv)
+{
+	vglout.print("\nUSAGE: %s <trace file>\n\n", argv[0]);
+	vglout.print("Decodes a trace file written by the VirtualGL Faker when the environment\n");
+	vglout.print("variable VGL_TRACEFILE is set.\n\n");
+	exit(1);
+}
+
+
+static BinTraceName *getName(unsigned short id)
+{
+	id &= ~BINTRACE_NULL;
+	if(id < 1 || id >= header->nNames) return NULL;
+	return (BinTraceName *)&nameTable[id * header->nameSize];
+}
+
+
+static int compareSeq(const void *arg1, const void *arg2)
+{
+	const Call *c1 = (const Call *)arg1, *c2 = (const Call *)arg2;
+	return c1->seq < c2->seq ? -1 : (c1->seq > c2->seq ? 1 : 0);
+}
+
+
+static int compareStart(const void *arg1, const void *arg2)
+{
+	const Group *g1 = (const Group *)arg1, *g2 = (const Group *)arg2;
+	double t1 = g1->calls[0].start, t2 = g2->calls[0].start;
+	return t1 < t2 ? -1 : (t1 > t2 ? 1 : 0);
+}
+
+
+static void printArgs(Call &c, int first, int last)
+{
+	for(int i = first; i < last; i++)
+	{
+		BinTraceName *n = getName(c.names[i]);
+		if(!n) continue;  // Orphaned continuation slot
+		unsigned long long v = c.values[i], v2 = i + 1 < last ? c.values[i + 1] : 0;
+
+		switch(n->type)
+		{
+			case 'D':
+			{
+				BinTraceName *dpyName = getName((unsigned short)v2);
+				vglout.print("%s=0x%.8lx(%s) ", n->name, (unsigned long)v,
+					v && dpyName ? dpyName->name : "NULL");
+				i++;
+				break;
+			}
+			case 'S':
+				if(c.names[i] & BINTRACE_NULL)
+					vglout.print("%s=NULL ", n->name);
+				else
+				{
+					char str[17];
+					memcpy(str, &v, 8);  memcpy(&str[8], &v2, 8);  str[16] = 0;
+					vglout.print("%s=%s%s ", n->name, str,
+						strlen(str) == 16 ? "..." : "");
+				}
+				i++;
+				break;
+			case 'X':
+				vglout.print("%s=0x%.8lx ", n->name, (unsigned long)v);
+				break;
+			case 'Y':
+				vglout.print("%s=%d(0x%.lx) ", n->name, (int)v, (unsigned long)v);
+				break;
+			case 'I':
+				vglout.print("%s=%d ", n->name, (int)(long long)v);
+				break;
+			case 'F':
+			{
+				double d;
+				memcpy(&d, &v, sizeof(double));
+				vglout.print("%s=%f ", n->name, d);
+				break;
+			}
+			case 'V':
+				vglout.print("%s=0x%.8lx(0x%.2lx) ", n->name, (unsigned long)v,
+					(unsigned long)v2);
+				i++;
+				break;
+			case 'C':
+				vglout.print("%s=0x%.8lx(0x%.2x) ", n->name, (unsigned long)v,
+					(unsigned int)v2);
+				i++;
+				break;
+			case 'A':
+			case 'B':
+			{
+				int list[BINTRACE_MAXLIST + 1] = { 0 }, nEntries = (int)v2, j;
+				i++;
+				if(nEntries > BINTRACE_MAXLIST) nEntries = BINTRACE_MAXLIST;
+				for(j = 0; j < nEntries; j += 2)
+				{
+					unsigned long long pair = i + 1 < last ? c.values[++i] : 0;
+					list[j] = (int)(pair & 0xFFFFFFFF);
+					list[j + 1] = (int)(pair >> 32);
+				}
+				if(!v) break;
+				vglout.print("%s=[", n->name);
+				for(j = 0; j < nEntries && list[j] != None; j++)
+				{
+					if(n->type == 'B')
+					{
+						vglout.print("0x%.4x=0x%.4x ", list[j], list[j + 1]);
+						j++;
+						continue;
+					}
+					vglout.print("0x%.4x", list[j]);
+					if(list[j] != GLX_USE_GL && list[j] != GLX_DOUBLEBUFFER
+						&& list[j] != GLX_STEREO && list[j] != GLX_RGBA)
+						vglout.print("=0x%.4x", list[++j]);
+					vglout.print(" ");
+				}
+				if(j >= nEntries) vglout.print("... ");
+				vglout.print("] ");
+				break;
+			}
+		}
+	}
+}
+
+
+// This mimics the OPENTRACE() and CLOSETRACE() macros in faker.h.
+
+static void openCall(Call &c)
+{
+	BinTraceName *func = getName(c.funcID);
+
+	if(c.level > 0)
+	{
+		vglout.print("\n[VGL 0x%.8x] ", (unsigned int)c.threadID);
+		for(int i = 0; i < c.level; i++) vglout.print("  ");
+	}
+	else vglout.print("[VGL 0x%.8x] ", (unsigned int)c.threadID);
+	vglout.print("%s (", func ? func->name : "???");
+	printArgs(c, 0, c.nIn);
+}
+
+
+static void closeCall(Call &c)
+{
+	printArgs(c, c.nIn, c.nSlots);
+	vglout.print(") %f ms\n", c.duration * 1000.);
+	if(c.level > 0)
+	{
+		vglout.print("[VGL 0x%.8x] ", (unsigned int)c.threadID);
+		for(int i = 0; i < c.level - 1; i++) vglout.print("  ");
+	}
+}
+
+
+static void printGroup(Group &g)
+{
+	Call *stack[256];  int depth = 0;
+
+	for(int i = 0; i < g.nCalls; i++)
+	{
+		Call &c = g.calls[i];
+		// A call at a given nesting level can't start until all calls at that
+		// level or deeper have finished.
+		while(depth > 0 && stack[depth - 1]->level >= c.level)
+			closeCall(*stack[--depth]);
+		openCall(c);
+		stack[depth++] = &c;
+	}
+	while(depth > 0) closeCall(*stack[--depth]);
+}
+
+
+int main(int argc, char **argv)
+{
+	int fd = -1, status = 0;  struct stat sb;
+	unsigned char *map = NULL;  size_t mapSize = 0;
+	Call *calls = NULL;  Group *groups = NULL;
+
+	if(argc != 2 || argv[1][0] == '-') usage(argv);
+
+	try
+	{
+		if((fd = open(argv[1], O_RDONLY)) == -1 || fstat(fd, &sb) == -1)
+			THROW_UNIX();
+		mapSize = sb.st_size;
+		if(mapSize < sizeof(BinTraceHeader)) THROW("Invalid trace file");
+		if((map = (unsigned char *)mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd,
+			0)) == MAP_FAILED)
+		{
+			map = NULL;  THROW_UNIX();
+		}
+
+		header = (BinTraceHeader *)map;
+		if(memcmp(header->id, BINTRACE_ID, 8)
+			|| header->nameSize != sizeof(BinTraceName)
+			|| header->threadSize != sizeof(BinTraceThread)
+			|| header->recordSize != sizeof(BinTraceRecord)
+			|| header->slots != BINTRACE_SLOTS)
+			THROW("Invalid trace file or unsupported trace file version");
+		size_t threadOffset = header->headerSize
+			+ (size_t)header->nameSize * header->maxNames;
+		size_t ringOffset = threadOffset
+			+ (size_t)header->threadSize * header->maxThreads;
+		if(ringOffset + (size_t)header->recordSize * header->maxThreads
+			* header->ringSize > mapSize || header->nNames > header->maxNames
+			|| header->nThreads > header->maxThreads)
+			THROW("Trace file is truncated");
+		nameTable = &map[header->headerSize];
+
+		unsigned long long maxCalls = 0, dropped = 0;
+		for(unsigned int t = 0; t < header->nThreads; t++)
+		{
+			BinTraceThread *thread =
+				(BinTraceThread *)&map[threadOffset + t * header->threadSize];
+			maxCalls += min(thread->nRecords, (unsigned long long)header->ringSize);
+		}
+		if(maxCalls < 1)
+		{
+			vglout.print("No calls were recorded.\n");
+			munmap(map, mapSize);  close(fd);
+			return 0;
+		}
+		if((calls = (Call *)malloc(sizeof(Call) * maxCalls)) == NULL
+			|| (groups = (Group *)malloc(sizeof(Group) * maxCalls)) == NULL)
+			THROW("Memory allocation error");
+
+		int nCalls = 0, nGroups = 0;
+		for(unsigned int t = 0; t < header->nThreads; t++)
+		{
+			BinTraceThread *thread =
+				(BinTraceThread *)&map[threadOffset + t * header->threadSize];
+			BinTraceRecord *ring = (BinTraceRecord *)&map[ringOffset
+				+ (size_t)t * header->ringSize * header->recordSize];
+			unsigned long long first = thread->nRecords > header->ringSize ?
+				thread->nRecords - header->ringSize : 0;
+			int firstCall = nCalls;
+			Call *c = NULL;
+
+			// The records of a call are contiguous, so a continuation record
+			// belongs to the most recent call record with the same sequence number.
+			// Continuation records whose call record was overwritten are dropped.
+			for(unsigned long long i = first; i < thread->nRecords; i++)
+			{
+				BinTraceRecord &r = ring[i % header->ringSize];
+				if(r.type == BINTRACE_CALL)
+				{
+					c = &calls[nCalls++];
+					c->threadID = thread->threadID;
+					c->seq = r.seq;  c->funcID = r.funcID;
+					c->level = r.level;  c->nIn = r.nIn;
+					c->start = r.start;  c->duration = r.duration;
+					c->nSlots = 0;
+				}
+				else if(!c || c->seq != r.seq)
+				{
+					dropped++;  continue;
+				}
+				for(int j = 0; j < r.nSlots && c->nSlots < BINTRACE_MAXSLOTS; j++)
+				{
+					c->names[c->nSlots] = r.names[j];
+					c->values[c->nSlots++] = r.values[j];
+				}
+			}
+			if(first > 0) dropped += first;
+
+			// Calls are recorded when they finish, so nested calls are recorded
+			// before the calls that contain them.
+			qsort(&calls[firstCall], nCalls - firstCall, sizeof(Call), compareSeq);
+			for(int i = firstCall; i < nCalls; i++)
+			{
+				if(i == firstCall || calls[i].level == 0)
+				{
+					groups[nGroups].calls = &calls[i];
+					groups[nGroups++].nCalls = 0;
+				}
+				groups[nGroups - 1].nCalls++;
+			}
+		}
+		qsort(groups, nGroups, sizeof(Group), compareStart);
+
+		if(dropped)
+			vglout.print("[%llu older records were overwritten]\n", dropped);
+		for(int i = 0; i < nGroups; i++) printGroup(groups[i]);
+	}
+	catch(Error &e)
+	{
+		vglout.print("Error in vgltrace--\n%s\n", e.getMessage());
+		status = -1;
+	}
+	free(calls);  free(groups);
+	if(map) munmap(map, mapSize);
+	if(fd != -1) close(fd);
+	return status;
+}
@@ -13,6 +13,7 @@
 // wxWindows Library License for more details.
 
 #include "VGLTrans.h"
+#include "TileCache.h"
 #include "vglutil.h"
 #include "Timer.h"
 #include "bmp.h"
@@ -45,6 +46,11 @@ void usage(char **argv)
 	fprintf(stderr, "                comparison tile (default: %d x %d pixels)\n",
 		fconfig.tilesize, fconfig.tilesize);
 	fprintf(stderr, "-rgb = Use RGB (uncompressed) encoding (default is JPEG)\n");
+	fprintf(stderr, "-roundtrip = Encode the tiles of the bitmap using each of the tile encodings\n");
+	fprintf(stderr, "             that require VirtualGL Client v2.6.4 or later, decode them\n");
+	fprintf(stderr, "             using the client's decoders, and compare the result with the\n");
+	fprintf(stderr, "             bitmap.  Also check that the decoders reject corrupt data.  No\n");
+	fprintf(stderr, "             client is required.\n");
 	#ifdef USESSL
 	fprintf(stderr, "-ssl = Use SSL tunnel (default: %s)\n",
 		fconfig.ssl ? "On" : "Off");
@@ -55,12 +61,370 @@ void usage(char **argv)
 }
 
 
+// Returns the number of pixels that differ between two frames of the same size
+
+static int cmpFrames(Frame &ref, Frame &dst)
+{
+	int errors = 0;
+
+	for(int y = 0; y < ref.hdr.frameh; y++)
+	{
+		int refY = ref.flags & FRAME_BOTTOMUP ? ref.hdr.frameh - y - 1 : y;
+		int dstY = dst.flags & FRAME_BOTTOMUP ? dst.hdr.frameh - y - 1 : y;
+		unsigned char *refPixel = &ref.bits[ref.pitch * refY],
+			*dstPixel = &dst.bits[dst.pitch * dstY];
+		for(int x = 0; x < ref.hdr.framew; x++, refPixel += ref.pf->size,
+			dstPixel += dst.pf->size)
+		{
+			int r1, g1, b1, r2, g2, b2;
+			ref.pf->getRGB(refPixel, &r1, &g1, &b1);
+			dst.pf->getRGB(dstPixel, &r2, &g2, &b2);
+			if(r1 != r2 || g1 != g2 || b1 != b2) errors++;
+		}
+	}
+	return errors;
+}
+
+
+static int check(const char *name, Frame &ref, Frame &dst)
+{
+	int errors = cmpFrames(ref, dst);
+
+	fprintf(stderr, "%-12s - ", name);
+	if(errors) fprintf(stderr, "FAILED! (%d pixels differ)\n", errors);
+	else fprintf(stderr, "Passed.\n");
+	return errors ? 1 : 0;
+}
+
+
+// Same format as VGLTrans::sendCacheCommand()
+
+static void initCommand(CompressedFrame &cf, rrframeheader h, int compress,
+	int slot, unsigned int *released, int nReleased)
+{
+	h.compress = compress;
+	h.size = 4 * (nReleased + 1);
+	cf.init(h, 0);
+	for(int i = 0; i <= nReleased; i++)
+	{
+		unsigned int value = i ? released[i - 1] : slot;
+		cf.bits[i * 4] = value & 0xFF;  cf.bits[i * 4 + 1] = (value >> 8) & 0xFF;
+		cf.bits[i * 4 + 2] = (value >> 16) & 0xFF;  cf.bits[i * 4 + 3] = value >> 24;
+	}
+}
+
+
+// Decode the tiles of src into dst (which must have the same dimensions as
+// src) using the encoding specified in the tile headers
+
+static void losslessTiles(Frame &src, Frame &dst, int tileSize)
+{
+	CompressedFrame cf;
+
+	for(int y = 0; y < src.hdr.height; y += tileSize)
+	{
+		for(int x = 0; x < src.hdr.width; x += tileSize)
+		{
+			int width = min(tileSize, src.hdr.width - x),
+				height = min(tileSize, src.hdr.height - y);
+			Frame *tile = src.getTile(x, y, width, height);
+			try
+			{
+				cf.compressLossless(*tile);
+			}
+			catch(...)
+			{
+				delete tile;  throw;
+			}
+			delete tile;
+			dst.decompressLossless(cf, width, height, false);
+		}
+	}
+}
+
+
+#define CHECK_REJECT(name, statement) \
+{ \
+	bool rejected = false; \
+	try \
+	{ \
+		statement; \
+	} \
+	catch(Error &e) \
+	{ \
+		rejected = true; \
+	} \
+	fprintf(stderr, "%-36s - %s\n", name, rejected ? "Passed." : "FAILED!"); \
+	if(!rejected) failures++; \
+}
+
+
+// Round-trip tests for the tile encodings that were introduced with protocol
+// v2.2.  The decoded tiles are compared with the source image, in every
+// pixel format and row order that the client may use.  Returns the number of
+// failed tests.
+
+static int roundTrip(char *filename, int tileSize)
+{
+	unsigned char *buf = NULL;
+	int w, h, failures = 0;
+	Frame src, last, solid, dst, ref;
+	CompressedFrame cf;
+
+	if(bmp_load(filename, &buf, &w, 1, &h, PF_RGB, BMPORN_TOPDOWN) == -1)
+		THROW(bmp_geterr());
+	if(tileSize < 8) THROW("Invalid tile size");
+
+	try
+	{
+		rrframeheader hdr;
+		memset(&hdr, 0, sizeof(rrframeheader));
+		hdr.width = hdr.framew = w;  hdr.height = hdr.frameh = h;
+		hdr.qual = fconfig.qual;  hdr.subsamp = 1;
+		src.init(hdr, PF_RGB, 0);  last.init(hdr, PF_RGB, 0);
+		solid.init(hdr, PF_RGB, 0);  ref.init(hdr, PF_RGB, 0);
+		memcpy(src.bits, buf, w * h * 3);
+
+		// The previous frame differs from src in a few scattered pixels and in a
+		// block of solid pixels, so the delta tiles contain both changed pixels
+		// and skipped runs.
+		memcpy(last.bits, buf, w * h * 3);
+		for(int i = 0; i < w * h; i += 37) last.bits[i * 3] ^= 0xFF;
+		for(int y = 0; y < h / 4; y++)
+			memset(&last.bits[last.pitch * y], 0x80, w / 4 * 3);
+
+		// Each tile of solid is filled with the color of its upper left pixel.
+		for(int y = 0; y < h; y++)
+			for(int x = 0; x < w; x++)
+				memcpy(&solid.bits[solid.pitch * y + x * 3],
+					&buf[(w * (y / tileSize * tileSize) + x / tileSize * tileSize) * 3],
+					3);
+
+		SliceDecoder sliceDecoder(MAXPROCS);
+
+		for(int dstFormat = 0; dstFormat < PIXELFORMATS; dstFormat++)
+		{
+			PF *dstpf = pf_get(dstFormat);
+			if(dstpf->bpc != 8 || dstpf->size < 3) continue;
+			for(int dstbu = 0; dstbu < 2; dstbu++)
+			{
+				fprintf(stderr, "RGB -> %s (%s)\n", dstpf->name,
+					dstbu ? "BOTTOM-UP" : "TOP-DOWN");
+				dst.init(hdr, dstFormat, dstbu ? FRAME_BOTTOMUP : 0);
+
+				// RRCOMP_LOSSLESS
+				memset(dst.bits, 0, dst.pitch * h);
+				losslessTiles(src, dst, tileSize);
+				failures += check("LOSSLESS", src, dst);
+
+				// RRCOMP_DELTA
+				memset(dst.bits, 0, dst.pitch * h);
+				losslessTiles(last, dst, tileSize);
+				for(int y = 0; y < h; y += tileSize)
+				{
+					for(int x = 0; x < w; x += tileSize)
+					{
+						int width = min(tileSize, w - x), height = min(tileSize, h - y);
+						Frame *tile = src.getTile(x, y, width, height),
+							*lastTile = last.getTile(x, y, width, height);
+						cf.compressDelta(*tile, *lastTile);
+						delete tile;  delete lastTile;
+						dst.decompressLossless(cf, width, height, false);
+					}
+				}
+				failures += check("DELTA", src, dst);
+
+				// RRCOMP_SOLID
+				memset(dst.bits, 0, dst.pitch * h);
+				for(int y = 0; y < h; y += tileSize)
+				{
+					for(int x = 0; x < w; x += tileSize)
+					{
+						Frame *tile = solid.getTile(x, y, min(tileSize, w - x),
+							min(tileSize, h - y));
+						cf.compressSolid(*tile);
+						delete tile;
+						dst.fill(cf);
+					}
+				}
+				failures += check("SOLID", solid, dst);
+
+				// RRCOMP_COPYRECT (overlapping regions, in both directions)
+				memset(dst.bits, 0, dst.pitch * h);
+				losslessTiles(src, dst, tileSize);
+				memcpy(ref.bits, buf, w * h * 3);
+				for(int dir = 0; dir < 2; dir++)
+				{
+					int sx = dir ? w / 4 : 0, sy = dir ? h / 4 : 0,
+						dx = dir ? 0 : w / 4, dy = dir ? 0 : h / 4;
+					rrframeheader cmd = hdr;
+					cmd.x = dx;  cmd.y = dy;  cmd.width = w - w / 4;
+					cmd.height = h - h / 4;  cmd.compress = RRCOMP_COPYRECT;
+					cmd.size = 4;
+					cf.init(cmd, 0);
+					cf.bits[0] = sx & 0xFF;  cf.bits[1] = sx >> 8;
+					cf.bits[2] = sy & 0xFF;  cf.bits[3] = sy >> 8;
+					dst.copyRect(cf);
+					ref.copyRect(sx, sy, dx, dy, cmd.width, cmd.height);
+				}
+				failures += check("COPYRECT", ref, dst);
+
+				// RRCOMP_CACHEPUT and RRCOMP_CACHEGET
+				{
+					TileCache tileCache;  TileStore tileStore;
+					tileCache.setBudget((size_t)w * h * 4 * 2);
+					memset(dst.bits, 0, dst.pitch * h);
+					losslessTiles(src, dst, tileSize);
+					for(int pass = 0; pass < 2; pass++)
+					{
+						tileCache.newFrame();
+						if(pass) memset(dst.bits, 0, dst.pitch * h);
+						for(int y = 0; y < h; y += tileSize)
+						{
+							for(int x = 0; x < w; x += tileSize)
+							{
+								int width = min(tileSize, w - x),
+									height = min(tileSize, h - y);
+								Frame *tile = src.getTile(x, y, width, height);
+								TileCache::Digest digest;
+								TileCache::digest(*tile, digest);
+								rrframeheader cmd = tile->hdr;
+								delete tile;
+								if(pass)
+								{
+									int slot = tileCache.lookup(digest);
+									if(slot < 0) THROW("Tile was not cached");
+									initCommand(cf, cmd, RRCOMP_CACHEGET, slot, NULL, 0);
+									tileStore.get(dst, cf);
+								}
+								else
+								{
+									unsigned int released[TILECACHE_MAXRELEASE];
+									int nReleased;
+									int slot = tileCache.insert(digest, width * height * 4,
+										released, nReleased);
+									if(slot < 0) continue;  // Duplicate tile
+									initCommand(cf, cmd, RRCOMP_CACHEPUT, slot, released,
+										nReleased);
+									tileStore.put(dst, cf);
+								}
+							}
+						}
+					}
+					failures += check("CACHEPUT/GET", src, dst);
+				}
+
+				// RRCOMP_JPEGSLICES.  Each slice is a multiple of 16 rows high, so with
+				// 4:4:4 subsampling, the sliced tile decodes to exactly the same
+				// pixels as the same tile compressed as a single JPEG image.
+				{
+					Frame *tile = src.getTile(0, 0, w, h);
+					try
+					{
+						cf.compressJPEGSlices(*tile, 1);
+						sliceDecoder.decode(dst, cf);
+						ref.init(hdr, dstFormat, dstbu ? FRAME_BOTTOMUP : 0);
+						memcpy(ref.bits, dst.bits, dst.pitch * h);
+						memset(dst.bits, 0, dst.pitch * h);
+						cf.compressJPEGSlices(*tile, RR_MAXSLICES);
+						sliceDecoder.decode(dst, cf);
+					}
+					catch(...)
+					{
+						delete tile;  throw;
+					}
+					delete tile;
+					failures += check("JPEGSLICES", ref, dst);
+					ref.init(hdr, PF_RGB, 0);
+				}
+				fprintf(stderr, "\n");
+			}
+		}
+
+		// The decoders must reject truncated and corrupt data rather than
+		// reading or writing out of bounds.
+		fprintf(stderr, "Decoder error checking\n");
+		dst.init(hdr, PF_BGRX, FRAME_BOTTOMUP);
+		Frame *tile = src.getTile(0, 0, min(tileSize, w), min(tileSize, h));
+		int width = tile->hdr.width, height = tile->hdr.height;
+		try
+		{
+			cf.compressLossless(*tile);
+			cf.hdr.size /= 2;
+			CHECK_REJECT("Truncated LOSSLESS tile",
+				dst.decompressLossless(cf, width, height, false));
+			cf.compressLossless(*tile);
+			cf.bits[0] = 0xF0;  // Skip code, which is only valid in a DELTA tile
+			CHECK_REJECT("Corrupt LOSSLESS tile",
+				dst.decompressLossless(cf, width, height, false));
+			Frame *lastTile = last.getTile(0, 0, width, height);
+			cf.compressDelta(*tile, *lastTile);
+			delete lastTile;
+			cf.hdr.size = 1;
+			CHECK_REJECT("Truncated DELTA tile",
+				dst.decompressLossless(cf, width, height, false));
+
+			cf.compressSolid(*tile);
+			cf.hdr.size = 2;
+			CHECK_REJECT("Truncated SOLID tile", dst.fill(cf));
+			cf.compressSolid(*tile);
+			cf.hdr.x = w;
+			CHECK_REJECT("Out-of-range SOLID tile", dst.fill(cf));
+
+			rrframeheader cmd = tile->hdr;
+			cmd.compress = RRCOMP_COPYRECT;  cmd.size = 4;
+			cf.init(cmd, 0);
+			cf.bits[0] = w & 0xFF;  cf.bits[1] = w >> 8;  cf.bits[2] = cf.bits[3] = 0;
+			CHECK_REJECT("Out-of-range COPYRECT source", dst.copyRect(cf));
+			cf.hdr.size = 2;
+			CHECK_REJECT("Truncated COPYRECT command", dst.copyRect(cf));
+
+			TileStore tileStore;
+			initCommand(cf, cmd, RRCOMP_CACHEGET, 0, NULL, 0);
+			CHECK_REJECT("CACHEGET of an empty slot", tileStore.get(dst, cf));
+			initCommand(cf, cmd, RRCOMP_CACHEPUT, 1 << 24, NULL, 0);
+			CHECK_REJECT("CACHEPUT of an invalid slot", tileStore.put(dst, cf));
+			initCommand(cf, cmd, RRCOMP_CACHEPUT, 0, NULL, 0);
+			cf.hdr.size = 6;
+			CHECK_REJECT("Truncated CACHEPUT command", tileStore.put(dst, cf));
+
+			tile->hdr.subsamp = 1;  tile->hdr.qual = fconfig.qual;
+			cf.compressJPEGSlices(*tile, RR_MAXSLICES);
+			unsigned char nSlices = cf.bits[0];
+			cf.bits[0] = 0;
+			CHECK_REJECT("JPEGSLICES tile with no slices",
+				sliceDecoder.decode(dst, cf));
+			cf.bits[0] = RR_MAXSLICES + 1;
+			CHECK_REJECT("JPEGSLICES tile with too many slices",
+				sliceDecoder.decode(dst, cf));
+			cf.bits[0] = nSlices;  cf.bits[1] ^= 1;
+			CHECK_REJECT("JPEGSLICES tile with wrong height",
+				sliceDecoder.decode(dst, cf));
+			cf.bits[1] ^= 1;  cf.hdr.size -= 1;
+			CHECK_REJECT("Truncated JPEGSLICES tile", sliceDecoder.decode(dst, cf));
+		}
+		catch(...)
+		{
+			delete tile;  throw;
+		}
+		delete tile;
+	}
+	catch(...)
+	{
+		free(buf);  throw;
+	}
+	free(buf);
+	return failures;
+}
+
+
 int main(int argc, char **argv)
 {
 	Timer timer;  double elapsed;
 	unsigned char *buf = NULL, *buf2 = NULL, *buf3 = NULL;
 	Display *dpy = NULL;  Window win = 0;
 	int i, retval = 0;  int bgr = LittleEndian();
+	bool roundtrip = false;
 
 	try
 	{
@@ -106,8 +470,14 @@ int main(int argc, char **argv)
 			}
 			else if(!stricmp(argv[i], "-rgb"))
 				fconfig_setcompress(fconfig, RRCOMP_RGB);
+			else if(!stricmp(argv[i], "-roundtrip")) roundtrip = true;
 			else usage(argv);
 		}
+		if(roundtrip)
+		{
+			if(roundTrip(argv[1], fconfig.tilesize) > 0) retval = -1;
+			return retval;
+		}
 		if(fconfig.compress == RRCOMP_RGB) bgr = 0;
 
 		int w, h, d = 3;
@@ -143,6 +513,7 @@ int main(int argc, char **argv)
 
 		VGLTrans vglconn;
 		if(!localtest) vglconn.connect(fconfig.client, fconfig.port);
+		else vglconn.connectNull();
 
 		for(i = 0; i < w * h * d; i++) buf2[i] = 255 - buf2[i];
 		for(i = 0; i < w * h * d / 2; i++) buf3[i] = 255 - buf3[i];
@@ -106,8 +106,12 @@ isvalid(XFontStruct * fs, unsigned int which)
 }
 
 
+/* vglTraceCall is the trace record of the interposed glXUseXFont() call, so
+   that the font name can be traced in either text or binary form. */
+
 void
-Fake_glXUseXFont(Font font, int first, int count, int listbase)
+Fake_glXUseXFont(Font font, int first, int count, int listbase,
+                 vglserver::BinTraceCallPtr &vglTraceCall)
 {
    Display *dpy = NULL;
    Window win = 0;  bool newwin = false;
@@ -178,7 +182,7 @@ Fake_glXUseXFont(Font font, int first, int count, int listbase)
       return;
    }
 
-   if (fconfig.trace) {
+   if (fconfig.trace || IS_BINTRACE) {
       unsigned long name_value;
 
       if (XGetFontProperty(fs, XA_FONT, &name_value)) {
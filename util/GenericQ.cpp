@@ -51,19 +51,22 @@ void GenericQ::release(void)
 }
 
 
-void GenericQ::spoil(void *item, SpoilCallback spoilCallback)
+int GenericQ::spoil(void *item, SpoilCallback spoilCallback)
 {
-	if(deadYet) return;
+	int spoiled = 0;
+
+	if(deadYet) return 0;
 	if(item == NULL) THROW("NULL argument in GenericQ::spoil()");
 	CriticalSection::SafeLock l(mutex);
-	if(deadYet) return;
+	if(deadYet) return 0;
 	void *dummy = NULL;
 	while(1)
 	{
 		get(&dummy, true);   if(!dummy) break;
-		spoilCallback(dummy);
+		spoilCallback(dummy);  spoiled++;
 	}
 	add(item);
+	return spoiled;
 }
 
 
@@ -108,6 +111,26 @@ void GenericQ::get(void **item, bool nonBlocking)
 }
 
 
+void GenericQ::timedGet(void **item, double timeout)
+{
+	if(deadYet) return;
+	if(item == NULL) THROW("NULL argument in GenericQ::timedGet()");
+	if(!hasItem.timedWait(timeout))
+	{
+		*item = NULL;  return;
+	}
+	if(!deadYet)
+	{
+		CriticalSection::SafeLock l(mutex);
+		if(deadYet) return;
+		if(start == NULL) THROW("Nothing in the queue");
+		*item = start->item;
+		Entry *temp = start->next;
+		delete start;  start = temp;
+	}
+}
+
+
 int GenericQ::items(void)
 {
 	int retval = 0;
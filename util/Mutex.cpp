@@ -15,6 +15,11 @@
 #include "Mutex.h"
 #ifndef _WIN32
 #include <string.h>
+#include <time.h>
+#endif
+#ifdef __APPLE__
+#include <unistd.h>
+#include "vglutil.h"
 #endif
 #include "Error.h"
 
@@ -322,6 +327,49 @@ bool Semaphore::tryWait()
 }
 
 
+bool Semaphore::timedWait(double seconds)
+{
+	#ifdef _WIN32
+
+	DWORD err = WaitForSingleObject(sem, (DWORD)(seconds * 1000.));
+	if(err == WAIT_FAILED) throw(W32Error("Semaphore::timedWait()"));
+	else if(err == WAIT_TIMEOUT) return false;
+
+	#elif defined(__APPLE__)
+
+	// macOS does not implement sem_timedwait().
+	double deadline = GetTime() + seconds;
+	while(!tryWait())
+	{
+		if(GetTime() >= deadline) return false;
+		usleep(1000);
+	}
+
+	#else
+
+	struct timespec ts;
+	if(clock_gettime(CLOCK_REALTIME, &ts) == -1)
+		throw(UnixError("Semaphore::timedWait()"));
+	long long nsec = ts.tv_nsec + (long long)(seconds * 1000000000.);
+	ts.tv_sec += (time_t)(nsec / 1000000000);
+	ts.tv_nsec = (long)(nsec % 1000000000);
+	int err = 0;
+	do
+	{
+		err = sem_timedwait(&sem, &ts);
+	} while(err < 0 && errno == EINTR);
+	if(err < 0)
+	{
+		if(errno == ETIMEDOUT) return false;
+		else throw(UnixError("Semaphore::timedWait()"));
+	}
+
+	#endif
+
+	return true;
+}
+
+
 void Semaphore::post(void)
 {
 	#ifdef _WIN32
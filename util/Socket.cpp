@@ -146,7 +146,7 @@ Socket::Socket(bool doSSL_, bool ipv6_) :
 #ifdef USESSL
 	doSSL(doSSL_),
 #endif
-	ipv6(ipv6_)
+	ipv6(ipv6_), sendCalls(0), recvCalls(0)
 {
 	CriticalSection::SafeLock l(mutex);
 
@@ -198,7 +198,7 @@ Socket::Socket(bool doSSL_, bool ipv6_) :
 
 #ifdef USESSL
 Socket::Socket(SOCKET sd_, SSL *ssl_) :
-	sslctx(NULL), ssl(ssl_), sd(sd_)
+	sslctx(NULL), ssl(ssl_), sd(sd_), sendCalls(0), recvCalls(0)
 {
 	doSSL = ssl ? true : false;
 	#ifdef _WIN32
@@ -208,7 +208,7 @@ Socket::Socket(SOCKET sd_, SSL *ssl_) :
 }
 #else
 Socket::Socket(SOCKET sd_) :
-	sd(sd_)
+	sd(sd_), sendCalls(0), recvCalls(0)
 {
 	#ifdef _WIN32
 	CriticalSection::SafeLock l(mutex);
@@ -457,6 +457,7 @@ void Socket::send(char *buf, int len)
 	int bytesSent = 0, retval;
 	while(bytesSent < len)
 	{
+		sendCalls++;
 		#ifdef USESSL
 		if(doSSL)
 		{
@@ -485,6 +486,7 @@ void Socket::recv(char *buf, int len)
 	int bytesRead = 0, retval;
 	while(bytesRead < len)
 	{
+		recvCalls++;
 		#ifdef USESSL
 		if(doSSL)
 		{
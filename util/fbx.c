@@ -107,21 +107,61 @@ typedef struct _BMINFO
 
 #ifdef USESHM
 
+#ifdef USEXPRESENT
+#include <poll.h>
+#include <X11/extensions/Xpresent.h>
+
+/* Number of consecutive 10 ms intervals during which the X server can remain
+   silent before fbx_wait() gives up waiting for PresentIdleNotify events */
+#define PRESENT_TIMEOUT  100
+#endif
+
 static unsigned long serial = 0;  static int extok = 1;
 static XErrorHandler prevHandler = NULL;
 
 static int xhandler(Display *dpy, XErrorEvent *e)
 {
-	if(e->serial == serial && (e->minor_code == X_ShmAttach
-		&& e->error_code == BadAccess))
+	if(e->serial == serial && ((e->minor_code == X_ShmAttach
+		&& e->error_code == BadAccess)
+		#ifdef USEXPRESENT
+		|| e->minor_code == X_PresentSelectInput
+		#endif
+		))
 	{
 		extok = 0;  return 0;
 	}
 	if(prevHandler && prevHandler != xhandler) return prevHandler(dpy, e);
 	else return 0;
 }
+
+typedef struct
+{
+	int type;  ShmSeg shmseg;
+} shmcompletion;
+
+static Bool isShmCompletion(Display *dpy, XEvent *e, XPointer arg)
+{
+	shmcompletion *sc = (shmcompletion *)arg;
+
+	return e->type == sc->type
+		&& ((XShmCompletionEvent *)e)->shmseg == sc->shmseg;
+}
+
+#ifdef USEXPRESENT
+static Bool isPresentEvent(Display *dpy, XEvent *e, XPointer arg)
+{
+	return e->type == GenericEvent && e->xgeneric.extension == *(int *)arg;
+}
+#endif
+
+#endif
+
 #endif
 
+
+#ifndef _WIN32
+static int fbx_put(fbx_struct *fb, int srcX_, int srcY_, int dstX_, int dstY_,
+	int width_, int height_, int sendEvent);
 #endif
 
 
@@ -338,6 +378,38 @@ int fbx_init(fbx_struct *fb, fbx_wh wh, int width_, int height_, int useShm)
 					&fb->shminfo, width, height, xwa.depth);
 				if(!fb->pm) shmok = 0;
 			}
+			#ifdef USEXPRESENT
+			env = getenv("FBX_USEPRESENT");
+			if(shmok && !fb->pm && env && !strcmp(env, "1"))
+			{
+				static int alreadyWarned3 = 0;
+				int eventBase, errorBase;
+				if(XPresentQueryExtension(fb->wh.dpy, &fb->presentOpcode, &eventBase,
+					&errorBase))
+				{
+					fb->pm = XShmCreatePixmap(fb->wh.dpy, fb->wh.d,
+						fb->shminfo.shmaddr, &fb->shminfo, width, height, xwa.depth);
+					if(fb->pm)
+					{
+						fb->presentEID = XPresentSelectInput(fb->wh.dpy, fb->wh.d,
+							PresentIdleNotifyMask);
+						fb->present = 1;
+					}
+				}
+				if(!alreadyWarned3 && warningFile)
+				{
+					if(fb->present)
+						fprintf(warningFile, "[FBX] Using X Present extension\n");
+					else
+					{
+						fprintf(warningFile,
+							"[FBX] WARNING: X Present extension not available.  Will use MIT-SHM\n");
+						fprintf(warningFile, "[FBX]    drawing instead.\n");
+					}
+					alreadyWarned3 = 1;
+				}
+			}
+			#endif
 		}
 		shmctl(fb->shminfo.shmid, IPC_RMID, 0);
 		if(!shmok)
@@ -455,6 +527,7 @@ int fbx_read(fbx_struct *fb, int x_, int y_)
 	#ifdef USESHM
 	if(fb->shm)
 	{
+		if(fbx_wait(fb) == -1) return -1;
 		TRY_X11(XShmGetImage(fb->wh.dpy, fb->wh.d, fb->xi, x, y, AllPlanes));
 	}
 	else
@@ -511,8 +584,18 @@ int fbx_write(fbx_struct *fb, int srcX_, int srcY_, int dstX_, int dstY_,
 
 	#else
 
+	if(fb->present)
+	{
+		/* The X server may not read the pixmap until the next vertical blank, so
+		   wait until it is idle before returning. */
+		if(fbx_put(fb, srcX, srcY, dstX, dstY, width, height, 0) == -1)
+			return -1;
+		XFlush(fb->wh.dpy);
+		return fbx_wait(fb);
+	}
 	if(!fb->pm || !fb->shm)
-		if(fbx_awrite(fb, srcX, srcY, dstX, dstY, width, height) == -1) return -1;
+		if(fbx_put(fb, srcX, srcY, dstX, dstY, width, height, 0) == -1)
+			return -1;
 	if(fb->pm)
 	{
 		XCopyArea(fb->wh.dpy, fb->pm, fb->wh.d, fb->xgc, srcX, srcY, width, height,
@@ -567,8 +650,15 @@ int fbx_flip(fbx_struct *fb, int x_, int y_, int width_, int height_)
 
 #ifndef _WIN32
 
-int fbx_awrite(fbx_struct *fb, int srcX_, int srcY_, int dstX_, int dstY_,
-	int width_, int height_)
+int fbx_awrite(fbx_struct *fb, int srcX, int srcY, int dstX, int dstY,
+	int width, int height)
+{
+	return fbx_put(fb, srcX, srcY, dstX, dstY, width, height, 1);
+}
+
+
+static int fbx_put(fbx_struct *fb, int srcX_, int srcY_, int dstX_, int dstY_,
+	int width_, int height_, int sendEvent)
 {
 	int srcX, srcY, dstX, dstY, width, height;
 
@@ -593,8 +683,28 @@ int fbx_awrite(fbx_struct *fb, int srcX_, int srcY_, int dstX_, int dstY_,
 		{
 			TRY_X11(XShmAttach(fb->wh.dpy, &fb->shminfo));  fb->xattach = 1;
 		}
+		#ifdef USEXPRESENT
+		if(fb->present)
+		{
+			/* The update region is in pixmap coordinates, and the offset translates
+			   it into window coordinates.  An idle notification is always
+			   generated, regardless of sendEvent. */
+			XRectangle rect;  XserverRegion update;
+
+			rect.x = srcX;  rect.y = srcY;  rect.width = width;
+			rect.height = height;
+			TRY_X11(update = XFixesCreateRegion(fb->wh.dpy, &rect, 1));
+			XPresentPixmap(fb->wh.dpy, fb->wh.d, fb->pm, 0, None, update,
+				dstX - srcX, dstY - srcY, None, None, None, PresentOptionCopy, 0, 0,
+				0, NULL, 0);
+			XFixesDestroyRegion(fb->wh.dpy, update);
+			fb->pending++;
+			return 0;
+		}
+		#endif
 		TRY_X11(XShmPutImage(fb->wh.dpy, fb->wh.d, fb->xgc, fb->xi, srcX, srcY,
-			dstX, dstY, width, height, False));
+			dstX, dstY, width, height, sendEvent ? True : False));
+		if(sendEvent) fb->pending++;
 	}
 	else
 	#endif
@@ -622,13 +732,96 @@ int fbx_sync(fbx_struct *fb)
 	#else
 
 	if(!fb) THROW("Invalid argument");
-	if(fb->pm)
+	if(fb->pm && !fb->present)
 	{
 		XCopyArea(fb->wh.dpy, fb->pm, fb->wh.d, fb->xgc, 0, 0, fb->width,
 			fb->height, 0, 0);
 	}
 	XFlush(fb->wh.dpy);
 	XSync(fb->wh.dpy, False);
+	return fbx_wait(fb);
+
+	finally:
+	return -1;
+
+	#endif
+}
+
+
+int fbx_wait(fbx_struct *fb)
+{
+	#if defined(_WIN32) || !defined(USESHM)
+
+	return 0;
+
+	#else
+
+	shmcompletion sc;  XEvent e;
+
+	if(!fb) THROW("Invalid argument");
+	if(!fb->shm || fb->pending <= 0 || !fb->wh.dpy) return 0;
+
+	#ifdef USEXPRESENT
+	if(fb->present)
+	{
+		int timeouts = 0;
+
+		while(fb->pending > 0)
+		{
+			if(XCheckIfEvent(fb->wh.dpy, &e, isPresentEvent,
+				(XPointer)&fb->presentOpcode))
+			{
+				if(XGetEventData(fb->wh.dpy, &e.xcookie))
+				{
+					XPresentIdleNotifyEvent *ie =
+						(XPresentIdleNotifyEvent *)e.xcookie.data;
+					if(e.xcookie.evtype == PresentIdleNotify
+						&& ie->eid == fb->presentEID && ie->pixmap == fb->pm)
+						fb->pending--;
+					XFreeEventData(fb->wh.dpy, &e.xcookie);
+				}
+				timeouts = 0;
+			}
+			else
+			{
+				/* Presentations that failed (because the window disappeared, for
+				   instance) never generate an idle notification, and a successful
+				   presentation may not complete until the next vertical blank, so
+				   XSync() can't be used here.  Give up once the X server has been
+				   silent for too long. */
+				struct pollfd pfd;
+
+				if(timeouts++ >= PRESENT_TIMEOUT)
+				{
+					fb->pending = 0;  break;
+				}
+				XFlush(fb->wh.dpy);
+				pfd.fd = ConnectionNumber(fb->wh.dpy);
+				pfd.events = POLLIN;  pfd.revents = 0;
+				poll(&pfd, 1, 10);
+			}
+		}
+		return 0;
+	}
+	#endif
+
+	sc.type = XShmGetEventBase(fb->wh.dpy) + ShmCompletion;
+	sc.shmseg = fb->shminfo.shmseg;
+	while(fb->pending > 0
+		&& XCheckIfEvent(fb->wh.dpy, &e, isShmCompletion, (XPointer)&sc))
+		fb->pending--;
+	if(fb->pending > 0)
+	{
+		/* The X server is still reading from the segment.  Since the X server
+		   processes requests in order, all outstanding completion events will
+		   have been received once XSync() returns.  Any that haven't correspond
+		   to writes that failed (because the window disappeared, for instance.) */
+		XSync(fb->wh.dpy, False);
+		while(fb->pending > 0
+			&& XCheckIfEvent(fb->wh.dpy, &e, isShmCompletion, (XPointer)&sc))
+			fb->pending--;
+		fb->pending = 0;
+	}
 	return 0;
 
 	finally:
@@ -649,6 +842,24 @@ int fbx_term(fbx_struct *fb)
 
 	#else
 
+	#ifdef USESHM
+	if(fb->shm) fbx_wait(fb);
+	#ifdef USEXPRESENT
+	if(fb->present)
+	{
+		/* The window may have already been destroyed, so ignore any error. */
+		XLockDisplay(fb->wh.dpy);
+		XSync(fb->wh.dpy, False);
+		prevHandler = XSetErrorHandler(xhandler);
+		serial = NextRequest(fb->wh.dpy);
+		XPresentFreeInput(fb->wh.dpy, fb->wh.d, fb->presentEID);
+		XSync(fb->wh.dpy, False);
+		XSetErrorHandler(prevHandler);
+		XUnlockDisplay(fb->wh.dpy);
+		fb->present = 0;
+	}
+	#endif
+	#endif
 	if(fb->pm)
 	{
 		XFreePixmap(fb->wh.dpy, fb->pm);  fb->pm = 0;
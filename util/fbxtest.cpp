@@ -170,6 +170,7 @@ void nativeWrite(bool useShm)
 			{
 				memset(fb.bits, 255, fb.pitch * fb.height);
 				TRY_FBX(fbx_awrite(&fb, 0, 0, 0, 0, 0, 0));
+				TRY_FBX(fbx_wait(&fb));
 			}
 			#endif
 			initBuf(0, 0, fb.width, fb.pitch, fb.height, fb.pf,
@@ -205,6 +206,7 @@ void nativeWrite(bool useShm)
 			{
 				memset(fb.bits, 255, fb.pitch * fb.height);
 				TRY_FBX(fbx_awrite(&fb, 0, 0, 0, 0, 0, 0));
+				TRY_FBX(fbx_wait(&fb));
 			}
 			#endif
 			initBuf(0, 0, fb.width, fb.pitch, fb.height, fb.pf,
@@ -241,6 +243,7 @@ void nativeWrite(bool useShm)
 			{
 				memset(fb.bits, 255, fb.pitch * fb.height);
 				TRY_FBX(fbx_awrite(&fb, 0, 0, 0, 0, 0, 0));
+				TRY_FBX(fbx_wait(&fb));
 			}
 			#endif
 			initBuf(0, 0, fb.width, fb.pitch, fb.height, fb.pf,
@@ -262,6 +265,59 @@ void nativeWrite(bool useShm)
 		}
 		else fprintf(stderr, " (no errors)\n");
 
+		#ifndef _WIN32
+		// fbx_awrite() requests a completion event for each write if MIT-SHM is
+		// being used, and fbx_wait() must consume all of them before the buffer
+		// is modified again.
+		clearFB();
+		if(useShm)
+			fprintf(stderr, "FBX async write [SHM]:         ");
+		else
+			fprintf(stderr, "FBX async write:               ");
+		i = 0;  drawTime = 0.;  timer2.start();
+		bool completionError = false;
+		do
+		{
+			initBuf(0, 0, fb.width, fb.pitch, fb.height, fb.pf,
+				(unsigned char *)fb.bits, i);
+			timer.start();
+			TRY_FBX(fbx_awrite(&fb, 0, 0, 0, 0, 0, 0));
+			TRY_FBX(fbx_wait(&fb));
+			drawTime += timer.elapsed();
+			#ifdef USESHM
+			if(fb.pending != 0) completionError = true;
+			#endif
+			i++;
+		} while(timer2.elapsed() < benchTime);
+		fprintf(stderr, "%f Mpixels/sec",
+			(double)i * (double)(fb.width * fb.height) / (1000000. * drawTime));
+		#ifdef USESHM
+		if(fb.shm && !fb.present)
+		{
+			// No completion events should be left in the queue.
+			XEvent e;
+			XSync(fb.wh.dpy, False);
+			if(XCheckTypedEvent(fb.wh.dpy,
+				XShmGetEventBase(fb.wh.dpy) + ShmCompletion, &e))
+				completionError = true;
+		}
+		#endif
+		memset(fb.bits, 0, fb.pitch * fb.height);
+		TRY_FBX(fbx_read(&fb, 0, 0));
+		if(completionError)
+		{
+			fprintf(stderr, " (COMPLETION EVENTS NOT CONSUMED)\n");
+			retCode = -1;
+		}
+		else if(!cmpBuf(0, 0, fb.width, fb.pitch, fb.height, fb.pf,
+			(unsigned char *)fb.bits, i - 1))
+		{
+			fprintf(stderr, " (ERROR CHECK FAILED)\n");
+			retCode = -1;
+		}
+		else fprintf(stderr, " (no errors)\n");
+		#endif
+
 	}
 	catch(Error &e)
 	{
@@ -15,8 +15,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "Socket.h"
+#include "Thread.h"
 #include "vglutil.h"
 #include "Timer.h"
+#include "../common/rr.h"
 #ifdef sun
 #include <kstat.h>
 #endif
@@ -28,9 +30,11 @@ using namespace vglutil;
 #define MINDATASIZE  1
 #define MAXDATASIZE  (4 * 1024 * 1024)
 #define ITER  5
+#define MAXSTREAMS  64
 
 
 double benchTime = 2.0;
+int nStreams = 1, tilesPerFrame = 16, tileSize = 32768;
 
 
 #if defined(sun) || defined(linux)
@@ -150,13 +154,291 @@ int cmpBuf(char *buf, int len)
 }
 
 
+// Frame traffic benchmark.  This sends the same pattern of messages that the
+// VGL Transport sends (a frame header followed by a variable-size payload for
+// each tile and an end-of-frame header for each frame) over one or more
+// concurrent connections.  The receiver acknowledges each end-of-frame header
+// with a single byte, so the sender can measure the latency of each frame.
+
+#define FT_ID  "VGLFT"
+#define FT_DONE  255  // Header flag that ends the benchmark
+
+class FrameSender : public Runnable
+{
+	public:
+
+		FrameSender(Socket *socket_) : socket(socket_), buf(NULL), frames(0),
+			bytes(0), latencies(NULL), maxLatencies(0)
+		{
+			if((buf = (char *)malloc(tileSize * 2)) == NULL)
+				THROW("Memory allocation error");
+			initBuf(buf, tileSize * 2);
+		}
+
+		~FrameSender(void)
+		{
+			free(buf);  free(latencies);
+		}
+
+		void run(void)
+		{
+			rrframeheader hdr;  Timer timer, frameTimer;
+			// Vary the tile sizes deterministically between 1/2 and 3/2 of the
+			// requested size, as compressed tiles would.
+			unsigned int seed = 1;
+			char ack;
+
+			memset(&hdr, 0, sizeof(rrframeheader));
+			timer.start();
+			do
+			{
+				frameTimer.start();
+				for(int i = 0; i < tilesPerFrame; i++)
+				{
+					seed = seed * 1103515245 + 12345;
+					int size = tileSize / 2 + (int)((seed >> 8) % (unsigned int)tileSize);
+					if(size < 1) size = 1;
+					hdr.size = LittleEndian() ? size : BYTESWAP(size);
+					hdr.flags = 0;
+					socket->send((char *)&hdr, sizeof_rrframeheader);
+					socket->send(buf, size);
+					bytes += sizeof_rrframeheader + size;
+				}
+				hdr.size = 0;  hdr.flags = RR_EOF;
+				socket->send((char *)&hdr, sizeof_rrframeheader);
+				bytes += sizeof_rrframeheader;
+				socket->recv(&ack, 1);
+
+				if(frames >= maxLatencies)
+				{
+					maxLatencies = maxLatencies ? maxLatencies * 2 : 1024;
+					double *temp =
+						(double *)realloc(latencies, sizeof(double) * maxLatencies);
+					if(!temp) THROW("Memory allocation error");
+					latencies = temp;
+				}
+				latencies[frames++] = frameTimer.elapsed();
+			} while(timer.elapsed() < benchTime);
+
+			hdr.size = 0;  hdr.flags = FT_DONE;
+			socket->send((char *)&hdr, sizeof_rrframeheader);
+		}
+
+		Socket *socket;
+		char *buf;
+		long frames;  double bytes;
+		double *latencies;  long maxLatencies;
+};
+
+
+class FrameReceiver : public Runnable
+{
+	public:
+
+		FrameReceiver(Socket *socket_) : socket(socket_), buf(NULL), bufSize(0),
+			frames(0) {}
+		~FrameReceiver(void) { free(buf); }
+
+		void run(void)
+		{
+			rrframeheader hdr;
+
+			for(;;)
+			{
+				socket->recv((char *)&hdr, sizeof_rrframeheader);
+				if(hdr.flags == FT_DONE) break;
+				if(hdr.flags == RR_EOF)
+				{
+					char ack = 1;
+					socket->send(&ack, 1);
+					frames++;
+					continue;
+				}
+				int size = LittleEndian() ? hdr.size : BYTESWAP(hdr.size);
+				if(size < 1 || size > MAXDATASIZE) THROW("Invalid tile size");
+				if(size > bufSize)
+				{
+					free(buf);
+					if((buf = (char *)malloc(size)) == NULL)
+						THROW("Memory allocation error");
+					bufSize = size;
+				}
+				socket->recv(buf, size);
+			}
+		}
+
+		Socket *socket;
+		char *buf;  int bufSize;
+		long frames;
+};
+
+
+int compareDouble(const void *arg1, const void *arg2)
+{
+	double d1 = *(double *)arg1, d2 = *(double *)arg2;
+	return d1 < d2 ? -1 : (d1 > d2 ? 1 : 0);
+}
+
+
+void sendFrames(char *serverName, bool doSSL, bool ipv6)
+{
+	Socket *sockets[MAXSTREAMS];  FrameSender *senders[MAXSTREAMS];
+	Thread *threads[MAXSTREAMS];
+	double *latencies = NULL;
+	int i;
+
+	for(i = 0; i < nStreams; i++)
+	{
+		sockets[i] = NULL;  senders[i] = NULL;  threads[i] = NULL;
+	}
+
+	try
+	{
+		for(i = 0; i < nStreams; i++)
+		{
+			int n = LittleEndian() ? nStreams : BYTESWAP(nStreams);
+			NEWCHECK(sockets[i] = new Socket(doSSL, ipv6));
+			sockets[i]->connect(serverName, PORT);
+			sockets[i]->send((char *)FT_ID, 5);
+			sockets[i]->send((char *)&n, (int)sizeof(int));
+		}
+		printf("Frame traffic between localhost and %s:\n",
+			sockets[0]->remoteName());
+		printf("%d stream(s), %d tiles/frame, %d bytes/tile (average)%s\n\n",
+			nStreams, tilesPerFrame, tileSize, doSSL ? ", SSL" : "");
+
+		Timer timer;
+		timer.start();
+		for(i = 0; i < nStreams; i++)
+		{
+			NEWCHECK(senders[i] = new FrameSender(sockets[i]));
+			NEWCHECK(threads[i] = new Thread(senders[i]));
+			threads[i]->start();
+		}
+		for(i = 0; i < nStreams; i++) threads[i]->stop();
+		double elapsed = timer.elapsed();
+		for(i = 0; i < nStreams; i++) threads[i]->checkError();
+
+		long frames = 0;  double bytes = 0.;
+		unsigned long long calls = 0;
+		for(i = 0; i < nStreams; i++)
+		{
+			frames += senders[i]->frames;  bytes += senders[i]->bytes;
+			calls += sockets[i]->getSendCalls() + sockets[i]->getRecvCalls();
+		}
+		if(frames < 1) THROW("No frames were sent");
+		if((latencies = (double *)malloc(sizeof(double) * frames)) == NULL)
+			THROW("Memory allocation error");
+		long n = 0;
+		for(i = 0; i < nStreams; i++)
+		{
+			memcpy(&latencies[n], senders[i]->latencies,
+				sizeof(double) * senders[i]->frames);
+			n += senders[i]->frames;
+		}
+		qsort(latencies, frames, sizeof(double), compareDouble);
+
+		printf("Frames/sec:          %f\n", (double)frames / elapsed);
+		printf("Throughput:          %f Mbits/sec\n", bytes * 8. / 1000000. / elapsed);
+		printf("Socket calls/frame:  %f (sender)\n", (double)calls / (double)frames);
+		printf("Frame latency (ms):  50%%: %.3f  95%%: %.3f  99%%: %.3f  max: %.3f\n",
+			latencies[(frames - 1) * 50 / 100] * 1000.,
+			latencies[(frames - 1) * 95 / 100] * 1000.,
+			latencies[(frames - 1) * 99 / 100] * 1000.,
+			latencies[frames - 1] * 1000.);
+	}
+	catch(...)
+	{
+		for(i = 0; i < nStreams; i++)
+		{
+			if(threads[i]) threads[i]->stop();
+			delete threads[i];  delete senders[i];  delete sockets[i];
+		}
+		free(latencies);
+		throw;
+	}
+	for(i = 0; i < nStreams; i++)
+	{
+		delete threads[i];  delete senders[i];  delete sockets[i];
+	}
+	free(latencies);
+}
+
+
+// Called by the server after it has received the frame traffic ID from the
+// first connection
+
+void receiveFrames(Socket &listener, Socket *firstSocket)
+{
+	Socket *sockets[MAXSTREAMS];  FrameReceiver *receivers[MAXSTREAMS];
+	Thread *threads[MAXSTREAMS];
+	int i, n;  char id[6];
+
+	firstSocket->recv((char *)&n, (int)sizeof(int));
+	if(!LittleEndian()) n = BYTESWAP(n);
+	if(n < 1 || n > MAXSTREAMS) THROW("Invalid number of streams");
+	for(i = 0; i < n; i++)
+	{
+		sockets[i] = NULL;  receivers[i] = NULL;  threads[i] = NULL;
+	}
+	sockets[0] = firstSocket;
+
+	try
+	{
+		for(i = 1; i < n; i++)
+		{
+			int temp;
+			sockets[i] = listener.accept();
+			sockets[i]->recv(id, 5);  id[5] = 0;
+			if(strcmp(id, FT_ID)) THROW("Invalid header");
+			sockets[i]->recv((char *)&temp, (int)sizeof(int));
+		}
+		printf("Receiving frame traffic on %d stream(s)\n", n);
+		for(i = 0; i < n; i++)
+		{
+			NEWCHECK(receivers[i] = new FrameReceiver(sockets[i]));
+			NEWCHECK(threads[i] = new Thread(receivers[i]));
+			threads[i]->start();
+		}
+		for(i = 0; i < n; i++) threads[i]->stop();
+		for(i = 0; i < n; i++) threads[i]->checkError();
+
+		long frames = 0;  unsigned long long calls = 0;
+		for(i = 0; i < n; i++)
+		{
+			frames += receivers[i]->frames;
+			calls += sockets[i]->getSendCalls() + sockets[i]->getRecvCalls();
+		}
+		if(frames > 0)
+			printf("Socket calls/frame:  %f (receiver)\n",
+				(double)calls / (double)frames);
+	}
+	catch(...)
+	{
+		for(i = 0; i < n; i++)
+		{
+			if(threads[i]) threads[i]->stop();
+			delete threads[i];  delete receivers[i];
+			if(i > 0) delete sockets[i];
+		}
+		throw;
+	}
+	for(i = 0; i < n; i++)
+	{
+		delete threads[i];  delete receivers[i];
+		if(i > 0) delete sockets[i];
+	}
+}
+
+
 void usage(char **argv)
 {
 	fprintf(stderr, "\nUSAGE: %s -client <server name or IP>", argv[0]);
 	#ifdef USESSL
 	fprintf(stderr, " [-ssl]");
 	#endif
-	fprintf(stderr, " [-old] [-time <t>]");
+	fprintf(stderr, " [-old] [-time <t>]\n");
+	fprintf(stderr, "       [-frames [-streams <n>] [-tiles <n>] [-tilesize <bytes>]]");
 	fprintf(stderr, "\n or    %s -server [-ipv6]", argv[0]);
 	#ifdef USESSL
 	fprintf(stderr, " [-ssl]");
@@ -168,6 +450,16 @@ void usage(char **argv)
 	#endif
 	fprintf(stderr, "\n-findport = Display a free TCP port number and exit");
 	fprintf(stderr, "\n-old = Communicate with NetTest server v2.1.x or earlier\n");
+	fprintf(stderr, "-frames = Instead of measuring the throughput of fixed-size transfers, send\n");
+	fprintf(stderr, "          the same pattern of messages that the VGL Transport sends, and\n");
+	fprintf(stderr, "          report the frame rate, throughput, socket calls per frame, and\n");
+	fprintf(stderr, "          frame latency\n");
+	fprintf(stderr, "-streams <n> = Send frames over <n> concurrent connections (1 <= <n> <= %d,\n",
+		MAXSTREAMS);
+	fprintf(stderr, "               default: %d)\n", nStreams);
+	fprintf(stderr, "-tiles <n> = Send <n> tiles per frame (default: %d)\n",
+		tilesPerFrame);
+	fprintf(stderr, "-tilesize <b> = Average tile size in bytes (default: %d)\n", tileSize);
 	#ifdef USESSL
 	fprintf(stderr, "-ssl = Use secure tunnel\n");
 	#endif
@@ -183,7 +475,7 @@ int main(int argc, char **argv)
 {
 	int server = 0;  char *serverName = NULL;
 	char *buf;  int i, j, size;
-	bool doSSL = false, ipv6 = false, old = false;
+	bool doSSL = false, ipv6 = false, old = false, frames = false;
 	Timer timer;
 	#if defined(sun) || defined(linux)
 	int interval = 2;
@@ -217,6 +509,22 @@ int main(int argc, char **argv)
 					if(sscanf(argv[++i], "%lf", &benchTime) < 1 || benchTime <= 0.0)
 						usage(argv);
 				}
+				else if(!stricmp(argv[i], "-frames")) frames = true;
+				else if(!stricmp(argv[i], "-streams") && i < argc - 1)
+				{
+					nStreams = atoi(argv[++i]);
+					if(nStreams < 1 || nStreams > MAXSTREAMS) usage(argv);
+				}
+				else if(!stricmp(argv[i], "-tiles") && i < argc - 1)
+				{
+					tilesPerFrame = atoi(argv[++i]);
+					if(tilesPerFrame < 1) usage(argv);
+				}
+				else if(!stricmp(argv[i], "-tilesize") && i < argc - 1)
+				{
+					tileSize = atoi(argv[++i]);
+					if(tileSize < 1 || tileSize > MAXDATASIZE / 2) usage(argv);
+				}
 				else usage(argv);
 			}
 		}
@@ -264,6 +572,12 @@ int main(int argc, char **argv)
 		#endif
 		else usage(argv);
 
+		if(!server && frames)
+		{
+			sendFrames(serverName, doSSL, ipv6);
+			return 0;
+		}
+
 		Socket socket(doSSL, ipv6);
 		if((buf = (char *)malloc(sizeof(char) * MAXDATASIZE)) == NULL)
 		{
@@ -294,18 +608,23 @@ int main(int argc, char **argv)
 			clientSocket->recv(buf, 1);
 			if(buf[0] == 'V')
 			{
-				clientSocket->recv(&buf[1], 4);
-				if(strcmp(buf, "VGL22")) THROW("Invalid header");
-				while(1)
+				clientSocket->recv(&buf[1], 4);  buf[5] = 0;
+				if(!strcmp(buf, FT_ID))
+					receiveFrames(socket, clientSocket);
+				else
 				{
-					clientSocket->recv((char *)&size, (int)sizeof(int));
-					if(!LittleEndian()) size = BYTESWAP(size);
-					if(size < 1) break;
+					if(strcmp(buf, "VGL22")) THROW("Invalid header");
 					while(1)
 					{
-						clientSocket->recv(buf, size);
-						if((unsigned char)buf[0] == 255) break;
-						clientSocket->send(buf, size);
+						clientSocket->recv((char *)&size, (int)sizeof(int));
+						if(!LittleEndian()) size = BYTESWAP(size);
+						if(size < 1) break;
+						while(1)
+						{
+							clientSocket->recv(buf, size);
+							if((unsigned char)buf[0] == 255) break;
+							clientSocket->send(buf, size);
+						}
 					}
 				}
 			}